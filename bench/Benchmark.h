@@ -0,0 +1,64 @@
+#ifndef DISTILLER_BENCH_BENCHMARK_H
+#define DISTILLER_BENCH_BENCHMARK_H
+
+#pragma once
+
+#include <QString>
+
+namespace Distiller
+{
+
+namespace Bench
+{
+
+/**
+ * A single benchmark.
+ *
+ * The runner calls setUp() once, then run() repeatedly and
+ * measures the time of the calls to run(), then tearDown().
+ */
+class Benchmark
+{
+
+	QString name_;
+
+public:
+
+	Benchmark(const QString& name) : name_(name)
+		{ }
+
+	virtual ~Benchmark()
+		{ }
+
+	const QString& name() const
+		{ return name_; }
+
+	/**
+	 * Returns false if the benchmark can't be run.
+	 */
+	virtual bool setUp()
+		{ return true; }
+
+	/**
+	 * One iteration. Returns the number of items processed,
+	 * e.g. queries or bytes.
+	 */
+	virtual quint64 run() = 0;
+
+	virtual void tearDown()
+		{ }
+
+	/**
+	 * Benchmarks which take long (build, load) are run only a
+	 * few times.
+	 */
+	virtual int maxIterations() const
+		{ return 1 << 30; }
+
+};
+
+} // namespace Bench
+
+} // namespace Distiller
+
+#endif 
@@ -0,0 +1,123 @@
+#include <core/precompiled.h>
+
+#include <QDateTime>
+#include <QElapsedTimer>
+
+#include "Benchmark.h"
+#include "BenchmarkRunner.h"
+
+namespace Distiller
+{
+
+namespace Bench
+{
+
+BenchmarkRunner::Result::Result() :
+	name(),
+	iterations(0),
+	realTime(0),
+	itemsPerSecond(0)
+{ }
+
+BenchmarkRunner::BenchmarkRunner() :
+	minTime_(500),
+	filter_(),
+	context_(),
+	results_()
+{ }
+
+void BenchmarkRunner::setMinTime(int msecs)
+{
+	minTime_ = msecs;
+}
+
+void BenchmarkRunner::setFilter(const QString& filter)
+{
+	filter_ = filter;
+}
+
+void BenchmarkRunner::addContext(const QString& key, const QString& value)
+{
+	context_.append(qMakePair(key, value));
+}
+
+bool BenchmarkRunner::run(Benchmark& benchmark)
+{
+	if (filter_.isEmpty() == false && benchmark.name().contains(filter_) == false)
+		return true;
+	if (benchmark.setUp() == false)
+		return false;
+
+	Result result;
+	result.name = benchmark.name();
+	quint64 items = 0;
+	qint64 elapsed = 0;
+	QElapsedTimer timer;
+	timer.start();
+	// Check the clock only every batch iterations, doubling the
+	// batch size, so fast kernels aren't dominated by the timer.
+	quint64 batch = 1;
+	while (elapsed < qint64(minTime_) * 1000000 &&
+		   result.iterations < quint64(benchmark.maxIterations()))
+	{
+		quint64 count = qMin(batch,
+			quint64(benchmark.maxIterations()) - result.iterations);
+		for (quint64 i = 0; i < count; i++)
+			items += benchmark.run();
+		result.iterations += count;
+		elapsed = timer.nsecsElapsed();
+		batch *= 2;
+	}
+	benchmark.tearDown();
+
+	result.realTime = double(elapsed) / result.iterations;
+	if (elapsed > 0)
+		result.itemsPerSecond = items * 1e9 / elapsed;
+	results_.append(result);
+	return true;
+}
+
+QString BenchmarkRunner::quote(const QString& text)
+{
+	QString rv = "\"";
+	for (int i = 0; i < text.size(); i++) {
+		QChar ch = text[i];
+		if (ch == '"' || ch == '\\')
+			rv += '\\';
+		if (ch.unicode() < 0x20)
+			rv += QString("\\u%1").arg(ch.unicode(), 4, 16, QChar('0'));
+		else
+			rv += ch;
+	}
+	return rv + "\"";
+}
+
+void BenchmarkRunner::writeJson(QTextStream& out) const
+{
+	out << "{\n  \"context\": {\n";
+	out << "    \"date\": "
+		<< quote(QDateTime::currentDateTime().toString(Qt::ISODate));
+	for (int i = 0; i < context_.size(); i++) {
+		out << ",\n    " << quote(context_[i].first) << ": "
+			<< quote(context_[i].second);
+	}
+	out << "\n  },\n  \"benchmarks\": [";
+	for (int i = 0; i < results_.size(); i++) {
+		const Result& result = results_[i];
+		out << (i > 0? ",\n" : "\n");
+		out << "    {\n";
+		out << "      \"name\": " << quote(result.name) << ",\n";
+		out << "      \"iterations\": " << result.iterations << ",\n";
+		out << "      \"real_time\": " << QString::number(result.realTime, 'f', 1) << ",\n";
+		out << "      \"time_unit\": \"ns\",\n";
+		out << "      \"items_per_second\": "
+			<< QString::number(result.itemsPerSecond, 'f', 1) << "\n";
+		out << "    }";
+	}
+	out << "\n  ]\n}\n";
+	out.flush();
+}
+
+} // namespace Bench
+
+} // namespace Distiller
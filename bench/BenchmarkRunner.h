@@ -0,0 +1,104 @@
+#ifndef DISTILLER_BENCH_BENCHMARKRUNNER_H
+#define DISTILLER_BENCH_BENCHMARKRUNNER_H
+
+#pragma once
+
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QTextStream>
+
+namespace Distiller
+{
+
+namespace Bench
+{
+
+class Benchmark;
+
+/**
+ * Runs benchmarks and writes the results as JSON.
+ *
+ * Every benchmark is run until minTime has passed (or it has
+ * reached its maxIterations()). The JSON output follows the
+ * format of Google Benchmark, so the same tools can compare two
+ * runs:
+ *
+ *     {
+ *       "context": { "date": "...", "seed": "42", ... },
+ *       "benchmarks": [
+ *         { "name": "find", "iterations": 4096,
+ *           "real_time": 18234.5, "time_unit": "ns",
+ *           "items_per_second": 54842.1 },
+ *         ...
+ *       ]
+ *     }
+ */
+class BenchmarkRunner
+{
+
+public:
+
+	class Result
+	{
+
+	public:
+
+		QString name;
+
+		quint64 iterations;
+
+		/// Mean time per iteration in nanoseconds.
+		double realTime;
+
+		double itemsPerSecond;
+
+		Result();
+
+	};
+
+private:
+
+	/// Minimum time per benchmark in milliseconds.
+	int minTime_;
+
+	/// Only benchmarks whose names contain the filter are run.
+	QString filter_;
+
+	QList<QPair<QString, QString> > context_;
+
+	QList<Result> results_;
+
+	static QString quote(const QString& text);
+
+public:
+
+	BenchmarkRunner();
+
+	void setMinTime(int msecs);
+
+	void setFilter(const QString& filter);
+
+	/**
+	 * Adds a key/value pair to the context of the output, e.g.
+	 * the settings of the generator.
+	 */
+	void addContext(const QString& key, const QString& value);
+
+	/**
+	 * Runs benchmark. Returns false if it couldn't be set up.
+	 */
+	bool run(Benchmark& benchmark);
+
+	const QList<Result>& results() const
+		{ return results_; }
+
+	void writeJson(QTextStream& out) const;
+
+};
+
+} // namespace Bench
+
+} // namespace Distiller
+
+#endif 
@@ -0,0 +1,178 @@
+#include <core/precompiled.h>
+
+#include <cmath>
+
+#include <QFile>
+#include <QSet>
+#include <QTextStream>
+
+#include "Generator.h"
+
+namespace Distiller
+{
+
+namespace Bench
+{
+
+static const char* const syllables[] = {
+	"ka", "lo", "mi", "ne", "ru", "sa", "to", "vi", "ber", "dan",
+	"el", "fos", "gar", "hel", "in", "jor", "kle", "lin", "mor", "nus",
+	"or", "pra", "quin", "ros", "sten", "tur", "ul", "ven", "wal", "xi",
+	"yor", "zan", "ch", "sch", "th", "ae", "ou", "ie", "st", "ng"
+};
+
+static const int syllableCount = sizeof(syllables) / sizeof(syllables[0]);
+
+static const double pi = 3.14159265358979323846;
+
+Generator::Settings::Settings() :
+	seed(42),
+	entries(100000),
+	meanLength(16),
+	lengthDeviation(6),
+	minLength(4),
+	maxLength(60),
+	typoRate(0.05),
+	substitutionWeight(4),
+	insertionWeight(2),
+	deletionWeight(2),
+	transpositionWeight(1)
+{ }
+
+Generator::Generator(const Settings& settings) :
+	settings_(settings),
+	state_(0)
+{
+	reset();
+}
+
+void Generator::reset()
+{
+	// xorshift must not start with 0.
+	state_ = settings_.seed? settings_.seed : Q_UINT64_C(0x9E3779B97F4A7C15);
+}
+
+quint64 Generator::next()
+{
+	state_ ^= state_ >> 12;
+	state_ ^= state_ << 25;
+	state_ ^= state_ >> 27;
+	return state_ * Q_UINT64_C(2685821657736338717);
+}
+
+int Generator::uniform(int n)
+{
+	return static_cast<int>(next() % static_cast<quint64>(n));
+}
+
+double Generator::uniformReal()
+{
+	return (next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+int Generator::length()
+{
+	// Box-Muller transform.
+	double u1 = 1.0 - uniformReal();
+	double u2 = uniformReal();
+	double z = std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * pi * u2);
+	int rv = qRound(settings_.meanLength + z * settings_.lengthDeviation);
+	return qBound(settings_.minLength, rv, settings_.maxLength);
+}
+
+QChar Generator::randomLetter()
+{
+	return QChar('a' + uniform(26));
+}
+
+QStringList Generator::entries()
+{
+	QStringList rv;
+	QSet<QString> seen;
+	rv.reserve(settings_.entries);
+	while (rv.size() < settings_.entries) {
+		int size = length();
+		QString entry;
+		while (entry.size() < size) {
+			if (entry.isEmpty() == false && uniform(4) == 0)
+				entry += ' ';
+			QString syllable = syllables[uniform(syllableCount)];
+			// Capitalize words now and then.
+			if ((entry.isEmpty() || entry.endsWith(' ')) && uniform(2) == 0)
+				syllable[0] = syllable[0].toUpper();
+			entry += syllable;
+		}
+		entry = entry.left(size).trimmed();
+		if (entry.size() < settings_.minLength || seen.contains(entry))
+			continue;
+		seen.insert(entry);
+		rv.append(entry);
+	}
+	return rv;
+}
+
+QString Generator::misspell(const QString& entry)
+{
+	int total = settings_.substitutionWeight + settings_.insertionWeight +
+		settings_.deletionWeight + settings_.transpositionWeight;
+	if (total <= 0)
+		return entry;
+
+	QString rv;
+	for (int i = 0; i < entry.size(); i++) {
+		if (uniformReal() >= settings_.typoRate) {
+			rv += entry[i];
+			continue;
+		}
+		int op = uniform(total);
+		if ((op -= settings_.substitutionWeight) < 0)
+			rv += randomLetter();
+		else if ((op -= settings_.insertionWeight) < 0) {
+			rv += entry[i];
+			rv += randomLetter();
+		}
+		else if ((op -= settings_.deletionWeight) < 0)
+			continue;
+		else if (i + 1 < entry.size()) {
+			rv += entry[i + 1];
+			rv += entry[i];
+			i++;
+		}
+		else
+			rv += entry[i];
+	}
+	return rv;
+}
+
+QStringList Generator::queries(const QStringList& entries, int count,
+							  QList<int>* sources)
+{
+	QStringList rv;
+	if (entries.isEmpty())
+		return rv;
+	rv.reserve(count);
+	for (int i = 0; i < count; i++) {
+		int source = uniform(entries.size());
+		rv.append(misspell(entries[source]));
+		if (sources)
+			sources->append(source);
+	}
+	return rv;
+}
+
+bool Generator::write(const QStringList& entries, const QString& fileName)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return false;
+	QTextStream out(&file);
+	out.setCodec("UTF-8");
+	foreach (const QString& entry, entries)
+		out << entry << '\n';
+	out.flush();
+	return out.status() == QTextStream::Ok;
+}
+
+} // namespace Bench
+
+} // namespace Distiller
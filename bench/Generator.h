@@ -0,0 +1,129 @@
+#ifndef DISTILLER_BENCH_GENERATOR_H
+#define DISTILLER_BENCH_GENERATOR_H
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+namespace Distiller
+{
+
+namespace Bench
+{
+
+/**
+ * Generates a synthetic dictionary and misspelled queries.
+ *
+ * The output only depends on the seed and the settings, so two
+ * runs with the same settings benchmark the same data on every
+ * machine. We use our own random number generator (xorshift64*)
+ * instead of qrand(), whose sequence differs between platforms.
+ *
+ * Entries consist of words built from syllables. Their length
+ * (in characters) is normally distributed and clipped to
+ * [minLength, maxLength].
+ *
+ * Queries are entries with typos. Every character is misspelled
+ * with probability typoRate by a substitution, an insertion, a
+ * deletion or a transposition, chosen with the given weights.
+ */
+class Generator
+{
+
+public:
+
+	class Settings
+	{
+
+	public:
+
+		quint64 seed;
+
+		int entries;
+
+		int meanLength;
+
+		int lengthDeviation;
+
+		int minLength;
+
+		int maxLength;
+
+		/// Probability that a character is misspelled.
+		double typoRate;
+
+		int substitutionWeight;
+
+		int insertionWeight;
+
+		int deletionWeight;
+
+		int transpositionWeight;
+
+		Settings();
+
+	};
+
+private:
+
+	Settings settings_;
+
+	quint64 state_;
+
+	/// Returns the next random number.
+	quint64 next();
+
+	/// Returns a random number in [0, n).
+	int uniform(int n);
+
+	/// Returns a random number in [0, 1).
+	double uniformReal();
+
+	/// Returns a normally distributed length.
+	int length();
+
+	QChar randomLetter();
+
+public:
+
+	Generator(const Settings& settings);
+
+	const Settings& settings() const
+		{ return settings_; }
+
+	/**
+	 * Restarts the sequence of random numbers.
+	 */
+	void reset();
+
+	/**
+	 * Returns settings().entries distinct entries.
+	 */
+	QStringList entries();
+
+	/**
+	 * Returns a misspelled version of entry.
+	 */
+	QString misspell(const QString& entry);
+
+	/**
+	 * Returns count queries, misspelled versions of randomly
+	 * chosen entries. If sources is given, the index of the
+	 * entry of every query is appended to it.
+	 */
+	QStringList queries(const QStringList& entries, int count,
+						QList<int>* sources = 0);
+
+	/**
+	 * Writes the entries to an UTF-8 textfile, one per line.
+	 */
+	static bool write(const QStringList& entries, const QString& fileName);
+
+};
+
+} // namespace Bench
+
+} // namespace Distiller
+
+#endif 
@@ -0,0 +1,422 @@
+#include <core/precompiled.h>
+
+#include <algorithm>
+#include <iostream>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+
+#include "Dictionary.h"
+#include "AbstractMatchHandler.h"
+#include "EditDistance.h"
+#include "Match.h"
+#include "SimpleString.h"
+#include "Generator.h"
+
+using namespace Distiller;
+using namespace Distiller::Bench;
+
+/**
+ * dictcheck compares the results of the gram index with a brute
+ * force scan of all encoded entries, which is the ground truth:
+ * the gram index must find a match whenever there is one within
+ * calcMaxTypos(needle), and no match it finds may be worse than
+ * the best one.
+ */
+
+/// Results of one configuration.
+class CheckResult
+{
+
+public:
+
+	Generator::Settings settings;
+
+	int queries;
+
+	/// Queries which have a match within calcMaxTypos().
+	int matchable;
+
+	/// Matchable queries for which find() returned nothing.
+	int missed;
+
+	/// Queries for which find() returned a worse match.
+	int worse;
+
+	/// Queries for which find() returned a match out of bounds.
+	int invalid;
+
+	/// Queries for which the distances of findTopK() differ.
+	int topKMismatches;
+
+	CheckResult() :
+		settings(), queries(0), matchable(0), missed(0), worse(0),
+		invalid(0), topKMismatches(0)
+	{ }
+
+	int mismatches() const
+		{ return missed + worse + invalid + topKMismatches; }
+
+	/// Fraction of the matchable queries find() missed.
+	double recallLoss() const
+		{ return (matchable > 0)? double(missed) / matchable : 0; }
+
+};
+
+static const int topK = 5;
+
+/**
+ * Returns the distances of all entries within maxTypos to
+ * encodedNeedle, ascending. Applies the same size filter as the
+ * dictionary, so a miss is a miss of the gram index.
+ */
+static QList<int> bruteForce(const QString& encodedNeedle, uint maxTypos,
+							 const QStringList& encodedEntries)
+{
+	QList<int> rv;
+	SimpleString needle(encodedNeedle);
+	foreach (const QString& entry, encodedEntries) {
+		// The dictionary skips entries whose size differs by more
+		// than maxTypos, like SearchInfo::sizeDiffersTooMuch().
+		if ((uint)qAbs(encodedNeedle.size() - entry.size()) > maxTypos)
+			continue;
+		int dist = EditDistance::calc(needle, SimpleString(entry), maxTypos,
+			EditDistance::SubstringMatch);
+		if (dist >= 0 && (uint)dist <= maxTypos)
+			rv.append(dist);
+	}
+	qSort(rv);
+	return rv;
+}
+
+static void removeFiles(QDir dir)
+{
+	foreach (const QString& name, dir.entryList(QDir::Files))
+		dir.remove(name);
+}
+
+static CheckResult check(const Generator::Settings& settings, int queryCount,
+						 const QDir& dir)
+{
+	CheckResult rv;
+	rv.settings = settings;
+
+	Generator generator(settings);
+	QStringList entries = generator.entries();
+	QStringList queries = generator.queries(entries, queryCount);
+
+	QString fileName = dir.filePath("dictionary.txt");
+	Dictionary dictionary;
+	if (Generator::write(entries, fileName) == false ||
+		dictionary.build(fileName) == false)
+	{
+		std::cerr << "Can't build " << qPrintable(fileName) << "\n";
+		rv.invalid = queryCount;
+		return rv;
+	}
+
+	QStringList encodedEntries;
+	foreach (const QString& entry, entries)
+		encodedEntries.append(dictionary.encode(entry));
+
+	foreach (const QString& query, queries) {
+		QString encodedNeedle = dictionary.encode(query);
+		if (encodedNeedle.isEmpty())
+			continue;
+		rv.queries++;
+		uint maxTypos = dictionary.calcMaxTypos(query);
+		QList<int> truth = bruteForce(encodedNeedle, maxTypos, encodedEntries);
+		if (truth.isEmpty() == false)
+			rv.matchable++;
+
+		QString result = dictionary.find(query);
+		if (result.isEmpty()) {
+			if (truth.isEmpty() == false)
+				rv.missed++;
+		}
+		else {
+			int dist = EditDistance::calc(SimpleString(encodedNeedle),
+				SimpleString(dictionary.encode(result)), maxTypos,
+				EditDistance::SubstringMatch);
+			if (dist < 0 || (uint)dist > maxTypos)
+				rv.invalid++;
+			else if (truth.isEmpty() || dist > truth.first())
+				rv.worse++;
+		}
+
+		QList<Dictionary::Match> matches = dictionary.findTopK(query, topK);
+		QList<int> expected = truth.mid(0, topK);
+		bool same = (matches.size() == expected.size());
+		for (int i = 0; same && i < matches.size(); i++)
+			same = ((int)matches[i].distance == expected[i]);
+		if (same == false)
+			rv.topKMismatches++;
+	}
+
+	removeFiles(dir);
+	return rv;
+}
+
+/**
+ * Returns the entries of sample which are not found as
+ * themselves.
+ */
+static int lookupFailures(const Dictionary& dictionary,
+						  const QStringList& sample)
+{
+	int rv = 0;
+	foreach (const QString& entry, sample) {
+		if (dictionary.find(entry) != entry)
+			rv++;
+	}
+	return rv;
+}
+
+/**
+ * Checks that the Containers keep their own keys when the
+ * dictionary goes through the files: build and save, load into
+ * a fresh dictionary, insert an entry with new grams, compact
+ * and load again. Returns the number of failed lookups.
+ */
+static int checkPersistence(const QDir& dir)
+{
+	Generator::Settings settings;
+	settings.entries = 2000;
+	Generator generator(settings);
+	QStringList entries = generator.entries();
+	QStringList sample = entries.mid(0, 200);
+	// Grams the syllables of the Generator never produce.
+	const QString inserted = "xqzj vwkx qjzv";
+
+	QString fileName = dir.filePath("persistence.txt");
+	{
+		Dictionary dictionary;
+		if (Generator::write(entries, fileName) == false ||
+			dictionary.build(fileName) == false ||
+			dictionary.save() == false)
+		{
+			std::cerr << "Can't build " << qPrintable(fileName) << "\n";
+			return sample.size() + 1;
+		}
+	}
+	{
+		Dictionary dictionary;
+		if (dictionary.load(fileName) == false ||
+			dictionary.insert(inserted) == false ||
+			dictionary.compact() == false)
+		{
+			std::cerr << "Can't update " << qPrintable(fileName) << "\n";
+			return sample.size() + 1;
+		}
+	}
+	Dictionary dictionary;
+	if (dictionary.load(fileName) == false) {
+		std::cerr << "Can't reload " << qPrintable(fileName) << "\n";
+		return sample.size() + 1;
+	}
+	int rv = lookupFailures(dictionary, sample);
+	if (dictionary.find(inserted) != inserted)
+		rv++;
+	return rv;
+}
+
+/**
+ * Collects the matches of findWithin() as (entry, distance) pairs.
+ */
+class MatchList : public AbstractMatchHandler
+{
+
+public:
+
+	QList<QPair<QString, uint> > matches;
+
+	virtual bool handle(quint32, uint distance, const QString& entry)
+	{
+		matches.append(qMakePair(entry, distance));
+		return true;
+	}
+
+};
+
+/**
+ * Returns the sorted matches of findWithin(query, calcMaxTypos()).
+ */
+static QList<QPair<QString, uint> > matchesWithin(const Dictionary& dictionary,
+												  const QString& query)
+{
+	MatchList handler;
+	dictionary.findWithin(query, dictionary.calcMaxTypos(query), handler);
+	qSort(handler.matches);
+	return handler.matches;
+}
+
+/**
+ * Checks that build() indexes the entries like inserting them one
+ * by one with insert(): both dictionaries must return the same
+ * matches for every query. Returns the number of queries with
+ * different matches.
+ */
+static int checkBuildEquivalence(const QDir& dir)
+{
+	Generator::Settings settings;
+	settings.entries = 2000;
+	Generator generator(settings);
+	QStringList entries = generator.entries();
+	QStringList queries = generator.queries(entries, 500);
+
+	QString fileName = dir.filePath("equivalence.txt");
+	Dictionary built;
+	if (Generator::write(entries, fileName) == false ||
+		built.build(fileName) == false)
+	{
+		std::cerr << "Can't build " << qPrintable(fileName) << "\n";
+		return queries.size();
+	}
+	Dictionary inserted;
+	foreach (const QString& entry, entries)
+		inserted.insert(entry);
+
+	int rv = 0;
+	foreach (const QString& query, queries) {
+		if (matchesWithin(built, query) != matchesWithin(inserted, query))
+			rv++;
+	}
+	return rv;
+}
+
+static void writeJson(const QList<CheckResult>& results, QTextStream& out)
+{
+	out << "{\n  \"configurations\": [";
+	for (int i = 0; i < results.size(); i++) {
+		const CheckResult& r = results[i];
+		out << (i > 0? ",\n" : "\n");
+		out << "    {\n";
+		out << "      \"seed\": " << r.settings.seed << ",\n";
+		out << "      \"entries\": " << r.settings.entries << ",\n";
+		out << "      \"mean_length\": " << r.settings.meanLength << ",\n";
+		out << "      \"typo_rate\": " << r.settings.typoRate << ",\n";
+		out << "      \"queries\": " << r.queries << ",\n";
+		out << "      \"matchable\": " << r.matchable << ",\n";
+		out << "      \"missed\": " << r.missed << ",\n";
+		out << "      \"worse\": " << r.worse << ",\n";
+		out << "      \"invalid\": " << r.invalid << ",\n";
+		out << "      \"topk_mismatches\": " << r.topKMismatches << ",\n";
+		out << "      \"recall_loss\": " << QString::number(r.recallLoss(), 'f', 6) << "\n";
+		out << "    }";
+	}
+	out << "\n  ]\n}\n";
+	out.flush();
+}
+
+static void usage()
+{
+	std::cerr << "Usage: dictcheck [options]\n"
+		"  --entries N       number of dictionary entries (2000 and 20000)\n"
+		"  --queries N       number of queries per configuration (500)\n"
+		"  --seed N          seed of the generator (42)\n"
+		"  --seeds N         number of seeds per configuration (1)\n"
+		"  --mean-length N   mean length of the entries (8, 16 and 32)\n"
+		"  --typo-rate R     probability of a typo per character (0.03 and 0.08)\n"
+		"  --out FILE        write the results as JSON to FILE\n";
+}
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+	QStringList args = app.arguments();
+
+	QList<int> entryCounts;
+	entryCounts << 2000 << 20000;
+	QList<int> meanLengths;
+	meanLengths << 8 << 16 << 32;
+	QList<double> typoRates;
+	typoRates << 0.03 << 0.08;
+	quint64 seed = 42;
+	int seeds = 1;
+	int queryCount = 500;
+	QString outFile;
+
+	for (int i = 1; i < args.size(); i++) {
+		const QString& arg = args[i];
+		if (i + 1 >= args.size()) {
+			usage();
+			return 2;
+		}
+		const QString value = args[++i];
+		if (arg == "--entries")
+			entryCounts = QList<int>() << value.toInt();
+		else if (arg == "--queries")
+			queryCount = value.toInt();
+		else if (arg == "--seed")
+			seed = value.toULongLong();
+		else if (arg == "--seeds")
+			seeds = qMax(value.toInt(), 1);
+		else if (arg == "--mean-length")
+			meanLengths = QList<int>() << value.toInt();
+		else if (arg == "--typo-rate")
+			typoRates = QList<double>() << value.toDouble();
+		else if (arg == "--out")
+			outFile = value;
+		else {
+			usage();
+			return 2;
+		}
+	}
+
+	QDir dir(QDir::temp().filePath(
+		QString("dictcheck-%1").arg(QCoreApplication::applicationPid())));
+	dir.mkpath(".");
+
+	int mismatches = checkPersistence(dir);
+	removeFiles(dir);
+	std::cout << "persistence: " << mismatches << " failed lookups\n";
+
+	int differences = checkBuildEquivalence(dir);
+	removeFiles(dir);
+	std::cout << "build vs. insert: " << differences << " queries differ\n";
+	mismatches += differences;
+
+	QList<CheckResult> results;
+	std::cout << "  seed  entries  length  typos  queries  matchable  missed"
+		"  worse  invalid  topk  recall loss\n";
+	foreach (int entries, entryCounts) {
+		foreach (int meanLength, meanLengths) {
+			foreach (double typoRate, typoRates) {
+				for (int s = 0; s < seeds; s++) {
+					Generator::Settings settings;
+					settings.seed = seed + s;
+					settings.entries = entries;
+					settings.meanLength = meanLength;
+					settings.lengthDeviation = qMax(meanLength / 3, 1);
+					settings.typoRate = typoRate;
+					CheckResult r = check(settings, queryCount, dir);
+					results.append(r);
+					mismatches += r.mismatches();
+					std::cout << qPrintable(QString("%1 %2 %3 %4 %5 %6 %7 %8 %9 %10 %11%\n")
+						.arg(settings.seed, 6).arg(entries, 8).arg(meanLength, 7)
+						.arg(typoRate, 6, 'f', 2).arg(r.queries, 8)
+						.arg(r.matchable, 10).arg(r.missed, 7).arg(r.worse, 6)
+						.arg(r.invalid, 8).arg(r.topKMismatches, 5)
+						.arg(r.recallLoss() * 100, 11, 'f', 3));
+				}
+			}
+		}
+	}
+	dir.rmdir(dir.absolutePath());
+
+	if (outFile.isEmpty() == false) {
+		QFile file(outFile);
+		if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+			std::cerr << "Can't write " << qPrintable(outFile) << "\n";
+			return 2;
+		}
+		QTextStream out(&file);
+		writeJson(results, out);
+	}
+
+	// Non-zero if the gram index lost a match, for use in scripts.
+	return (mismatches > 0)? 1 : 0;
+}
@@ -0,0 +1,547 @@
+#include <core/precompiled.h>
+
+#include <iostream>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+
+#include "Dictionary.h"
+#include "BitDistance.h"
+#include "CharHistogram.h"
+#include "EditDistance.h"
+#include "SimpleString.h"
+#include "Benchmark.h"
+#include "BenchmarkRunner.h"
+#include "Generator.h"
+
+using namespace Distiller;
+using namespace Distiller::Bench;
+
+/**
+ * Data shared by the benchmarks: the generated entries, the
+ * misspelled queries, the entries they were made from and their
+ * encoded forms.
+ */
+class Fixture
+{
+
+public:
+
+	QString fileName;
+
+	QStringList entries;
+
+	QStringList queries;
+
+	/// Index of the entry every query is a misspelling of.
+	QList<int> sources;
+
+	QStringList encodedEntries;
+
+	QStringList encodedQueries;
+
+	QList<QByteArray> utf8Queries;
+
+	Dictionary dictionary;
+
+};
+
+class BuildBenchmark : public Benchmark
+{
+
+	Fixture& f_;
+
+public:
+
+	BuildBenchmark(Fixture& f) : Benchmark("build"), f_(f)
+		{ }
+
+	int maxIterations() const
+		{ return 3; }
+
+	quint64 run()
+	{
+		// A failed build doesn't count.
+		Dictionary dictionary;
+		if (dictionary.build(f_.fileName) == false)
+			return 0;
+		return f_.entries.size();
+	}
+
+};
+
+class SaveBenchmark : public Benchmark
+{
+
+	Fixture& f_;
+
+public:
+
+	SaveBenchmark(Fixture& f) : Benchmark("save"), f_(f)
+		{ }
+
+	int maxIterations() const
+		{ return 5; }
+
+	quint64 run()
+	{
+		if (f_.dictionary.save() == false)
+			return 0;
+		return f_.entries.size();
+	}
+
+};
+
+class LoadBenchmark : public Benchmark
+{
+
+	Fixture& f_;
+
+public:
+
+	LoadBenchmark(Fixture& f) : Benchmark("load"), f_(f)
+		{ }
+
+	int maxIterations() const
+		{ return 5; }
+
+	quint64 run()
+	{
+		Dictionary dictionary;
+		if (dictionary.load(f_.fileName) == false)
+			return 0;
+		return f_.entries.size();
+	}
+
+};
+
+class FindBenchmark : public Benchmark
+{
+
+	Fixture& f_;
+
+public:
+
+	FindBenchmark(Fixture& f) : Benchmark("find"), f_(f)
+		{ }
+
+	bool setUp()
+	{
+		// Measure the search, not the result cache.
+		f_.dictionary.setResultCacheSize(0);
+		return f_.queries.isEmpty() == false;
+	}
+
+	quint64 run()
+	{
+		foreach (const QString& query, f_.queries)
+			f_.dictionary.find(query);
+		return f_.queries.size();
+	}
+
+};
+
+class FindKeyBenchmark : public Benchmark
+{
+
+	Fixture& f_;
+
+public:
+
+	FindKeyBenchmark(Fixture& f) : Benchmark("findKey/utf8"), f_(f)
+		{ }
+
+	bool setUp()
+	{
+		f_.dictionary.setResultCacheSize(0);
+		return f_.utf8Queries.isEmpty() == false;
+	}
+
+	quint64 run()
+	{
+		foreach (const QByteArray& query, f_.utf8Queries)
+			f_.dictionary.findKey(query.constData(), query.size());
+		return f_.utf8Queries.size();
+	}
+
+};
+
+class FindTopKBenchmark : public Benchmark
+{
+
+	Fixture& f_;
+
+public:
+
+	FindTopKBenchmark(Fixture& f) : Benchmark("findTopK/10"), f_(f)
+		{ }
+
+	bool setUp()
+		{ return f_.queries.isEmpty() == false; }
+
+	quint64 run()
+	{
+		foreach (const QString& query, f_.queries)
+			f_.dictionary.findTopK(query, 10);
+		return f_.queries.size();
+	}
+
+};
+
+class EncodeBenchmark : public Benchmark
+{
+
+	Fixture& f_;
+
+public:
+
+	EncodeBenchmark(Fixture& f) : Benchmark("encode"), f_(f)
+		{ }
+
+	quint64 run()
+	{
+		foreach (const QString& query, f_.queries)
+			f_.dictionary.encode(query);
+		return f_.queries.size();
+	}
+
+};
+
+/**
+ * Runs an edit distance kernel on pairs of (query, entry) the
+ * query has been generated from, so most pairs are close.
+ */
+class EditDistanceBenchmark : public Benchmark
+{
+
+public:
+
+	enum Kernel
+	{
+		UkkonenExact,
+		UkkonenSubstring,
+		UkkonenPrefix,
+		LevenshteinExact
+	};
+
+private:
+
+	Fixture& f_;
+
+	Kernel kernel_;
+
+	uint maxTypos_;
+
+	static QString kernelName(Kernel kernel);
+
+public:
+
+	EditDistanceBenchmark(Fixture& f, Kernel kernel, uint maxTypos) :
+		Benchmark(QString("EditDistance/%1/%2").arg(kernelName(kernel)).arg(maxTypos)),
+		f_(f),
+		kernel_(kernel),
+		maxTypos_(maxTypos)
+	{ }
+
+	quint64 run()
+	{
+		int count = f_.encodedQueries.size();
+		for (int i = 0; i < count; i++) {
+			SimpleString pattern(f_.encodedQueries[i]);
+			// The entry the query has been made from.
+			SimpleString text(f_.encodedEntries[f_.sources[i]]);
+			switch (kernel_) {
+			case UkkonenExact:
+				EditDistance::Ukkonen_exact(pattern, text, maxTypos_);
+				break;
+			case UkkonenSubstring:
+				EditDistance::Ukkonen_substring(pattern, text, maxTypos_);
+				break;
+			case UkkonenPrefix:
+				EditDistance::Ukkonen_prefix(pattern, text, maxTypos_);
+				break;
+			case LevenshteinExact:
+				EditDistance::Levenshtein_exact(pattern, text);
+				break;
+			}
+		}
+		return count;
+	}
+
+};
+
+QString EditDistanceBenchmark::kernelName(Kernel kernel)
+{
+	switch (kernel) {
+	case UkkonenExact: return "Ukkonen_exact";
+	case UkkonenSubstring: return "Ukkonen_substring";
+	case UkkonenPrefix: return "Ukkonen_prefix";
+	case LevenshteinExact: return "Levenshtein_exact";
+	}
+	return QString();
+}
+
+class BitPatternBenchmark : public Benchmark
+{
+
+	Fixture& f_;
+
+public:
+
+	BitPatternBenchmark(Fixture& f) : Benchmark("BitDistance/bitPattern"), f_(f)
+		{ }
+
+	quint64 run()
+	{
+		quint64 sink = 0;
+		foreach (const QString& entry, f_.encodedEntries)
+			sink ^= BitDistance::bitPattern(entry.unicode(), entry.size());
+		// Keep the compiler from dropping the loop.
+		volatile quint64 result = sink;
+		Q_UNUSED(result);
+		return f_.encodedEntries.size();
+	}
+
+};
+
+class BitMinDistanceBenchmark : public Benchmark
+{
+
+	Fixture& f_;
+
+	QVector<quint64> queries_;
+
+	QVector<quint64> entries_;
+
+public:
+
+	BitMinDistanceBenchmark(Fixture& f) :
+		Benchmark("BitDistance/minDistance"), f_(f), queries_(), entries_()
+	{ }
+
+	bool setUp()
+	{
+		// Every query is paired with the entry it has been made from.
+		foreach (const QString& query, f_.encodedQueries)
+			queries_.append(BitDistance::bitPattern(query.unicode(), query.size()));
+		foreach (int source, f_.sources) {
+			const QString& entry = f_.encodedEntries[source];
+			entries_.append(BitDistance::bitPattern(entry.unicode(), entry.size()));
+		}
+		return entries_.isEmpty() == false;
+	}
+
+	quint64 run()
+	{
+		uint sink = 0;
+		for (int i = 0; i < queries_.size(); i++)
+			sink += BitDistance::minDistance(queries_[i], entries_[i]);
+		volatile uint result = sink;
+		Q_UNUSED(result);
+		return queries_.size();
+	}
+
+	void tearDown()
+	{
+		queries_.clear();
+		entries_.clear();
+	}
+
+};
+
+class HistogramBenchmark : public Benchmark
+{
+
+	Fixture& f_;
+
+	QVector<CharHistogram> queries_;
+
+	QVector<CharHistogram> entries_;
+
+public:
+
+	HistogramBenchmark(Fixture& f) :
+		Benchmark("CharHistogram/minDistance"), f_(f), queries_(), entries_()
+	{ }
+
+	bool setUp()
+	{
+		// Every query is paired with the entry it has been made from.
+		foreach (const QString& query, f_.encodedQueries)
+			queries_.append(CharHistogram(query.unicode(), query.size()));
+		foreach (int source, f_.sources) {
+			const QString& entry = f_.encodedEntries[source];
+			entries_.append(CharHistogram(entry.unicode(), entry.size()));
+		}
+		return entries_.isEmpty() == false;
+	}
+
+	quint64 run()
+	{
+		uint sink = 0;
+		for (int i = 0; i < queries_.size(); i++)
+			sink += CharHistogram::minDistance(queries_[i], entries_[i]);
+		volatile uint result = sink;
+		Q_UNUSED(result);
+		return queries_.size();
+	}
+
+	void tearDown()
+	{
+		queries_.clear();
+		entries_.clear();
+	}
+
+};
+
+static void usage()
+{
+	std::cerr << "Usage: dictbench [options]\n"
+		"  --entries N       number of dictionary entries (100000)\n"
+		"  --queries N       number of queries (10000)\n"
+		"  --seed N          seed of the generator (42)\n"
+		"  --mean-length N   mean length of the entries (16)\n"
+		"  --typo-rate R     probability of a typo per character (0.05)\n"
+		"  --min-time MS     minimum time per benchmark (500)\n"
+		"  --filter TEXT     run only benchmarks whose name contains TEXT\n"
+		"  --out FILE        write the JSON results to FILE (stdout)\n";
+}
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+	QStringList args = app.arguments();
+
+	Generator::Settings settings;
+	int queryCount = 10000;
+	QString outFile;
+	BenchmarkRunner runner;
+
+	for (int i = 1; i < args.size(); i++) {
+		const QString& arg = args[i];
+		if (i + 1 >= args.size()) {
+			usage();
+			return 1;
+		}
+		const QString value = args[++i];
+		if (arg == "--entries")
+			settings.entries = value.toInt();
+		else if (arg == "--queries")
+			queryCount = value.toInt();
+		else if (arg == "--seed")
+			settings.seed = value.toULongLong();
+		else if (arg == "--mean-length")
+			settings.meanLength = value.toInt();
+		else if (arg == "--typo-rate")
+			settings.typoRate = value.toDouble();
+		else if (arg == "--min-time")
+			runner.setMinTime(value.toInt());
+		else if (arg == "--filter")
+			runner.setFilter(value);
+		else if (arg == "--out")
+			outFile = value;
+		else {
+			usage();
+			return 1;
+		}
+	}
+
+	Fixture f;
+	Generator generator(settings);
+	f.entries = generator.entries();
+	f.queries = generator.queries(f.entries, queryCount, &f.sources);
+	foreach (const QString& query, f.queries)
+		f.utf8Queries.append(query.toUtf8());
+
+	QDir dir(QDir::temp().filePath(
+		QString("dictbench-%1").arg(QCoreApplication::applicationPid())));
+	dir.mkpath(".");
+	f.fileName = dir.filePath("dictionary.txt");
+	if (Generator::write(f.entries, f.fileName) == false) {
+		std::cerr << "Can't write " << qPrintable(f.fileName) << "\n";
+		return 1;
+	}
+	if (f.dictionary.build(f.fileName) == false) {
+		std::cerr << "Can't build " << qPrintable(f.fileName) << "\n";
+		return 1;
+	}
+	// The load benchmark reads the index files.
+	if (f.dictionary.save() == false) {
+		std::cerr << "Can't save " << qPrintable(f.fileName) << "\n";
+		return 1;
+	}
+	{
+		Dictionary loaded;
+		if (loaded.load(f.fileName) == false) {
+			std::cerr << "Can't load " << qPrintable(f.fileName) << "\n";
+			return 1;
+		}
+	}
+	foreach (const QString& entry, f.entries)
+		f.encodedEntries.append(f.dictionary.encode(entry));
+	foreach (const QString& query, f.queries)
+		f.encodedQueries.append(f.dictionary.encode(query));
+
+	runner.addContext("seed", QString::number(settings.seed));
+	runner.addContext("entries", QString::number(settings.entries));
+	runner.addContext("queries", QString::number(queryCount));
+	runner.addContext("mean_length", QString::number(settings.meanLength));
+	runner.addContext("typo_rate", QString::number(settings.typoRate));
+	runner.addContext("threads", QString::number(QThread::idealThreadCount()));
+
+	BuildBenchmark build(f);
+	SaveBenchmark save(f);
+	LoadBenchmark load(f);
+	FindBenchmark find(f);
+	FindKeyBenchmark findKey(f);
+	FindTopKBenchmark findTopK(f);
+	EncodeBenchmark encode(f);
+	EditDistanceBenchmark ukkonenExact(f, EditDistanceBenchmark::UkkonenExact, 2);
+	EditDistanceBenchmark ukkonenSubstring(f, EditDistanceBenchmark::UkkonenSubstring, 2);
+	EditDistanceBenchmark ukkonenPrefix(f, EditDistanceBenchmark::UkkonenPrefix, 2);
+	EditDistanceBenchmark levenshteinExact(f, EditDistanceBenchmark::LevenshteinExact, 0);
+	BitPatternBenchmark bitPattern(f);
+	BitMinDistanceBenchmark bitMinDistance(f);
+	HistogramBenchmark histogram(f);
+
+	// save has to run before load, so load finds the index files.
+	Benchmark* benchmarks[] = {
+		&build, &save, &load, &find, &findKey, &findTopK, &encode,
+		&ukkonenExact, &ukkonenSubstring, &ukkonenPrefix, &levenshteinExact,
+		&bitPattern, &bitMinDistance, &histogram
+	};
+	int count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+	int rv = 0;
+	for (int i = 0; i < count; i++) {
+		std::cerr << qPrintable(benchmarks[i]->name()) << "\n";
+		if (runner.run(*benchmarks[i]) == false) {
+			std::cerr << "  failed\n";
+			rv = 1;
+		}
+	}
+
+	if (outFile.isEmpty()) {
+		QTextStream out(stdout);
+		runner.writeJson(out);
+	}
+	else {
+		QFile file(outFile);
+		if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+			std::cerr << "Can't write " << qPrintable(outFile) << "\n";
+			return 1;
+		}
+		QTextStream out(&file);
+		runner.writeJson(out);
+	}
+
+	// Remove the textfile and the index files.
+	foreach (const QString& name, dir.entryList(QDir::Files))
+		dir.remove(name);
+	dir.rmdir(dir.absolutePath());
+
+	return rv;
+}
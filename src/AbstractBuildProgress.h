@@ -0,0 +1,46 @@
+#ifndef DISTILLER_ABSTRACTBUILDPROGRESS_H
+#define DISTILLER_ABSTRACTBUILDPROGRESS_H
+
+#pragma once
+
+namespace Distiller {
+
+/**
+ * Receives progress reports while a dictionary is built.
+ *
+ * progress() is always called from the thread that started
+ * the build, never from one of the worker threads.
+ */
+class AbstractBuildProgress
+{
+
+public:
+
+	enum Stage {
+		/// Reading and encoding the lines of the input.
+		Encoding,
+		/// Removing duplicates and assigning keys.
+		Deduplicating,
+		/// Collecting the grams of every entry.
+		Indexing,
+		/// Merging the collected grams into the GramHash.
+		Merging
+	};
+
+	AbstractBuildProgress()
+		{ }
+
+	virtual ~AbstractBuildProgress()
+		{ }
+
+	/**
+	 * done is the number of processed units of the current stage,
+	 * total the number of units to process.
+	 */
+	virtual void progress(Stage stage, quint64 done, quint64 total) = 0;
+
+};
+
+} // namespace Distiller
+
+#endif
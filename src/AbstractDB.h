@@ -25,6 +25,12 @@ public:
 	virtual void load(const Container* container) = 0;
 	virtual bool load(Private& d) = 0;
 	virtual bool save(const Private& d) = 0;
+
+	/**
+	 * Bytes the DB keeps for loading the Containers lazily.
+	 */
+	virtual quint64 memoryUsage() const
+		{ return 0; }
 };
 
 } // namespace DictionaryImpl
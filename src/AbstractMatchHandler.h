@@ -0,0 +1,39 @@
+#ifndef DISTILLER_ABSTRACTMATCHHANDLER_H
+#define DISTILLER_ABSTRACTMATCHHANDLER_H
+
+#pragma once
+
+class QString;
+
+namespace Distiller {
+
+/**
+ * Receives the matches of Dictionary::findWithin() one after
+ * the other, so the matches are never collected in a container.
+ */
+class AbstractMatchHandler
+{
+
+public:
+
+	AbstractMatchHandler()
+		{ }
+		
+	virtual ~AbstractMatchHandler()
+		{ }
+	
+	/**
+	 * Called for every match. Return false to stop the query.
+	 *
+	 * \note The dictionary is locked for reading while the handler
+	 * runs. The handler may query the dictionary, but it must not
+	 * modify it: it would wait for its own read lock. Debug builds
+	 * assert this.
+	 */
+	virtual bool handle(quint32 key, uint distance, const QString& entry) = 0;
+	
+};
+
+} // namespace Distiller
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef DISTILLER_ABSTRACTNORMALIZER_H
+#define DISTILLER_ABSTRACTNORMALIZER_H
+
+#pragma once
+
+#include <QString>
+
+namespace Distiller {
+
+/**
+ * Normalizes entries and needles before they are encoded.
+ *
+ * The same normalizer has to be applied when the dictionary is
+ * built and when it is queried, so its name() is stored in the
+ * index files. Index files written with another normalizer are not
+ * loaded, the dictionary is rebuilt from the textfile instead.
+ *
+ * normalize() is called concurrently from the build threads and
+ * the queries and must not modify the normalizer.
+ */
+class AbstractNormalizer
+{
+
+public:
+
+	AbstractNormalizer()
+		{ }
+
+	virtual ~AbstractNormalizer()
+		{ }
+
+	/**
+	 * Identifies the normalization, e.g. "diacritics". Change the
+	 * name whenever the result of normalize() changes.
+	 */
+	virtual QString name() const = 0;
+
+	virtual QString normalize(const QString& text) const = 0;
+
+};
+
+} // namespace Distiller
+
+#endif
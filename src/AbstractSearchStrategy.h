@@ -4,13 +4,18 @@
 #pragma once
 
 #include "DebugInfo.h"
+#include "KeyDistTuple.h"
 
 namespace Distiller
 {
 
+class AbstractMatchHandler;
+
 namespace DictionaryImpl
 {
 
+class QueryTrace;
+
 class AbstractSearchStrategy
 {
 
@@ -26,6 +31,38 @@ public:
 
 	virtual QString search(const QString& needle,
 		Dictionary::DebugInfo* debugInfo) = 0;
+
+	/**
+	 * stats may be 0.
+	 */
+	virtual QString search(const QString& needle,
+		const Dictionary::QueryOptions& options,
+		Dictionary::QueryStats* stats,
+		Dictionary::DebugInfo* debugInfo) = 0;
+
+	/**
+	 * Like search(), but takes an encoded needle and returns the
+	 * key of the match. The key is invalid if nothing is found.
+	 * If trace is given, the best match of every gram is recorded.
+	 */
+	virtual KeyDistTuple searchKey(const QString& encodedNeedle,
+		const Dictionary::QueryOptions& options,
+		Dictionary::QueryStats* stats,
+		Dictionary::DebugInfo* debugInfo,
+		QueryTrace* trace = 0) = 0;
+
+	/**
+	 * Returns the k best matches of an encoded needle, best first.
+	 */
+	virtual QList<KeyDistTuple> searchTopK(const QString& encodedNeedle,
+		int k) = 0;
+
+	/**
+	 * Hands every match within options.maxTypos to handler.
+	 */
+	virtual void searchWithin(const QString& needle,
+		const Dictionary::QueryOptions& options,
+		AbstractMatchHandler& handler) = 0;
 	
 };
 
@@ -30,10 +30,18 @@ quint8 BitDistance::sparse_bitcount(quint64 n)
 
   00000000011111111112222222222333333333344444444445555555555666
   12345678901234567890123456789012345678901234567890123456789012
-  abcdefghijklmnopqrstuvwxyz 0123456789
+  abcdefghijklmnopqrstuvwxyz 0123456789###########################
+
+  The characters outside ASCII (#) share the remaining bits.
   
 */
 
+/// First bit of the characters outside ASCII.
+static const int firstForeignBit = 37;
+
+/// Number of bits of the characters outside ASCII.
+static const int foreignBits = 64 - firstForeignBit;
+
 quint64 BitDistance::char2bit(const char c)
 {
 	switch (c) {
@@ -87,6 +95,19 @@ quint64 BitDistance::bitPattern(const char *string)
 	return rv;
 }
 
+quint64 BitDistance::bitPattern(const QChar* string, int size)
+{
+	quint64 rv = 0;
+	for (int i = 0; i < size; i++) {
+		ushort uc = string[i].unicode();
+		if (uc < 0x80)
+			rv |= char2bit(static_cast<char>(uc));
+		else
+			rv |= Q_UINT64_C(1) << (firstForeignBit + uc % foreignBits);
+	}
+	return rv;
+}
+
 quint8 BitDistance::minDistance(const char* str1, const char* str2)
 {
         quint64 bit1 = bitPattern(str1);
@@ -108,6 +129,11 @@ quint8 BitDistance::minDistance(quint64 bit1, quint64 bit2)
         return sparse_bitcount(rv) / 2;
 }
 
+quint8 BitDistance::minPrefixDistance(quint64 pattern, quint64 text)
+{
+        return sparse_bitcount(pattern & ~text);
+}
+
 } // namespace DictionaryImpl
 
 } // namespace Distiller
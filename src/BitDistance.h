@@ -57,12 +57,28 @@ public:
 	~BitDistance();
 
     static quint64 bitPattern(const char *string);
+
+	/**
+	 * Same as bitPattern(const char*) for an encoded string,
+	 * without converting it to ASCII first. Characters outside
+	 * ASCII are spread over the 27 bits not used by a-z, ' ' and
+	 * 0-9, so entries in other alphabets are filtered as well.
+	 */
+	static quint64 bitPattern(const QChar* string, int size);
 	
 	static quint8 minDistance(const char* str1, const char* str2);
 	
     static quint8 minDistance(const char* str, quint64 bit2);
 	
     static quint8 minDistance(quint64 bit1, quint64 bit2);
+
+	/**
+	 * Lower bound of the edit distance of pattern to a prefix
+	 * (or substring) of text: every character of pattern which
+	 * doesn't occur in text costs at least one edit step.
+	 * Characters of text missing in pattern are free.
+	 */
+	static quint8 minPrefixDistance(quint64 pattern, quint64 text);
 };
 
 } // namespace DictionaryImpl
@@ -0,0 +1,32 @@
+#include <core/precompiled.h>
+
+#include "DictionaryDefines.h"
+#include "QueryBudget.h"
+#include "BudgetAccount.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+BudgetAccount::BudgetAccount(QueryBudget* budget) :
+	budget_(budget),
+	granted_(0),
+	candidates_(0)
+{ }
+
+bool BudgetAccount::reserve()
+{
+	granted_ = budget_->reserve();
+	return granted_ > 0;
+}
+
+bool BudgetAccount::exhausted()
+{
+	return budget_ != 0 && budget_->exhausted();
+}
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
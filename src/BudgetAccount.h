@@ -0,0 +1,74 @@
+#ifndef DISTILLER_DICTIONARYIMPL_BUDGETACCOUNT_H
+#define DISTILLER_DICTIONARYIMPL_BUDGETACCOUNT_H
+
+#pragma once
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+class QueryBudget;
+
+/**
+ * Counts the candidates a single thread of a query verifies.
+ *
+ * If the query has a QueryBudget, the account reserves
+ * candidates from it in batches and hands them out one by one,
+ * so the threads of a query only touch the shared budget once
+ * per batch instead of once per candidate.
+ */
+class BudgetAccount
+{
+
+	/// May be 0 if the query isn't limited.
+	QueryBudget* budget_;
+
+	/// Candidates reserved from budget_ but not charged yet.
+	uint granted_;
+
+	uint candidates_;
+
+	/**
+	 * Reserves the next batch of candidates. Returns false if
+	 * the budget is exhausted.
+	 */
+	bool reserve();
+
+public:
+
+	BudgetAccount(QueryBudget* budget = 0);
+
+	/**
+	 * Charges a candidate. Returns false if the budget is
+	 * exhausted and the candidate must not be verified.
+	 */
+	bool charge()
+	{
+		if (budget_ != 0) {
+			if (granted_ == 0 && reserve() == false)
+				return false;
+			granted_--;
+		}
+		candidates_++;
+		return true;
+	}
+
+	/**
+	 * Checks the clock and the token of the budget. Returns
+	 * true if the query has to stop.
+	 */
+	bool exhausted();
+
+	/// Number of candidates charged.
+	uint candidates() const
+		{ return candidates_; }
+
+};
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
+
+#endif 
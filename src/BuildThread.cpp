@@ -0,0 +1,176 @@
+#include <core/precompiled.h>
+
+#include "DictionaryDefines.h"
+#include "Private.h"
+#include "BitDistance.h"
+#include "CharHistogram.h"
+#include "BuildThread.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+/// Report progress every progressInterval lines.
+static const int progressInterval = 1024;
+
+BuildThread::BuildThread(const Private& d) :
+	QThread(),
+	d_(d),
+	pass_(EncodePass),
+	fileName_(),
+	begin_(0),
+	end_(0),
+	lines_(),
+	encodedLines_(),
+	bitPatterns_(),
+	histograms_(),
+	keys_(),
+	grams_(),
+	processed_(0),
+	failed_(false),
+	processedLock_()
+{ }
+
+BuildThread::~BuildThread()
+{
+	wait();
+}
+
+void BuildThread::setInput(const QString& fileName, qint64 begin, qint64 end)
+{
+	fileName_ = fileName;
+	begin_ = begin;
+	end_ = end;
+	lines_.clear();
+}
+
+void BuildThread::setInput(const QStringList& lines)
+{
+	fileName_.clear();
+	begin_ = 0;
+	end_ = 0;
+	lines_ = lines;
+}
+
+void BuildThread::setPass(Pass pass)
+{
+	pass_ = pass;
+	setProcessed(0);
+}
+
+void BuildThread::setProcessed(quint64 processed)
+{
+	QMutexLocker locker(&processedLock_);
+	processed_ = processed;
+}
+
+quint64 BuildThread::processed() const
+{
+	QMutexLocker locker(&processedLock_);
+	return processed_;
+}
+
+void BuildThread::clear()
+{
+	lines_.clear();
+	encodedLines_.clear();
+	bitPatterns_.clear();
+	histograms_.clear();
+	keys_.clear();
+	grams_.clear();
+}
+
+bool BuildThread::readLines()
+{
+	QFile file(fileName_);
+	if (!file.open(QIODevice::ReadOnly) || !file.seek(begin_))
+		return false;
+
+	qint64 pos = begin_;
+	while (pos < end_ && !file.atEnd()) {
+		QByteArray line = file.readLine();
+		pos += line.size();
+		if (line.endsWith('\n'))
+			line.chop(1);
+		if (line.endsWith('\r'))
+			line.chop(1);
+		if (begin_ == 0 && lines_.isEmpty() && line.startsWith("\xEF\xBB\xBF"))
+			// Skip the UTF-8 byte order mark.
+			line.remove(0, 3);
+		lines_.append(QString::fromUtf8(line.constData(), line.size()));
+		if (lines_.size() % progressInterval == 0)
+			setProcessed(pos - begin_);
+	}
+	setProcessed(end_ - begin_);
+	// The file may have been shortened since the shards were cut.
+	return pos >= end_;
+}
+
+void BuildThread::encodeLines()
+{
+	encodedLines_.clear();
+	bitPatterns_.clear();
+	histograms_.clear();
+	encodedLines_.reserve(lines_.size());
+	bitPatterns_.reserve(lines_.size());
+	histograms_.reserve(lines_.size());
+
+	for (int i = 0; i < lines_.size(); i++) {
+		QString encodedLine = d_.encode(lines_[i]);
+		encodedLines_.append(encodedLine);
+		bitPatterns_.append(
+			BitDistance::bitPattern(encodedLine.unicode(), encodedLine.size()));
+		histograms_.append(
+			CharHistogram(encodedLine.unicode(), encodedLine.size()));
+		if (fileName_.isEmpty() && (i + 1) % progressInterval == 0)
+			setProcessed(i + 1);
+	}
+	if (fileName_.isEmpty())
+		setProcessed(lines_.size());
+	keys_.fill(KeyDistTuple::invalidKey, lines_.size());
+}
+
+void BuildThread::collectGrams()
+{
+	grams_.clear();
+
+	for (int i = 0; i < encodedLines_.size(); i++) {
+		KeyType key = keys_[i];
+		if (key == KeyDistTuple::invalidKey)
+			// Empty or duplicate entry.
+			continue;
+		QStringList grams = d_.grams(encodedLines_[i]);
+		foreach (const QString& gram, grams) {
+			QVector<KeyType>& keys = grams_[gram];
+			// A gram can occur more than once in the same entry.
+			if (keys.isEmpty() || keys.last() != key)
+				keys.append(key);
+		}
+		if ((i + 1) % progressInterval == 0)
+			setProcessed(i + 1);
+	}
+	setProcessed(encodedLines_.size());
+}
+
+void BuildThread::run()
+{
+	switch (pass_) {
+		case EncodePass:
+			failed_ = false;
+			if (!fileName_.isEmpty() && !readLines()) {
+				failed_ = true;
+				break;
+			}
+			encodeLines();
+			break;
+		case GramPass:
+			collectGrams();
+			break;
+	}
+}
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
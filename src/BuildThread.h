@@ -0,0 +1,171 @@
+#ifndef DISTILLER_DICTIONARYIMPL_BUILDTHREAD_H
+#define DISTILLER_DICTIONARYIMPL_BUILDTHREAD_H
+
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+
+#include "BitDistance.h"
+#include "CharHistogram.h"
+#include "KeyDistTuple.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+class Private;
+
+/**
+ * When building the dictionary the input is cut into shards of
+ * adjacent lines and every shard is processed by its own BuildThread.
+ *
+ * The build runs in two passes:
+ *
+ * EncodePass: The thread reads its lines (either from a byte range
+ *             of the dictionary file or from a slice of a string list),
+ *             encodes them and calculates their bit patterns.
+ *
+ * GramPass:   After the Builder has removed duplicates and assigned
+ *             the keys, the thread collects the grams of its entries
+ *             in a thread-local hash gram --> keys. Like
+ *             Private::insert() it adds the key of an entry once
+ *             per distinct gram, even if the gram occurs several
+ *             times in the entry. The former line by line build
+ *             added it per occurrence, see Builder.
+ *
+ * Since the shards are adjacent and processed in order, the keys of
+ * a shard are ascending and smaller than the keys of the next shard.
+ * Merging the thread-local hashes shard by shard therefore keeps the
+ * keys of every Container in ascending order.
+ */
+class BuildThread : public QThread
+{
+
+public:
+
+	enum Pass { EncodePass, GramPass };
+
+	typedef QHash<QString, QVector<KeyType> > GramBuffer;
+
+private:
+
+	const Private& d_;
+
+	Pass pass_;
+
+	/// Dictionary file to read from. Empty if lines_ is given.
+	QString fileName_;
+
+	/// Byte range [begin_, end_) of the file to read.
+	qint64 begin_;
+
+	qint64 end_;
+
+	/// The (raw) lines of this shard.
+	QStringList lines_;
+
+	/// The encoded lines of this shard.
+	QStringList encodedLines_;
+
+	/// The bit patterns of the encoded lines.
+	BitpatternList bitPatterns_;
+
+	/// The character histograms of the encoded lines.
+	HistogramList histograms_;
+
+	/**
+	 * The key of every line. Lines which have been
+	 * dropped by the Builder have KeyDistTuple::invalidKey.
+	 */
+	QVector<KeyType> keys_;
+
+	/// Thread-local gram --> keys relations.
+	GramBuffer grams_;
+
+	/// Number of processed units of the current pass.
+	quint64 processed_;
+
+	/// Set if the shard couldn't be read.
+	bool failed_;
+
+	mutable QMutex processedLock_;
+
+	void setProcessed(quint64 processed);
+
+	/**
+	 * Reads the lines of the byte range. Returns false if the
+	 * file can't be read.
+	 */
+	bool readLines();
+
+	void encodeLines();
+
+	void collectGrams();
+
+public:
+
+	BuildThread(const Private& d);
+
+	~BuildThread();
+
+	/**
+	 * Process the lines in the byte range [begin, end) of fileName.
+	 * begin and end must be positions right after a line break
+	 * (or the beginning and end of the file).
+	 */
+	void setInput(const QString& fileName, qint64 begin, qint64 end);
+
+	/**
+	 * Process the given lines.
+	 */
+	void setInput(const QStringList& lines);
+
+	void setPass(Pass pass);
+
+	/**
+	 * Number of units processed in the current pass: bytes read
+	 * in the EncodePass, lines in the GramPass.
+	 */
+	quint64 processed() const;
+
+	/**
+	 * Returns true if the last EncodePass couldn't read the shard.
+	 */
+	bool failed() const
+		{ return failed_; }
+
+	const QStringList& lines() const
+		{ return lines_; }
+
+	const QStringList& encodedLines() const
+		{ return encodedLines_; }
+
+	const BitpatternList& bitPatterns() const
+		{ return bitPatterns_; }
+
+	const HistogramList& histograms() const
+		{ return histograms_; }
+
+	QVector<KeyType>& keys()
+		{ return keys_; }
+
+	const GramBuffer& grams() const
+		{ return grams_; }
+
+	/**
+	 * Frees the memory of all buffers.
+	 */
+	void clear();
+
+	void run();
+
+};
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
+
+#endif
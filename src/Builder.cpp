@@ -1,11 +1,9 @@
 #include <core/precompiled.h>
 
-#include <QTime>
-
 #include "DictionaryDefines.h"
 #include "Private.h"
 #include "DictException.h"
-#include "BitDistance.h"
+#include "BuildThread.h"
 #include "Builder.h"
 
 namespace Distiller
@@ -14,95 +12,200 @@ namespace Distiller
 namespace DictionaryImpl
 {
 
-void Builder::addGram(const QString& gram, quint32 key)
+Builder::Builder(Dictionary& dict, AbstractBuildProgress* progress) :
+	d_(*dict.d_),
+	progress_(progress),
+	threadCount_(qMax(1, QThread::idealThreadCount())),
+	threads_(),
+	encodedEntries_()
+{ }
+
+Builder::~Builder()
+{
+	deleteThreads();
+}
+
+void Builder::setThreadCount(int count)
+{
+	threadCount_ = qMax(1, count);
+}
+
+void Builder::createThreads(int count)
+{
+	deleteThreads();
+	try {
+		while (count-- > 0)
+			threads_.append(new BuildThread(d_));
+	}
+	catch (...) {
+		deleteThreads();
+		throw;
+	}
+}
+
+void Builder::deleteThreads()
+{
+	qDeleteAll(threads_);
+	threads_.clear();
+}
+
+void Builder::reportProgress(AbstractBuildProgress::Stage stage,
+							 quint64 done, quint64 total)
+{
+	if (progress_)
+		progress_->progress(stage, done, total);
+}
+
+quint64 Builder::assignShards(const QString& dictFile)
+{
+	QFile file(dictFile);
+	if (!file.open(QIODevice::ReadOnly))
+		return 0;
+	qint64 size = file.size();
+	int count = threadCount_;
+	if (size < minShardSize_ * count)
+		count = qMax<int>(1, size / minShardSize_);
+	createThreads(count);
+
+	qint64 begin = 0;
+	for (int i = 0; i < count; i++) {
+		qint64 end = size;
+		if (i < count - 1) {
+			// Move the end of the shard behind the next line break.
+			file.seek(qMax(begin, (size / count) * (i + 1)));
+			file.readLine();
+			end = file.pos();
+		}
+		threads_[i]->setInput(dictFile, begin, end);
+		begin = end;
+	}
+	return size;
+}
+
+quint64 Builder::assignShards(const QStringList& stringList)
 {
-	d_.gramHash_.insert(gram, key);
+	int count = qMin(threadCount_, qMax(1, stringList.size()));
+	createThreads(count);
+
+	int shardSize = stringList.size() / count;
+	for (int i = 0; i < count; i++) {
+		int length = (i < count - 1)? shardSize : -1;
+		threads_[i]->setInput(stringList.mid(i * shardSize, length));
+	}
+	return stringList.size();
 }
 
-void Builder::processLine(const QString& line)
+void Builder::runThreads(BuildThread::Pass pass,
+						 AbstractBuildProgress::Stage stage, quint64 total)
 {
-	if (static_cast<uint>(d_.encodedEntries_.size()) == KEYTYPE_MAX)
-		throw Exception(Exception::TooManyEntries);
-	
-	QString encodedLine = d_.encode(line);
-	quint32 encodedLineSize = encodedLine.size();
-	if (encodedLineSize == 0) return;
-	if (encodedEntries_.contains(encodedLine)) return;
-	encodedEntries_.insert(encodedLine);
-	
-	d_.encodedEntries_.append(encodedLine);
-	d_.entries_.append(line);
-	d_.bitencodedEntries_.append(BitDistance::bitPattern(encodedLine.toAscii().constData()));
-	Q_ASSERT(d_.encodedEntries_.size() == 
-		d_.entries_.size());
-	
-	int key = d_.encodedEntries_.size() - 1;
-	
-	if (encodedLineSize < d_.minGramSize())
-		// Too small for our dictionary.
-		return;
-	else if (encodedLineSize <= d_.gramSize()) {
-		// Take the whole encoded entry as a gram.
-		addGram(encodedLine, key);
+	foreach (BuildThread* thread, threads_) {
+		thread->setPass(pass);
+		thread->start();
 	}
-	else {
-		// Build all n-grams.
-		for (quint32 i = 0; 
-			 i < encodedLineSize - d_.minGramSize() + 1;
-			 i++)
+	bool finished = false;
+	while (!finished) {
+		finished = true;
+		quint64 done = 0;
+		foreach (BuildThread* thread, threads_) {
+			if (!thread->wait(100))
+				finished = false;
+			done += thread->processed();
+		}
+		reportProgress(stage, done, total);
+	}
+}
+
+void Builder::insertEntries(quint64 total)
+{
+	quint64 done = 0;
+	foreach (BuildThread* thread, threads_) {
+		const QStringList& lines = thread->lines();
+		const QStringList& encodedLines = thread->encodedLines();
+		const BitpatternList& bitPatterns = thread->bitPatterns();
+		const HistogramList& histograms = thread->histograms();
+		QVector<KeyType>& keys = thread->keys();
+
+		for (int i = 0; i < encodedLines.size(); i++) {
+			const QString& encodedLine = encodedLines[i];
+			if (encodedLine.isEmpty()) continue;
+			if (encodedEntries_.contains(encodedLine)) continue;
+			if (static_cast<uint>(d_.encodedEntries_.size()) == KEYTYPE_MAX)
+				throw Exception(Exception::TooManyEntries);
+			encodedEntries_.insert(encodedLine);
+
+			d_.encodedEntries_.append(encodedLine);
+			d_.entries_.append(lines[i]);
+			d_.bitencodedEntries_.append(bitPatterns[i]);
+			d_.histograms_.append(histograms[i]);
+			Q_ASSERT(d_.encodedEntries_.size() ==
+				d_.entries_.size());
+
+			keys[i] = d_.encodedEntries_.size() - 1;
+		}
+		done += encodedLines.size();
+		reportProgress(AbstractBuildProgress::Deduplicating, done, total);
+	}
+	// Not needed anymore.
+	encodedEntries_.clear();
+}
+
+void Builder::mergeGrams(quint64 total)
+{
+	quint64 done = 0;
+	foreach (BuildThread* thread, threads_) {
+		const BuildThread::GramBuffer& grams = thread->grams();
+		for (BuildThread::GramBuffer::const_iterator i = grams.constBegin();
+			 i != grams.constEnd(); i++)
 		{
-			QString gram = encodedLine.mid(i, d_.gramSize());
-			addGram(gram, key);
+			d_.gramHash_.insert(i.key(), i.value());
 		}
+		done += thread->encodedLines().size();
+		// Free the memory of the shard as early as possible.
+		thread->clear();
+		reportProgress(AbstractBuildProgress::Merging, done, total);
 	}
+	d_.gramHash_.sort();
+}
+
+bool Builder::build(quint64 total)
+{
+	runThreads(BuildThread::EncodePass, AbstractBuildProgress::Encoding, total);
+	foreach (BuildThread* thread, threads_) {
+		if (thread->failed()) {
+			deleteThreads();
+			return false;
+		}
+	}
+
+	quint64 lineCount = 0;
+	foreach (BuildThread* thread, threads_)
+		lineCount += thread->encodedLines().size();
+	insertEntries(lineCount);
+
+	runThreads(BuildThread::GramPass, AbstractBuildProgress::Indexing,
+		lineCount);
+	mergeGrams(lineCount);
+	deleteThreads();
+	return true;
 }
 
 bool Builder::buildFrom(const QString& dictFile)
 {
 	d_.clear();
 	d_.dictFilename_ = dictFile;
-	QFile file(dictFile);
-	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+	quint64 total = assignShards(dictFile);
+	if (threads_.isEmpty())
 		return false;
-	QTextStream in(&file);
-	in.setCodec("UTF-8");
-#ifdef _DEBUG	
-	quint32 lineCounter = 0;
-#endif
-	while(!in.atEnd()) {
-		QString line = in.readLine();
-		processLine(line);
-#ifdef _DEBUG
-		lineCounter += 1;
-		if (lineCounter % 10000 == 0)
-			qDebug("lines processed: %d", lineCounter);
-#endif
-	}
-	d_.gramHash_.reCountAllNodes();
-	return true;
+	return build(total);
 }
 
 bool Builder::buildFrom(const QStringList& stringList)
 {
-	using std::cout;
-	using std::endl;
-	
 	d_.clear();
-	QTime timer;
-	uint inserttime = 0;
-	for(int i = 0; i < stringList.size(); i++) {
-		if (i % 10000 == 0)
-			cout << "\r" << (int)((i * 100) / stringList.size()) << "% inserted.       ";
-		timer.restart();
-		processLine(stringList[i]);
-		inserttime += timer.elapsed();
-	}
-	cout << endl;
-	d_.gramHash_.reCountAllNodes();
-	return true;
+	quint64 total = assignShards(stringList);
+	return build(total);
 }
 
 } // namespace DictionaryImpl
 
 } // namespace Distiller
-
@@ -3,7 +3,9 @@
 
 #pragma once
 
+#include "AbstractBuildProgress.h"
 #include "KeyDistTuple.h"
+#include "BuildThread.h"
 
 namespace Distiller
 {
@@ -13,39 +15,101 @@ namespace DictionaryImpl
 
 /**
  * Build the internal data structures of the dictionary
- * from an UTF-8 encoded text file where every line is 
+ * from an UTF-8 encoded text file where every line is
  * a dictionary entry.
+ *
+ * The input is cut into shards which are encoded and split
+ * into grams by one BuildThread per shard. The results of the
+ * threads are merged in input order, so the keys of the entries
+ * are the same as if the input had been processed line by line.
+ * The Containers hold the key of an entry once per distinct gram,
+ * like after inserting the entries with Private::insert().
+ *
+ * \note The index is not identical to the one of the former line
+ * by line build, which added the key once per occurrence of a gram,
+ * so a gram repeated within an entry ("abcdabcd") put its key into
+ * the Container twice. Queries find the same entries, the duplicate
+ * keys only cost a second distance check.
  */
 class Builder
 {
 
 	Private& d_;
-	
+
+	AbstractBuildProgress* progress_;
+
+	int threadCount_;
+
+	QList<BuildThread*> threads_;
+
+	/// Encoded entries already inserted, used for removing duplicates.
 	QSet<QString> encodedEntries_;
 
-	void addGram(const QString& gram, KeyType key);
+	/// Files smaller than this are processed by a single thread.
+	static const qint64 minShardSize_ = 1024 * 1024;
+
+	void createThreads(int count);
+
+	void deleteThreads();
 
 	/**
-	 * Inserts a line into the dictionary.
+	 * Cuts the file into byte ranges which start and end at line
+	 * breaks and assigns them to the threads.
+	 */
+	quint64 assignShards(const QString& dictFile);
+
+	quint64 assignShards(const QStringList& stringList);
+
+	/**
+	 * Runs pass on all threads and reports the progress
+	 * until all threads are finished.
+	 */
+	void runThreads(BuildThread::Pass pass,
+					AbstractBuildProgress::Stage stage, quint64 total);
+
+	/**
+	 * Appends the encoded lines of all threads in input order to
+	 * the dictionary, drops empty and duplicate entries and
+	 * assigns the keys.
+	 *
 	 * Throws Exception(Exception::TooManyEntries) if the maximum numbers
 	 * of entries is exceeded.
 	 */
-	void processLine(const QString& line);
-	
+	void insertEntries(quint64 total);
+
+	/**
+	 * Inserts the thread-local grams into the GramHash.
+	 */
+	void mergeGrams(quint64 total);
+
+	/**
+	 * Runs both passes. Returns false if a shard couldn't be read.
+	 */
+	bool build(quint64 total);
+
+	void reportProgress(AbstractBuildProgress::Stage stage,
+						quint64 done, quint64 total);
+
 public:
 
-	Builder(Dictionary& dict) : d_(*dict.d_)
-		{ }
-		
+	Builder(Dictionary& dict, AbstractBuildProgress* progress = 0);
+
+	~Builder();
+
+	/**
+	 * Sets the number of threads. Defaults to
+	 * QThread::idealThreadCount().
+	 */
+	void setThreadCount(int count);
+
 	bool buildFrom(const QString& dictFile);
-	
+
 	bool buildFrom(const QStringList& stringList);
-	
+
 };
 
 } // namespace DictionaryImpl
 
 } // namespace Distiller
 
-#endif 
-
+#endif
@@ -0,0 +1,27 @@
+#include <core/precompiled.h>
+
+#include "CancellationToken.h"
+
+namespace Distiller
+{
+
+Dictionary::CancellationToken::CancellationToken() :
+	cancelled_(0)
+{ }
+
+void Dictionary::CancellationToken::cancel()
+{
+	cancelled_ = 1;
+}
+
+bool Dictionary::CancellationToken::isCancelled() const
+{
+	return static_cast<int>(cancelled_) != 0;
+}
+
+void Dictionary::CancellationToken::reset()
+{
+	cancelled_ = 0;
+}
+
+} // namespace Distiller
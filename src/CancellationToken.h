@@ -0,0 +1,42 @@
+#ifndef DISTILLER_DICTIONARYIMPL_CANCELLATIONTOKEN_H
+#define DISTILLER_DICTIONARYIMPL_CANCELLATIONTOKEN_H
+
+#pragma once
+
+#include <QAtomicInt>
+
+#include "Dictionary.h"
+
+namespace Distiller
+{
+
+/**
+ * Cancels queries from another thread.
+ *
+ * Pass the token with QueryOptions::cancellation. A query checks
+ * the token while it verifies candidates and returns the best
+ * match found so far once the token has been cancelled.
+ */
+class Dictionary::CancellationToken
+{
+
+	QAtomicInt cancelled_;
+
+public:
+
+	CancellationToken();
+
+	void cancel();
+
+	bool isCancelled() const;
+
+	/**
+	 * Makes the token usable for the next query.
+	 */
+	void reset();
+
+};
+
+} // namespace Distiller
+
+#endif 
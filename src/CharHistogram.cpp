@@ -0,0 +1,121 @@
+#include <core/precompiled.h>
+
+#ifdef __SSE2__
+#	include <emmintrin.h>
+#endif
+
+#include "CharHistogram.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+/// Class of the characters outside ASCII and the ASCII punctuation.
+static const int firstOtherClass = 29;
+
+static const int otherClasses = 32 - firstOtherClass;
+
+/**
+ * Returns the class of a character:
+ *
+ *     0-25   a-z
+ *     26     whitespace
+ *     27-28  even and odd digits
+ *     29-31  other characters
+ */
+static inline int classOf(ushort uc)
+{
+	if (uc >= 'a' && uc <= 'z')
+		return uc - 'a';
+	if (uc == ' ' || (uc >= '\t' && uc <= '\r'))
+		return 26;
+	if (uc >= '0' && uc <= '9')
+		return 27 + (uc - '0') % 2;
+	return firstOtherClass + uc % otherClasses;
+}
+
+CharHistogram::CharHistogram() :
+	lo_(0),
+	hi_(0)
+{ }
+
+CharHistogram::CharHistogram(const QChar* string, int size) :
+	lo_(0),
+	hi_(0)
+{
+	for (int i = 0; i < size; i++) {
+		int cls = classOf(string[i].unicode());
+		quint64& counts = (cls < 16)? lo_ : hi_;
+		int shift = (cls % 16) * 4;
+		// Saturate at 15.
+		if (((counts >> shift) & 0xF) != 0xF)
+			counts += Q_UINT64_C(1) << shift;
+	}
+}
+
+uint CharHistogram::surplus(const CharHistogram& lhs, const CharHistogram& rhs)
+{
+#ifdef __SSE2__
+	const __m128i nibbles = _mm_set1_epi8(0x0F);
+	__m128i l = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&lhs.lo_));
+	l = _mm_unpacklo_epi64(l,
+		_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&lhs.hi_)));
+	__m128i r = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&rhs.lo_));
+	r = _mm_unpacklo_epi64(r,
+		_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&rhs.hi_)));
+	// Every byte holds two counts: split them into the even and
+	// the odd classes.
+	__m128i lEven = _mm_and_si128(l, nibbles);
+	__m128i lOdd = _mm_and_si128(_mm_srli_epi16(l, 4), nibbles);
+	__m128i rEven = _mm_and_si128(r, nibbles);
+	__m128i rOdd = _mm_and_si128(_mm_srli_epi16(r, 4), nibbles);
+	// max(l - r, 0) for every class, summed up.
+	__m128i zero = _mm_setzero_si128();
+	__m128i sum = _mm_add_epi64(
+		_mm_sad_epu8(_mm_subs_epu8(lEven, rEven), zero),
+		_mm_sad_epu8(_mm_subs_epu8(lOdd, rOdd), zero));
+	return _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+#else
+	uint rv = 0;
+	for (int shift = 0; shift < 64; shift += 4) {
+		int l = (lhs.lo_ >> shift) & 0xF;
+		int r = (rhs.lo_ >> shift) & 0xF;
+		if (l > r)
+			rv += l - r;
+		l = (lhs.hi_ >> shift) & 0xF;
+		r = (rhs.hi_ >> shift) & 0xF;
+		if (l > r)
+			rv += l - r;
+	}
+	return rv;
+#endif
+}
+
+uint CharHistogram::minDistance(const CharHistogram& lhs, const CharHistogram& rhs)
+{
+	return qMax(surplus(lhs, rhs), surplus(rhs, lhs));
+}
+
+uint CharHistogram::minSubstringDistance(const CharHistogram& pattern,
+										 const CharHistogram& text)
+{
+	return surplus(pattern, text);
+}
+
+QDataStream& operator << (QDataStream& out, const CharHistogram& rhs)
+{
+	out << rhs.lo_ << rhs.hi_;
+	return out;
+}
+
+QDataStream& operator >> (QDataStream& in, CharHistogram& rhs)
+{
+	in >> rhs.lo_ >> rhs.hi_;
+	return in;
+}
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
@@ -0,0 +1,84 @@
+#ifndef DISTILLER_DICTIONARYIMPL_CHARHISTOGRAM_H
+#define DISTILLER_DICTIONARYIMPL_CHARHISTOGRAM_H
+
+#pragma once
+
+#include <QVector>
+#include <QDataStream>
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+/**
+ * Counts how often each character occurs in a string.
+ *
+ * BitDistance only records whether a character occurs, so "aaab"
+ * and "ab" get the same bit pattern. CharHistogram counts the
+ * characters in 32 classes (a-z, space, two classes of digits and
+ * three classes shared by all other characters). The counts are
+ * 4 bit wide and saturate at 15, so a histogram fits into 128 bits.
+ *
+ * Every edit step changes the counts of at most two classes, by
+ * one each: a substitution takes one character away and adds
+ * another, insertions and deletions change a single count. So if
+ * text has P characters more than pattern in some classes and N
+ * characters less in others, at least max(P, N) edit steps are
+ * needed. The bound isn't always tighter than the one of
+ * BitDistance: characters sharing a class and counts beyond 15
+ * can't be told apart, so both filters are worth checking.
+ *
+ * The surpluses are computed with SSE2 for all 32 classes at once
+ * if it's available.
+ */
+class CharHistogram
+{
+
+	/// Counts of the classes 0-15 (lo_) and 16-31 (hi_), a nibble each.
+	quint64 lo_;
+
+	quint64 hi_;
+
+	/**
+	 * Sum of the counts by which lhs exceeds rhs.
+	 */
+	static uint surplus(const CharHistogram& lhs, const CharHistogram& rhs);
+
+public:
+
+	CharHistogram();
+
+	CharHistogram(const QChar* string, int size);
+
+	/**
+	 * Lower bound of the edit distance between two strings.
+	 */
+	static uint minDistance(const CharHistogram& lhs, const CharHistogram& rhs);
+
+	/**
+	 * Lower bound of the edit distance of pattern to a substring
+	 * (or prefix) of text: characters of pattern missing in text
+	 * cost an edit step each, surplus characters of text are free.
+	 */
+	static uint minSubstringDistance(const CharHistogram& pattern,
+									 const CharHistogram& text);
+
+	friend QDataStream& operator << (QDataStream& out, const CharHistogram& rhs);
+
+	friend QDataStream& operator >> (QDataStream& in, CharHistogram& rhs);
+
+};
+
+typedef QVector<CharHistogram> HistogramList;
+
+QDataStream& operator << (QDataStream& out, const CharHistogram& rhs);
+
+QDataStream& operator >> (QDataStream& in, CharHistogram& rhs);
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
+
+#endif 
@@ -0,0 +1,25 @@
+#include <core/precompiled.h>
+
+#include "DictionaryDefines.h"
+#include "Private.h"
+#include "CompactionThread.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+CompactionThread::CompactionThread(Private& d) :
+	QThread(),
+	d_(d)
+{ }
+
+void CompactionThread::run()
+{
+	d_.compact();
+}
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
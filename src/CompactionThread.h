@@ -0,0 +1,36 @@
+#ifndef DISTILLER_DICTIONARYIMPL_COMPACTIONTHREAD_H
+#define DISTILLER_DICTIONARYIMPL_COMPACTIONTHREAD_H
+
+#pragma once
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+class Private;
+
+/**
+ * Compacts the dictionary in the background: the dictionary files
+ * are rewritten with all modifications of the delta log and the
+ * log is truncated. Queries are answered while the thread runs,
+ * insertions and deletions wait until it has finished.
+ */
+class CompactionThread : public QThread
+{
+
+	Private& d_;
+
+public:
+
+	CompactionThread(Private& d);
+
+	void run();
+};
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
+
+#endif 
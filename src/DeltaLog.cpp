@@ -0,0 +1,209 @@
+#include <core/precompiled.h>
+
+#ifdef Q_OS_UNIX
+#	include <unistd.h>
+#endif
+
+#include <QtEndian>
+
+#include "DeltaLog.h"
+#include "MemoryUsage.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+const QString DeltaLog::extension_ = ".dlog";
+
+/// Size of the header (magic byte and version).
+static const qint64 headerSize = 2 * sizeof(quint16);
+
+DeltaLog::DeltaLog() :
+	file_(0),
+	stream_(0),
+	size_(0)
+{ }
+
+DeltaLog::~DeltaLog()
+{
+	close();
+}
+
+QString DeltaLog::fileName(const QString& dbname)
+{
+	return dbname + extension_;
+}
+
+void DeltaLog::deleteMembers()
+{
+	if (stream_ != 0) {
+		delete stream_;
+		stream_ = 0;
+	}
+	if (file_ != 0) {
+		file_->close();
+		delete file_;
+		file_ = 0;
+	}
+}
+
+quint16 DeltaLog::checksum(Operation operation, const QString& entry)
+{
+	QByteArray data;
+	data.append(static_cast<char>(operation));
+	data.append(reinterpret_cast<const char*>(entry.unicode()),
+		entry.size() * sizeof(QChar));
+	return qChecksum(data.constData(), data.size());
+}
+
+bool DeltaLog::readRecord(QDataStream& in, Record& record)
+{
+	if (in.atEnd())
+		return false;
+	quint8 operation;
+	in >> operation;
+
+	// QDataStream allocates a QString of the stored length before
+	// reading it, so a damaged length must not get that far. The
+	// length is in bytes, 0xFFFFFFFF marks a null string.
+	QByteArray prefix = in.device()->peek(sizeof(quint32));
+	if (prefix.size() != sizeof(quint32))
+		return false;
+	quint32 length = qFromBigEndian<quint32>(
+		reinterpret_cast<const uchar*>(prefix.constData()));
+	qint64 remaining = in.device()->bytesAvailable() - sizeof(quint32);
+	if (length != 0xFFFFFFFF && (length % 2 != 0 || length > remaining))
+		return false;
+
+	QString entry;
+	quint16 sum;
+	in >> entry >> sum;
+	if (in.status() != QDataStream::Ok)
+		return false;
+	if (operation != Insert && operation != Remove)
+		return false;
+	if (sum != checksum(static_cast<Operation>(operation), entry))
+		return false;
+	record = Record(static_cast<Operation>(operation), entry);
+	return true;
+}
+
+bool DeltaLog::readAll(QIODevice* device, QList<Record>* records,
+					   qint64& validSize)
+{
+	device->seek(0);
+	QDataStream in(device);
+	quint16 magic_byte;
+	quint16 version;
+	in >> magic_byte >> version;
+	if (in.status() != QDataStream::Ok) return false;
+	if (magic_byte != magicByte_) return false;
+	if (version != version_) return false;
+
+	validSize = device->pos();
+	Record record;
+	while (readRecord(in, record)) {
+		validSize = device->pos();
+		if (records)
+			records->append(record);
+	}
+	return true;
+}
+
+bool DeltaLog::read(const QString& dbname, QList<Record>& records)
+{
+	QFile file(fileName(dbname));
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+	qint64 validSize;
+	return readAll(&file, &records, validSize);
+}
+
+bool DeltaLog::remove(const QString& dbname)
+{
+	return QFile::remove(fileName(dbname));
+}
+
+bool DeltaLog::open(const QString& dbname)
+{
+	close();
+	file_ = new QFile(fileName(dbname));
+	if (!file_->open(QIODevice::ReadWrite)) {
+		deleteMembers();
+		return false;
+	}
+	stream_ = new QDataStream(file_);
+
+	QList<Record> records;
+	qint64 validSize = 0;
+	if (file_->size() < headerSize ||
+		readAll(file_, &records, validSize) == false)
+	{
+		// New or unusable log, start from scratch.
+		return truncate();
+	}
+	// Cut off a torn record.
+	if (validSize < file_->size())
+		file_->resize(validSize);
+	file_->seek(validSize);
+	size_ = records.size();
+	return true;
+}
+
+bool DeltaLog::isOpen() const
+{
+	return file_ != 0;
+}
+
+void DeltaLog::close()
+{
+	deleteMembers();
+	size_ = 0;
+}
+
+bool DeltaLog::append(Operation operation, const QString& entry)
+{
+	if (!isOpen())
+		return false;
+	*stream_ << (quint8)operation << entry << checksum(operation, entry);
+	if (!file_->flush())
+		return false;
+#ifdef Q_OS_UNIX
+	if (::fsync(file_->handle()) != 0)
+		return false;
+#endif
+	size_.ref();
+	return stream_->status() == QDataStream::Ok;
+}
+
+bool DeltaLog::truncate()
+{
+	if (!isOpen())
+		return false;
+	if (!file_->resize(0))
+		return false;
+	file_->seek(0);
+	*stream_ << magicByte_ << version_;
+	file_->flush();
+	size_ = 0;
+	return stream_->status() == QDataStream::Ok;
+}
+
+quint32 DeltaLog::size() const
+{
+	return static_cast<int>(size_);
+}
+
+quint64 DeltaLog::memoryUsage() const
+{
+	if (!isOpen())
+		return 0;
+	return sizeof(QFile) + sizeof(QDataStream) +
+		Dictionary::MemoryUsage::fileBuffers;
+}
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
@@ -0,0 +1,153 @@
+#ifndef DISTILLER_DICTIONARYIMPL_DELTALOG_H
+#define DISTILLER_DICTIONARYIMPL_DELTALOG_H
+
+#pragma once
+
+#include <QString>
+#include <QFile>
+#include <QDataStream>
+#include <QAtomicInt>
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+/**
+ * Append-only log of the insertions and deletions made since
+ * the dictionary files have been written the last time.
+ *
+ * Every modification is appended to the log and flushed to disk
+ * before Dictionary::insert() or Dictionary::remove() return.
+ * When the dictionary is loaded, the log is replayed on top of the
+ * index files, so the modifications are searched together with the
+ * base index. Compacting the dictionary writes new index files and
+ * truncates the log.
+ *
+ * Every record carries a checksum. A record which has been torn by
+ * a crash is detected and cut off when the log is opened. Reading
+ * stops at the first damaged record, whose length is never trusted
+ * beyond the end of the file.
+ */
+class DeltaLog
+{
+
+public:
+
+	enum Operation { Insert = 1, Remove = 2 };
+
+	class Record
+	{
+
+	public:
+
+		Operation operation;
+
+		QString entry;
+
+		Record() : operation(Insert), entry()
+			{ }
+
+		Record(Operation op, const QString& str) : operation(op), entry(str)
+			{ }
+	};
+
+	static const quint16 magicByte_ = 0xFEF1;
+
+	static const quint16 version_ = 0x0001;
+
+private:
+
+	// Default filename extension for the log file.
+	static const QString extension_;
+
+	QFile* file_;
+
+	QDataStream* stream_;
+
+	/**
+	 * Number of records in the log. Atomic since size() is read
+	 * by queries while a compaction truncates the log.
+	 */
+	QAtomicInt size_;
+
+	void deleteMembers();
+
+	static quint16 checksum(Operation operation, const QString& entry);
+
+	/**
+	 * Reads the next record. Returns false at the end of the
+	 * log or if the record is damaged, e.g. its entry is longer
+	 * than the rest of the log.
+	 */
+	static bool readRecord(QDataStream& in, Record& record);
+
+	/**
+	 * Reads the header and all valid records from in. Returns
+	 * false if the header doesn't match. validSize is set to the
+	 * position behind the last valid record.
+	 */
+	static bool readAll(QIODevice* in, QList<Record>* records,
+						qint64& validSize);
+
+public:
+
+	DeltaLog();
+
+	~DeltaLog();
+
+	/**
+	 * Returns the name of the log file of a dictionary.
+	 */
+	static QString fileName(const QString& dbname);
+
+	/**
+	 * Reads all records of the log of dbname. Returns false if
+	 * there is no (valid) log.
+	 */
+	static bool read(const QString& dbname, QList<Record>& records);
+
+	/**
+	 * Deletes the log of dbname.
+	 */
+	static bool remove(const QString& dbname);
+
+	/**
+	 * Opens the log of dbname for appending. Creates the log if
+	 * it doesn't exist.
+	 */
+	bool open(const QString& dbname);
+
+	bool isOpen() const;
+
+	void close();
+
+	/**
+	 * Appends a record and flushes it to disk.
+	 */
+	bool append(Operation operation, const QString& entry);
+
+	/**
+	 * Drops all records.
+	 */
+	bool truncate();
+
+	/**
+	 * Number of records in the log.
+	 */
+	quint32 size() const;
+
+	/**
+	 * Estimated bytes used by the open log. The records are on
+	 * disk only.
+	 */
+	quint64 memoryUsage() const;
+
+};
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
+
+#endif
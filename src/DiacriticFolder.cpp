@@ -0,0 +1,109 @@
+#include <core/precompiled.h>
+
+#include <QStringList>
+#include <QCryptographicHash>
+
+#include "DiacriticFolder.h"
+
+namespace Distiller {
+
+DiacriticFolder::DiacriticFolder() :
+	foldings_(),
+	modified_(false),
+	foldsAscii_(false)
+{
+	addDefaultFoldings();
+}
+
+DiacriticFolder::~DiacriticFolder()
+{ }
+
+void DiacriticFolder::addDefaultFoldings()
+{
+	// Letters which have no decomposition.
+	static const struct { ushort ch; const char* replacement; } table[] = {
+		{ 0x00C6, "AE" }, { 0x00E6, "ae" },   // Æ æ
+		{ 0x00D0, "D"  }, { 0x00F0, "d"  },   // Ð ð
+		{ 0x00D8, "O"  }, { 0x00F8, "o"  },   // Ø ø
+		{ 0x00DE, "TH" }, { 0x00FE, "th" },   // Þ þ
+		{ 0x00DF, "ss" },                     // ß
+		{ 0x0110, "D"  }, { 0x0111, "d"  },   // Đ đ
+		{ 0x0126, "H"  }, { 0x0127, "h"  },   // Ħ ħ
+		{ 0x0131, "i"  },                     // ı
+		{ 0x0141, "L"  }, { 0x0142, "l"  },   // Ł ł
+		{ 0x0152, "OE" }, { 0x0153, "oe" },   // Œ œ
+		{ 0x0166, "T"  }, { 0x0167, "t"  },   // Ŧ ŧ
+		{ 0x1E9E, "SS" }                      // ẞ
+	};
+	for (uint i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+		foldings_.insert(QChar(table[i].ch),
+			QString::fromLatin1(table[i].replacement));
+}
+
+void DiacriticFolder::addFolding(QChar ch, const QString& replacement)
+{
+	foldings_.insert(ch, replacement);
+	modified_ = true;
+	if (ch.unicode() < 0x80)
+		foldsAscii_ = true;
+}
+
+void DiacriticFolder::clearFoldings()
+{
+	foldings_.clear();
+	modified_ = true;
+	foldsAscii_ = false;
+}
+
+QString DiacriticFolder::name() const
+{
+	if (modified_ == false)
+		return "diacritics";
+	// The hash is unordered, sort the table for a stable name.
+	QStringList foldings;
+	QHash<QChar, QString>::const_iterator i;
+	for (i = foldings_.constBegin(); i != foldings_.constEnd(); i++)
+		foldings.append(QString(i.key()) + i.value());
+	foldings.sort();
+	QByteArray data = foldings.join(QString(QChar(0))).toUtf8();
+	return "diacritics-" + QString::fromLatin1(
+		QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex());
+}
+
+QString DiacriticFolder::normalize(const QString& text) const
+{
+	const QChar* pc = text.unicode();
+	int size = text.size();
+	int i = 0;
+	while (i < size && pc[i].unicode() < 0x80)
+		i++;
+	if (i == size && foldsAscii_ == false)
+		// Nothing to fold.
+		return text;
+
+	// ASCII text has no decomposition.
+	QString decomposed = (i == size)?
+		text : text.normalized(QString::NormalizationForm_KD);
+	QString rv;
+	rv.reserve(decomposed.size());
+	for (i = 0; i < decomposed.size(); i++) {
+		QChar ch = decomposed[i];
+		if (ch.unicode() < 0x80 && foldsAscii_ == false) {
+			rv += ch;
+			continue;
+		}
+		if (ch.category() == QChar::Mark_NonSpacing ||
+			ch.category() == QChar::Mark_SpacingCombining ||
+			ch.category() == QChar::Mark_Enclosing)
+			// Diacritic of the previous letter.
+			continue;
+		QHash<QChar, QString>::const_iterator folding = foldings_.constFind(ch);
+		if (folding != foldings_.constEnd())
+			rv += folding.value();
+		else
+			rv += ch;
+	}
+	return rv;
+}
+
+} // namespace Distiller
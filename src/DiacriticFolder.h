@@ -0,0 +1,76 @@
+#ifndef DISTILLER_DIACRITICFOLDER_H
+#define DISTILLER_DIACRITICFOLDER_H
+
+#pragma once
+
+#include <QHash>
+#include <QChar>
+#include <QString>
+
+#include "AbstractNormalizer.h"
+
+namespace Distiller {
+
+/**
+ * Folds characters to their base letters, so "Björk" matches
+ * "bjork" and "Beyoncé" matches "beyonce".
+ *
+ * The text is decomposed into normalization form KD, which splits
+ * accented characters into base letter and combining marks and
+ * replaces compatibility characters (ligatures like "ﬁ", full width
+ * forms, superscripts) by their plain counterparts. The combining
+ * marks are dropped.
+ *
+ * Letters without a decomposition, like "ß" or "ø", are folded by
+ * a table. The default table covers the Latin letters of the
+ * European languages, addFolding() extends or overrides it.
+ *
+ * Pure ASCII text is returned unchanged without any copying, unless
+ * the table folds ASCII characters, like addFolding('&', "and").
+ */
+class DiacriticFolder : public AbstractNormalizer
+{
+
+	/// Foldings applied after the decomposition.
+	QHash<QChar, QString> foldings_;
+
+	/// Set if the default table has been modified.
+	bool modified_;
+
+	/// Set if the table folds any ASCII character.
+	bool foldsAscii_;
+
+	void addDefaultFoldings();
+
+public:
+
+	DiacriticFolder();
+
+	virtual ~DiacriticFolder();
+
+	/**
+	 * Folds ch to replacement. The replacement is inserted as it
+	 * is, it's not folded again. Call this before the dictionary
+	 * is built.
+	 */
+	void addFolding(QChar ch, const QString& replacement);
+
+	/**
+	 * Removes all foldings including the default ones.
+	 */
+	void clearFoldings();
+
+	/**
+	 * "diacritics" for the default table. A modified table adds
+	 * the SHA-1 hash of the table, so different tables get
+	 * different names.
+	 */
+	virtual QString name() const;
+
+	virtual QString normalize(const QString& text) const;
+
+};
+
+} // namespace Distiller
+
+#endif
@@ -25,6 +25,7 @@ const char* Exception::toString()
 	switch(type_) {
 		case OutOfIds : return "Out of Ids.";
 		case TooManyEntries : return "Too many entries.";
+		case CorruptIndex : return "Corrupt index file.";
 		default: return "No description available.";
 	}
 }
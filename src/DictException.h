@@ -14,7 +14,7 @@ class Exception
 
 public:
 
-	enum Type { OutOfIds, TooManyEntries };
+	enum Type { OutOfIds, TooManyEntries, CorruptIndex };
 
 private:
 
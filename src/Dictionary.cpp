@@ -2,86 +2,378 @@
 
 #include <iostream>
 
+#include <QThreadPool>
+
 #include "DictionaryDefines.h"
 #include "Profiler.h"
 #include "Private.h"
 #include "Builder.h"
+#include "ExternalBuilder.h"
 #include "DictionaryDB.h"
+#include "ReloadTask.h"
+#include "Match.h"
+#include "QueryOptions.h"
+#include "QueryStats.h"
+#include "SlowQuery.h"
+#include "MemoryUsage.h"
 #include "Dictionary.h"
 
 namespace Distiller {
 
 Dictionary::Dictionary() :
-	d_(new DictionaryImpl::Private)
+	d_(new DictionaryImpl::Private),
+	snapshotLock_(),
+	reloadPool_(0),
+	reloadSucceeded_(true),
+	normalizer_(0)
 { }
 
 Dictionary::~Dictionary()
 {
-	delete d_;
+	if (reloadPool_) {
+		reloadPool_->waitForDone();
+		delete reloadPool_;
+	}
+}
+
+QSharedPointer<DictionaryImpl::Private> Dictionary::snapshot() const
+{
+	QMutexLocker locker(&snapshotLock_);
+	return d_;
+}
+
+void Dictionary::swap(const QSharedPointer<DictionaryImpl::Private>& d)
+{
+	QMutexLocker locker(&snapshotLock_);
+	QSharedPointer<DictionaryImpl::Private> old = d_;
+	d->setCompactionThreshold(old->compactionThreshold());
+	d->resultCache_.setCapacity(old->resultCache_.capacity());
+	d->slowQueryLog_.setCapacity(old->slowQueryLog_.capacity());
+	d->slowQueryLog_.setThresholds(old->slowQueryLog_.latencyThreshold(),
+		old->slowQueryLog_.postingsThreshold());
+	d_ = d;
+	locker.unlock();
+
+	// The old snapshot must not write to the files anymore.
+	old->detach();
+	// old is freed here unless a query still uses it.
+}
+
+QSharedPointer<DictionaryImpl::Private> Dictionary::createPrivate() const
+{
+	QSharedPointer<DictionaryImpl::Private> d(new DictionaryImpl::Private);
+	QMutexLocker locker(&snapshotLock_);
+	d->normalizer_ = normalizer_;
+	return d;
 }
 
 QString Dictionary::find(const QString& needle) const
 {
-	return d_->find(needle);
+	return snapshot()->find(needle);
+}
+
+QString Dictionary::find(const QString& needle,
+						 const QueryOptions& options,
+						 QueryStats* stats) const
+{
+	return snapshot()->find(needle, options, stats);
 }
 
 QString Dictionary::findVerbose(const QString& needle, DebugInfo* debugInfo) const
 {
 #ifdef DICTIONARY_WITH_DEBUGINFO
-	return d_->find(needle, debugInfo);
+	return snapshot()->find(needle, debugInfo);
 #else
-	return d_->find(needle);
+	return snapshot()->find(needle);
 #endif
 }
 
+QList<Dictionary::Match> Dictionary::findTopK(const QString& needle,
+											 int k) const
+{
+	return snapshot()->findTopK(needle, k);
+}
+
+void Dictionary::findWithin(const QString& needle, uint maxDistance,
+							AbstractMatchHandler& handler) const
+{
+	snapshot()->findWithin(needle, maxDistance, handler);
+}
+
+quint32 Dictionary::findKey(const char* utf8, int size) const
+{
+	return findKey(utf8, size, QueryOptions());
+}
+
+quint32 Dictionary::findKey(const char* utf8, int size,
+							const QueryOptions& options,
+							QueryStats* stats) const
+{
+	QSharedPointer<DictionaryImpl::Private> d = snapshot();
+	return d->findKey(d->encode(utf8, size), options, stats);
+}
+
+quint32 Dictionary::findKey(const std::string& utf8) const
+{
+	return findKey(utf8.data(), utf8.size());
+}
+
+int Dictionary::findTopK(const char* utf8, int size, int k,
+						 quint32* keys, uint* distances) const
+{
+	QSharedPointer<DictionaryImpl::Private> d = snapshot();
+	QList<DictionaryImpl::KeyDistTuple> tuples =
+		d->findTopKeys(d->encode(utf8, size), k);
+	for (int i = 0; i < tuples.size(); i++) {
+		keys[i] = tuples[i].key();
+		if (distances)
+			distances[i] = tuples[i].distance();
+	}
+	return tuples.size();
+}
+
+bool Dictionary::entry(quint32 key, std::string& utf8) const
+{
+	return snapshot()->entry(key, utf8);
+}
+
+QList<Dictionary::Match> Dictionary::complete(const QString& prefix, int k,
+											 uint maxTypos) const
+{
+	return snapshot()->complete(prefix, k, maxTypos);
+}
+
+bool Dictionary::setWeight(const QString& entry, quint32 weight)
+{
+	return snapshot()->setWeight(entry, weight);
+}
+
 bool Dictionary::load(const QString& dictionary)
 {
-	d_->dictFilename_ = dictionary;
-	if (d_->load() == false)
-		build(dictionary);
+	// The old snapshot must not compact or append to the delta
+	// log while the fresh one reads it.
+	QSharedPointer<DictionaryImpl::Private> old = snapshot();
+	old->suspend();
+
+	Dictionary fresh;
+	fresh.d_ = createPrivate();
+	fresh.normalizer_ = fresh.d_->normalizer_;
+	fresh.d_->dictFilename_ = dictionary;
+	if (fresh.d_->load() == false &&
+		fresh.build(dictionary) == false)
+	{
+		old->resume();
+		return false;
+	}
+	swap(fresh.d_);
 	return true;
 }
 
-bool Dictionary::build(const QString& dictionary)
+void Dictionary::reloadInBackground(const QString& dictionary)
+{
+	QMutexLocker locker(&snapshotLock_);
+	if (reloadPool_ == 0) {
+		reloadPool_ = new QThreadPool;
+		reloadPool_->setMaxThreadCount(1);
+	}
+	reloadPool_->start(new DictionaryImpl::ReloadTask(*this, dictionary));
+}
+
+bool Dictionary::waitForReload()
+{
+	QMutexLocker locker(&snapshotLock_);
+	QThreadPool* pool = reloadPool_;
+	locker.unlock();
+	if (pool)
+		pool->waitForDone();
+	locker.relock();
+	return reloadSucceeded_;
+}
+
+bool Dictionary::build(const QString& dictionary,
+					   AbstractBuildProgress* progress)
+{
+	// See load().
+	QSharedPointer<DictionaryImpl::Private> old = snapshot();
+	old->suspend();
+
+	Dictionary fresh;
+	fresh.d_ = createPrivate();
+	fresh.normalizer_ = fresh.d_->normalizer_;
+	fresh.d_->dictFilename_ = dictionary;
+	IF_PROFILER(DictionaryImpl::ProfilerTimer timer(&fresh.d_->profiler,
+		DictionaryImpl::Profiler::Build));
+	DictionaryImpl::Builder builder(fresh, progress);
+	if (builder.buildFrom(dictionary) == false) {
+		old->resume();
+		return false;
+	}
+	swap(fresh.d_);
+	return true;
+}
+
+bool Dictionary::buildExternal(const QString& dictionary,
+							   quint64 memoryLimit,
+							   AbstractBuildProgress* progress)
+{
+	// See load().
+	QSharedPointer<DictionaryImpl::Private> old = snapshot();
+	old->suspend();
+
+	Dictionary fresh;
+	fresh.d_ = createPrivate();
+	fresh.normalizer_ = fresh.d_->normalizer_;
+	IF_PROFILER(DictionaryImpl::ProfilerTimer timer(&fresh.d_->profiler,
+		DictionaryImpl::Profiler::Build));
+	DictionaryImpl::ExternalBuilder builder(fresh, memoryLimit, progress);
+	if (builder.buildFrom(dictionary) == false) {
+		old->resume();
+		return false;
+	}
+	swap(fresh.d_);
+	return true;
+}
+
+void Dictionary::setNormalizer(const AbstractNormalizer* normalizer)
+{
+	QMutexLocker locker(&snapshotLock_);
+	normalizer_ = normalizer;
+}
+
+bool Dictionary::insert(const QString& entry)
+{
+	return snapshot()->insert(entry);
+}
+
+bool Dictionary::remove(const QString& entry)
 {
-	d_->dictFilename_ = dictionary;
-	DictionaryImpl::Builder builder(*this);
-	return builder.buildFrom(dictionary);
+	return snapshot()->remove(entry);
 }
 
 bool Dictionary::save()
 {
-	return d_->save();
+	return snapshot()->save();
+}
+
+bool Dictionary::compact()
+{
+	return snapshot()->compact();
+}
+
+bool Dictionary::compactInBackground()
+{
+	return snapshot()->compactInBackground();
+}
+
+void Dictionary::setCompactionThreshold(quint32 records)
+{
+	snapshot()->setCompactionThreshold(records);
+}
+
+quint32 Dictionary::pendingModifications() const
+{
+	return snapshot()->pendingModifications();
+}
+
+void Dictionary::setResultCacheSize(int results)
+{
+	snapshot()->resultCache_.setCapacity(results);
+}
+
+quint64 Dictionary::resultCacheHits() const
+{
+	return snapshot()->resultCache_.hits();
+}
+
+quint64 Dictionary::resultCacheMisses() const
+{
+	return snapshot()->resultCache_.misses();
+}
+
+Dictionary::QueryStats Dictionary::searchStats() const
+{
+	return snapshot()->searchStats();
+}
+
+void Dictionary::resetSearchStats() const
+{
+	snapshot()->resetSearchStats();
+}
+
+Dictionary::MemoryUsage Dictionary::memoryUsage() const
+{
+	return snapshot()->memoryUsage();
+}
+
+void Dictionary::setSlowQueryLog(int size, qint64 usecs, quint64 postings)
+{
+	QSharedPointer<DictionaryImpl::Private> d = snapshot();
+	d->slowQueryLog_.setCapacity(size);
+	d->slowQueryLog_.setThresholds(usecs * 1000, postings);
+}
+
+QList<Dictionary::SlowQuery> Dictionary::slowQueries() const
+{
+	return snapshot()->slowQueryLog_.queries();
+}
+
+void Dictionary::dumpSlowQueries(std::ostream& out) const
+{
+	foreach (const SlowQuery& query, slowQueries())
+		out << query;
+}
+
+void Dictionary::clearSlowQueries()
+{
+	snapshot()->slowQueryLog_.clear();
 }
 
 void Dictionary::clear()
 {
-	d_->clear();
+	swap(createPrivate());
 }
 
 QString Dictionary::encode(const QString& text) const
 {
-	return d_->encode(text);
+	return snapshot()->encode(text);
 }
 
 uint Dictionary::calcMaxTypos(const QString &text) const
 {
-	return d_->calcMaxTypos(text);
+	return snapshot()->calcMaxTypos(text);
 }
 
-const DictionaryImpl::Profiler Dictionary::profiler() const
+DictionaryImpl::ProfilerReport Dictionary::profiler() const
 {
 #ifdef DICTIONARY_WITH_PROFILER
-	return d_->profiler;
+	return snapshot()->profiler.report();
 #else
-	return DictionaryImpl::Profiler();
+	return DictionaryImpl::ProfilerReport();
 #endif
 }
 
 void Dictionary::resetProfiler() const
 {
 #ifdef DICTIONARY_WITH_PROFILER
-	d_->profiler.reset();
+	snapshot()->profiler.reset();
+#endif
+}
+
+void Dictionary::setProfilingEnabled(bool enable)
+{
+#ifdef DICTIONARY_WITH_PROFILER
+	DictionaryImpl::Profiler::setEnabled(enable);
+#else
+	Q_UNUSED(enable);
+#endif
+}
+
+bool Dictionary::isProfilingEnabled()
+{
+#ifdef DICTIONARY_WITH_PROFILER
+	return DictionaryImpl::Profiler::enabled();
+#else
+	return false;
 #endif
 }
 
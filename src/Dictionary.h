@@ -140,11 +140,14 @@
  *
  * This what our data structure looks like in general:
  *
- * GramHash stores a GramNode for each gram and its suffixes.
+ * GramHash stores the grams of length maxGramSize (and shorter
+ * grams which end an entry) sorted, each with a pointer to its
+ * Container. The grams a suffix is part of follow each other in
+ * this table, so the GramNode of a suffix is just a range of it
+ * and the lists of the suffixes above are never stored.
  *
- * GramNode stores a list of pointers to Containers and a counter
- * variable to store the accumulated length of all Containers it
- * points to.
+ * GramNode refers to such a range of pointers to Containers and
+ * sums up the lengths of all Containers it points to.
  *
  * III) Fine grain checks
  *
@@ -161,34 +164,94 @@
 
 #pragma once
 
+#include <iosfwd>
+#include <string>
+
 #include <QString>
+#include <QList>
+#include <QSharedPointer>
+#include <QMutex>
 
 #include "AbstractDictionary.h"
+#include "AbstractBuildProgress.h"
+#include "AbstractMatchHandler.h"
+#include "AbstractNormalizer.h"
+
+class QThreadPool;
 
 namespace Distiller {
 
 namespace DictionaryImpl { 
 	class Profiler;
+	class ProfilerReport;
 	class Private; 
 	class Builder;
+	class ExternalBuilder;
+	class ReloadTask;
 }
 
 class Dictionary : public AbstractDictionary
 {
 	
-	DictionaryImpl::Private* d_;
-	
-	bool loadIndex(const QString& dictionary);
+	/**
+	 * The current snapshot of the dictionary. load(), build() and
+	 * clear() prepare a new snapshot and swap it in. Every call
+	 * works on the snapshot which was current when it started, an
+	 * old snapshot is freed when the last call using it returns.
+	 */
+	QSharedPointer<DictionaryImpl::Private> d_;
+
+	/// Guards d_ and reloadSucceeded_.
+	mutable QMutex snapshotLock_;
+
+	/// Runs the reloads, created on first use.
+	QThreadPool* reloadPool_;
+
+	bool reloadSucceeded_;
+
+	/// See setNormalizer(), may be 0. Guarded by snapshotLock_.
+	const AbstractNormalizer* normalizer_;
+
+	/**
+	 * Creates the Private of a new snapshot.
+	 */
+	QSharedPointer<DictionaryImpl::Private> createPrivate() const;
+
+	/**
+	 * Returns the current snapshot.
+	 */
+	QSharedPointer<DictionaryImpl::Private> snapshot() const;
+
+	/**
+	 * Makes d the current snapshot.
+	 */
+	void swap(const QSharedPointer<DictionaryImpl::Private>& d);
 	
 	/**
 	 * For every charPerError_ characters is 
-	 * one typing error allowed.
+	 * one typing error allowed. Default of
+	 * QueryOptions::charsPerError.
 	 */
 	static const int charsPerError_ = 5;
 	
 public:
 
 	class DebugInfo;
+
+	class Match;
+
+	class QueryOptions;
+
+	class QueryStats;
+
+	class SlowQuery;
+
+	class MemoryUsage;
+
+	class CancellationToken;
+
+	/// Returned by findKey() if nothing is found.
+	static const quint32 invalidKey = 0xFFFFFFFF;
 	
 	Dictionary();
 	
@@ -199,25 +262,288 @@ public:
 	 * Returns QString() if nothing is found.
 	 */
 	virtual QString find(const QString& needle) const;
+
+	/**
+	 * Returns the match to a given imperfect pattern
+	 * using the given options.
+	 *
+	 * If stats is given, it tells whether the query has been
+	 * cut short by the limits of the options.
+	 */
+	QString find(const QString& needle, const QueryOptions& options,
+				 QueryStats* stats = NULL) const;
 	
 	QString findVerbose(const QString& needle,
 						DebugInfo* debugInfo = NULL) const;
+
+	/**
+	 * Returns the k best matches for a given imperfect pattern,
+	 * best first. Matches with the same distance are ordered by
+	 * key. Like find() only entries within calcMaxTypos(needle)
+	 * edit steps are found.
+	 */
+	QList<Match> findTopK(const QString& needle, int k) const;
+
+	/**
+	 * Hands every entry within maxDistance edit steps of the needle
+	 * to handler, in no particular order. The distance is the same
+	 * as for find(), but maxDistance replaces calcMaxTypos(needle).
+	 *
+	 * Small distances are answered through the gram index. If the
+	 * needle is too short to be cut into maxDistance + 1 grams,
+	 * all entries are checked.
+	 *
+	 * The handler runs while the dictionary is locked for reading.
+	 * It may query the dictionary, e.g. with find() or another
+	 * findWithin(); such queries use the lock held already. It must
+	 * not insert(), remove(), setWeight(), save() or compact() this
+	 * dictionary, which would deadlock; debug builds assert this.
+	 * Collect the entries and modify the dictionary afterwards.
+	 */
+	void findWithin(const QString& needle, uint maxDistance,
+					AbstractMatchHandler& handler) const;
+
+	/**
+	 * Same as find() for a UTF-8 encoded needle of size bytes, but
+	 * returns the key of the match or invalidKey. Neither the
+	 * needle nor the result is converted to a QString, use entry()
+	 * to read the entry of a key.
+	 *
+	 * Keys are valid until the dictionary is loaded, rebuilt or
+	 * cleared.
+	 */
+	quint32 findKey(const char* utf8, int size) const;
+
+	quint32 findKey(const char* utf8, int size, const QueryOptions& options,
+					QueryStats* stats = NULL) const;
+
+	quint32 findKey(const std::string& utf8) const;
+
+	/**
+	 * Same as findTopK() for a UTF-8 encoded needle. Writes the
+	 * keys of the matches to keys and, if given, their distances
+	 * to distances. Both must have room for k values. Returns the
+	 * number of matches.
+	 */
+	int findTopK(const char* utf8, int size, int k,
+				 quint32* keys, uint* distances = NULL) const;
+
+	/**
+	 * Writes the UTF-8 encoded entry of key to utf8, reusing its
+	 * buffer. Returns false if there is no such key.
+	 */
+	bool entry(quint32 key, std::string& utf8) const;
+
+	/**
+	 * Type-ahead completion. Returns the k best entries whose
+	 * encoded form starts with the encoded prefix, allowing
+	 * maxTypos errors in the prefix. Matches are ranked by
+	 * distance, then by weight (see setWeight()), then by key.
+	 *
+	 * Exact completions (maxTypos = 0) are answered from an index
+	 * of the sorted entries, which is built on the first call and
+	 * kept up to date by insert() and remove(). Fuzzy completions
+	 * use the gram index like findWithin(). Prefixes which are too
+	 * short to be cut into maxTypos + 1 grams walk the sorted
+	 * entries like a trie instead. Entries sharing their first
+	 * characters share the distance computation, and branches
+	 * beyond the error budget are skipped, so the work grows with
+	 * the number of matching heads and matches rather than with
+	 * the size of the dictionary.
+	 */
+	QList<Match> complete(const QString& prefix, int k,
+						  uint maxTypos = 0) const;
+
+	/**
+	 * Sets the weight of an entry for complete(), heavier entries
+	 * are ranked first. Weights are kept in memory only and are
+	 * dropped by load(), build() and clear().
+	 *
+	 * Returns false if the entry is not in the dictionary.
+	 */
+	bool setWeight(const QString& entry, quint32 weight);
 	
 	/**
 	 * Load dictionary from index files or -- if they don't exist --
 	 * rebuild dictionary.
+	 *
+	 * Queries are answered from the previous dictionary until the
+	 * new one is complete, then it is swapped in atomically.
+	 * Returns false (and keeps the previous dictionary) if neither
+	 * the index files nor the textfile could be read.
+	 *
+	 * \note Modifications made during the load apply to the
+	 * previous dictionary and are lost. They are not written to
+	 * the delta log, which is read by the new dictionary.
 	 */
 	virtual bool load(const QString& dictionary);
+
+	/**
+	 * Runs load() on a background thread and returns immediately.
+	 * Reloads are executed one after the other.
+	 */
+	void reloadInBackground(const QString& dictionary);
+
+	/**
+	 * Waits until all background reloads have finished. Returns
+	 * the result of the last one.
+	 */
+	bool waitForReload();
 	
 	/**
 	 * Rebuild dictionary from a textfile.
+	 *
+	 * The build uses all cores. If progress is given it is
+	 * informed about the progress of the build. Like load() the
+	 * new dictionary is swapped in when it's complete.
+	 */
+	virtual bool build(const QString& dictionary,
+					   AbstractBuildProgress* progress = NULL);
+
+	/**
+	 * Rebuild dictionary from a textfile without holding the
+	 * whole index in memory.
+	 *
+	 * The (gram, key) relations are sorted on disk, memoryLimit
+	 * bounds the bytes used for buffering them. It doesn't bound
+	 * the entries, which are held in memory as after load(), nor
+	 * a hash per entry for dropping duplicates and an id and size
+	 * per distinct gram. The index files are written directly, so
+	 * there is no need to call save() afterwards.
+	 */
+	bool buildExternal(const QString& dictionary, quint64 memoryLimit,
+					   AbstractBuildProgress* progress = NULL);
+
+	/**
+	 * Sets the normalizer which is applied to the entries and the
+	 * needles before they are encoded, e.g. a DiacriticFolder.
+	 * 0 (the default) disables normalization. The normalizer is
+	 * not owned and must outlive the dictionary.
+	 *
+	 * It takes effect with the next load(), build() or clear(). The
+	 * index files store the name of the normalizer, files written
+	 * with a different one are rebuilt from the textfile by load().
 	 */
-	virtual bool build(const QString& dictionary);
+	void setNormalizer(const AbstractNormalizer* normalizer);
+
+	/**
+	 * Inserts an entry into the loaded dictionary. The index is
+	 * updated incrementally, readers see the entry as soon as
+	 * insert() returns.
+	 *
+	 * Returns false if the entry is already in the dictionary or
+	 * too short to be indexed.
+	 */
+	bool insert(const QString& entry);
+	
+	/**
+	 * Removes an entry from the loaded dictionary.
+	 * Returns false if the entry is not in the dictionary.
+	 */
+	bool remove(const QString& entry);
 
 	/**
 	 * Saves the dictionary to a binary file.
+	 *
+	 * The files are replaced atomically, a crash while saving
+	 * leaves the previous files intact.
 	 */
 	virtual bool save();
+
+	/**
+	 * Once the dictionary has been loaded or saved, every insert()
+	 * and remove() is appended to a delta log (<dictionary>.dlog)
+	 * before it returns. load() replays the log on top of the index
+	 * files.
+	 *
+	 * compact() rewrites the index files with all modifications and
+	 * truncates the log. Queries are answered during the compaction,
+	 * modifications wait until it has finished.
+	 */
+	bool compact();
+
+	/**
+	 * Runs compact() in a background thread. Returns false if a
+	 * compaction is already running.
+	 */
+	bool compactInBackground();
+
+	/**
+	 * Starts a background compaction whenever the delta log holds
+	 * the given number of records. 0 (the default) disables
+	 * automatic compaction.
+	 */
+	void setCompactionThreshold(quint32 records);
+
+	/**
+	 * Number of modifications in the delta log.
+	 */
+	quint32 pendingModifications() const;
+
+	/**
+	 * Caches the results of up to the given number of find()
+	 * queries. Queries are cached by their encoded form, so needles
+	 * which differ only in case or punctuation share a result.
+	 * Every modification of the dictionary clears the cache, a
+	 * loaded or rebuilt dictionary starts with an empty cache.
+	 * 0 (the default) disables the cache.
+	 */
+	void setResultCacheSize(int results);
+
+	/**
+	 * Number of queries answered from the cache and number of
+	 * queries looked up in vain since the dictionary has been
+	 * loaded.
+	 */
+	quint64 resultCacheHits() const;
+
+	quint64 resultCacheMisses() const;
+
+	/**
+	 * Sum of the QueryStats of all queries since the dictionary
+	 * has been loaded or resetSearchStats() has been called, e.g.
+	 * postings / queries is the mean number of keys scanned per
+	 * query. Queries answered from the result cache aren't
+	 * counted. The per-stage counters are only filled while
+	 * profiling is switched on, see QueryStats.
+	 */
+	QueryStats searchStats() const;
+
+	void resetSearchStats() const;
+
+	/**
+	 * Returns the bytes used by the loaded dictionary: the entries,
+	 * the gram index and the Containers, and how many Containers
+	 * are loaded. Containers still on disk use no memory for their
+	 * keys until they are searched.
+	 */
+	MemoryUsage memoryUsage() const;
+
+	/**
+	 * Enables the slow query log: the last size queries which took
+	 * at least usecs microseconds or scanned at least postings keys
+	 * (see QueryStats) are kept with their QueryStats and DebugInfo.
+	 * 0 disables a threshold, size 0 (the default) disables the log.
+	 *
+	 * Only find() and findKey() are logged. While the log is enabled
+	 * every query records the best match of each gram, and the
+	 * DebugInfo is built from them if the query turns out to be
+	 * slow. Like the result cache the log starts empty when the
+	 * dictionary is loaded or rebuilt.
+	 */
+	void setSlowQueryLog(int size, qint64 usecs, quint64 postings = 0);
+
+	/**
+	 * Returns the logged queries, oldest first.
+	 */
+	QList<SlowQuery> slowQueries() const;
+
+	/**
+	 * Writes the logged queries to out.
+	 */
+	void dumpSlowQueries(std::ostream& out) const;
+
+	void clearSlowQueries();
 	
 	void clear();
 	
@@ -229,15 +555,31 @@ public:
 	uint calcMaxTypos(const QString& text) const;
 	
 	/**
-	 * For profiling purposes.
+	 * For profiling purposes. Returns the latency histograms of
+	 * the queries and of the load and build phases, e.g.
+	 * profiler()[DictionaryImpl::Profiler::Query].p99().
 	 */
-	const DictionaryImpl::Profiler profiler() const;
+	DictionaryImpl::ProfilerReport profiler() const;
 	
 	void resetProfiler() const;
+
+	/**
+	 * Switches profiling on or off for all dictionaries of the
+	 * process. It's off by default, unless the environment variable
+	 * DICTIONARY_PROFILER is set to 1. While it's off the profiler
+	 * costs a branch per timed section.
+	 */
+	static void setProfilingEnabled(bool enable);
+
+	static bool isProfilingEnabled();
 	
 	friend class DictionaryImpl::Builder;
+
+	friend class DictionaryImpl::ExternalBuilder;
 	
 	friend class DictionaryImpl::Private;
+
+	friend class DictionaryImpl::ReloadTask;
 	
 };
 
@@ -7,7 +7,13 @@
 #include <QFile>
 #include <QIODevice>
 #include <QDataStream>
-#include <QHash>
+#include <QVector>
+
+#include <cstdio>
+
+#ifdef Q_OS_UNIX
+#	include <unistd.h>
+#endif
 
 #include "DictionaryDefines.h"
 #include "AbstractDB.h"
@@ -15,6 +21,8 @@
 #include "KeyList.h"
 #include "Profiler.h"
 #include "Private.h"
+#include "AbstractNormalizer.h"
+#include "MemoryUsage.h"
 
 namespace Distiller
 {
@@ -37,9 +45,13 @@ class DictionaryDB :
 	mutable QDataStream* dbstream_;
 	
 	mutable QFile* containerFile_;
-	
-	QHash<typename GramNode<ThreadPolicy>::Container::IdType, 
-		quint64> containerPos_;
+
+	/**
+	 * Positions of the Containers in the container file, indexed
+	 * by their slot: the Containers are numbered in the order
+	 * they are written, see GramHash::containers().
+	 */
+	QVector<quint64> containerPos_;
 	
 	QString dbname_;
 	
@@ -47,8 +59,6 @@ class DictionaryDB :
 	
 	void deleteMembers() const;
 	
-	quint64 saveGramNode(quint64 pos, const GramNode<ThreadPolicy>& node);
-	
 	bool saveContainers(const Private& d);
 	
 	// Default filename extension for db file.
@@ -56,12 +66,42 @@ class DictionaryDB :
 	
 	// Default filename extension for keylist file.
 	static const QString containerExtension_;
+
+	/**
+	 * Replaces the file to by the file from.
+	 */
+	static bool replaceFile(const QString& from, const QString& to);
+
+	/**
+	 * Cleans up after a save() which has been interrupted by a crash.
+	 * If the index file hasn't been moved yet, the save is completed.
+	 * Otherwise the half-written files are removed.
+	 */
+	static void recover(const QString& dbname);
 	
 public:
 
 	static const quint16 magicByte_ = 0xFEEF;
 
-	static const quint16 version_ = 0x0001;
+	/**
+	 * Version 2 stores the name of the normalizer and bit patterns
+	 * covering characters outside ASCII, version 3 the character
+	 * histograms. Version 4 replaced the hash of container positions
+	 * by a table indexed by the container id, version 5 indexes it
+	 * by the slot of the Container, the order it is written in.
+	 * Version 6 stores the keys of the removed entries.
+	 */
+	static const quint16 version_ = 0x0006;
+
+	// Suffix of the files a new version of the dictionary is written to.
+	static const QString newSuffix_;
+
+	/**
+	 * Moves the files written to dbname + newSuffix_ into place. The
+	 * container file is moved first, moving the index file completes
+	 * the save.
+	 */
+	static bool commit(const QString& dbname);
 
 	DictionaryDB();
 	
@@ -78,10 +118,61 @@ public:
 		container);
 	
 	virtual bool load(Private& d);
+
+	/**
+	 * The positions of the Containers and the buffers of the
+	 * open files.
+	 */
+	virtual quint64 memoryUsage() const;
 	
+	/**
+	 * Saves the dictionary. The files are written under a new name
+	 * and then renamed, so the old files stay intact until the new
+	 * ones are complete.
+	 *
+	 * \note Don't save with the DictionaryDB the Containers are
+	 * loaded from, use a separate instance.
+	 */
 	virtual bool save(const Private& d);
+
+	/**
+	 * Writes the dictionary like save() but leaves the files
+	 * under the new name. replace() moves them into place.
+	 */
+	bool saveNew(const Private& d);
+
+	/**
+	 * Moves the files written by saveNew() of written into place,
+	 * while this DB loads the Containers of d.
+	 *
+	 * Unix keeps reading the replaced container file as long as
+	 * it's open. Other systems don't replace an open file, so the
+	 * file is closed first and the Containers still on disk are
+	 * loaded from the new files afterwards.
+	 */
+	bool replace(const DictionaryDB& written, const Private& d);
+
+	/**
+	 * Saving the dictionary piece by piece.
+	 *
+	 * beginSave() opens the files, appendContainer() writes a
+	 * Container to the container file and endSave() writes the
+	 * index and closes the files. Used by the ExternalBuilder,
+	 * which never holds all Containers in memory at once.
+	 */
+	bool beginSave(const QString& dbname);
+
+	void appendContainer(const typename GramNode<ThreadPolicy>::Container&
+		container);
+
+	bool endSave(const Private& d);
 	
 	void close() const;
+
+	/**
+	 * Closes the index file but keeps the container file open.
+	 */
+	void closeIndex() const;
 	
 };
 
@@ -91,6 +182,9 @@ const QString DictionaryDB<ThreadPolicy>::dbExtension_ = ".idb";
 template<typename ThreadPolicy>
 const QString DictionaryDB<ThreadPolicy>::containerExtension_ = ".kdb";
 
+template<typename ThreadPolicy>
+const QString DictionaryDB<ThreadPolicy>::newSuffix_ = ".new";
+
 template<typename ThreadPolicy>
 DictionaryDB<ThreadPolicy>::DictionaryDB() : 
 	AbstractDB<typename GramNode<ThreadPolicy>::Container>(),
@@ -112,15 +206,7 @@ DictionaryDB<ThreadPolicy>::~DictionaryDB()
 template<typename ThreadPolicy>
 void DictionaryDB<ThreadPolicy>::deleteMembers() const
 {
-	if (dbstream_ != 0) {
-		delete dbstream_;
-		dbstream_ = 0;
-	}
-	if (dbfile_ != 0) {
-		dbfile_->close();
-		delete dbfile_;
-		dbfile_ = 0;
-	}
+	closeIndex();
 	if (containerFile_ != 0) {
 		containerFile_->close();
 		delete containerFile_;
@@ -176,9 +262,24 @@ void DictionaryDB<ThreadPolicy>::close() const
 	deleteMembers();
 }
 
+template<typename ThreadPolicy>
+void DictionaryDB<ThreadPolicy>::closeIndex() const
+{
+	if (dbstream_ != 0) {
+		delete dbstream_;
+		dbstream_ = 0;
+	}
+	if (dbfile_ != 0) {
+		dbfile_->close();
+		delete dbfile_;
+		dbfile_ = 0;
+	}
+}
+
 template<typename ThreadPolicy>
 bool DictionaryDB<ThreadPolicy>::load(Private& d)
 {
+	recover(d.dictFilename_);
 	if (!open(d.dictFilename_, QIODevice::ReadOnly))
 		return false;
 
@@ -197,98 +298,210 @@ bool DictionaryDB<ThreadPolicy>::load(Private& d)
 	if (magic_byte != magicByte_) return false;
 	if (version != version_) return false;
 
+	// The entries must have been encoded like the queries.
+	QString normalizer;
+	*dbstream_ >> normalizer;
+	if (normalizer != (d.normalizer_? d.normalizer_->name() : QString()))
+		return false;
+
 	// Load members.
 	*dbstream_ >> d.gramSize_;
-	IF_PROFILER(d.profiler.timer.start());
-	*dbstream_ >> d.encodedEntries_;
-	*dbstream_ >> d.entries_;
-	IF_PROFILER(d.profiler.loadstringarray_time = 
-		d.profiler.timer.elapsed());
+	{
+		IF_PROFILER(ProfilerTimer timer(&d.profiler, Profiler::LoadStringArray));
+		*dbstream_ >> d.encodedEntries_;
+		*dbstream_ >> d.entries_;
+	}
 	*dbstream_ >> d.bitencodedEntries_;
+	*dbstream_ >> d.histograms_;
+	*dbstream_ >> d.removed_;
 	d.gramHash_.loadShallow(*dbstream_, this);
-	IF_PROFILER(d.profiler.timer.start());
-	*dbstream_ >> containerPos_;
-	IF_PROFILER(d.profiler.loadkeylistpos_time = 
-		d.profiler.timer.elapsed());
+	{
+		IF_PROFILER(ProfilerTimer timer(&d.profiler, Profiler::LoadKeyListPos));
+		*dbstream_ >> containerPos_;
+		if (dbstream_->status() != QDataStream::Ok ||
+			containerPos_.size() != d.gramHash_.size())
+		{
+			return false;
+		}
+		QList<typename GramNode<ThreadPolicy>::PtrToContainer> containers =
+			d.gramHash_.containers();
+		foreach (const typename GramNode<ThreadPolicy>::PtrToContainer& p,
+				 containers)
+		{
+			if (p->slot() >= (quint32)containerPos_.size())
+				return false;
+		}
+	}
 	
-	close();
+	// Keep the container file open: the Containers are loaded
+	// from this file even if it is replaced by a newer version.
+	closeIndex();
 	return true;
 }
 
 template<typename ThreadPolicy>
-quint64 DictionaryDB<ThreadPolicy>::saveGramNode(quint64 pos,
-	const GramNode<ThreadPolicy>& node)
+bool DictionaryDB<ThreadPolicy>::saveContainers(const Private& d)
 {
-	typename GramNode<ThreadPolicy>::const_iterator j;
-	for (j = node.constBegin();
-		 j != node.end(); j++)
+	QList<typename GramNode<ThreadPolicy>::PtrToContainer> containers =
+		d.gramHash_.containers();
+	foreach (const typename GramNode<ThreadPolicy>::PtrToContainer& p,
+			 containers)
 	{
-		 const typename GramNode<ThreadPolicy>::Container& container = **j;
-		 const typename GramNode<ThreadPolicy>::Container::IdType id =
-			container.id();
-		 QByteArray ar;
-		 QDataStream stream(&ar, QIODevice::WriteOnly);
-		 
-		 containerPos_[id] = pos;           // Save Position
-		 container.saveDeep(stream);
-		 pos += containerFile_->write(ar);  // Write into File
+		appendContainer(*p);
 	}
-	return pos;
+	return true;
 }
 
 template<typename ThreadPolicy>
-bool DictionaryDB<ThreadPolicy>::saveContainers(const Private& d)
+bool DictionaryDB<ThreadPolicy>::beginSave(const QString& dbname)
 {
+	if (!open(dbname, QIODevice::WriteOnly))
+		return false;
+
 	Q_ASSERT(containerFile_ != 0);
 	Q_ASSERT(containerFile_->isOpen());
 	Q_ASSERT(containerFile_->isWritable());
 	
 	containerFile_->seek(0);
 	containerPos_.clear();
-	
-	const QHash<QString, GramNode<ThreadPolicy> >& distinctiveContainers = 
-		d.gramHash_.distinctiveContainers_;
-		
-	quint64 pos = 0;
-    typename QHash<QString, GramNode<ThreadPolicy> >::const_iterator i;
-	for (i = distinctiveContainers.constBegin();
-		 i != distinctiveContainers.end();
-	 	 i++)
-	{
-		pos = saveGramNode(pos, *i);
-	}
 	return true;
 }
 
 template<typename ThreadPolicy>
-bool DictionaryDB<ThreadPolicy>::save(const Private& d)
+void DictionaryDB<ThreadPolicy>::appendContainer(const typename
+	GramNode<ThreadPolicy>::Container& container)
 {
-	if (!open(d.dictFilename_, QIODevice::WriteOnly))
-		return false;
+	Q_ASSERT(containerFile_ != 0);
+	Q_ASSERT(containerFile_->isWritable());
+
+	QByteArray ar;
+	QDataStream stream(&ar, QIODevice::WriteOnly);
 
+	containerPos_.append(containerFile_->pos());  // Save Position
+	container.saveDeep(stream);
+	containerFile_->write(ar);                              // Write into File
+}
+
+template<typename ThreadPolicy>
+bool DictionaryDB<ThreadPolicy>::endSave(const Private& d)
+{
 	Q_ASSERT(dbfile_ != 0);
 	Q_ASSERT(dbstream_ != 0);
 	Q_ASSERT(dbfile_->isOpen());
 	Q_ASSERT(dbfile_->isWritable());
-	
-	// Save containers
-	saveContainers(d);
+
+	// The slots written by saveShallow() are the positions in the
+	// table, so every Container must have been appended.
+	if (containerPos_.size() != d.gramHash_.size()) {
+		close();
+		return false;
+	}
 	
 	// Write file format and version.
 	dbfile_->seek(0);
 	*dbstream_ << magicByte_;
 	*dbstream_ << version_;
+	*dbstream_ << (d.normalizer_? d.normalizer_->name() : QString());
 	
 	// Write data to stream.
 	*dbstream_ << d.gramSize_;
 	*dbstream_ << d.encodedEntries_;
 	*dbstream_ << d.entries_;
 	*dbstream_ << d.bitencodedEntries_;
+	*dbstream_ << d.histograms_;
+	*dbstream_ << d.removed_;
 	d.gramHash_.saveShallow(*dbstream_);
 	*dbstream_ << containerPos_;
+
+	// The files must be on disk before they are renamed.
+	bool rv = dbfile_->flush() && containerFile_->flush();
+#ifdef Q_OS_UNIX
+	rv = rv && ::fsync(dbfile_->handle()) == 0 &&
+		::fsync(containerFile_->handle()) == 0;
+#endif
+	rv = rv && dbstream_->status() == QDataStream::Ok;
 	
 	close();
-	return true;
+	return rv;
+}
+
+template<typename ThreadPolicy>
+bool DictionaryDB<ThreadPolicy>::save(const Private& d)
+{
+	if (!saveNew(d))
+		return false;
+	return commit(d.dictFilename_);
+}
+
+template<typename ThreadPolicy>
+bool DictionaryDB<ThreadPolicy>::saveNew(const Private& d)
+{
+	if (!beginSave(d.dictFilename_ + newSuffix_))
+		return false;
+	saveContainers(d);
+	return endSave(d);
+}
+
+template<typename ThreadPolicy>
+bool DictionaryDB<ThreadPolicy>::replace(const DictionaryDB& written,
+										 const Private& d)
+{
+#ifdef Q_OS_UNIX
+	Q_UNUSED(written);
+	return commit(d.dictFilename_);
+#else
+	// load() reopens the files with the new positions.
+	ThreadPolicy::lockForWrite();
+	close();
+	bool rv = commit(d.dictFilename_);
+	if (rv) {
+		containerPos_ = written.containerPos_;
+		QList<typename GramNode<ThreadPolicy>::PtrToContainer> containers =
+			d.gramHash_.containers();
+		for (int i = 0; i < containers.size(); i++)
+			containers[i]->setSlot(i);
+	}
+	ThreadPolicy::unlock();
+	return rv;
+#endif
+}
+
+template<typename ThreadPolicy>
+bool DictionaryDB<ThreadPolicy>::replaceFile(const QString& from,
+											 const QString& to)
+{
+#ifdef Q_OS_UNIX
+	// rename() replaces the target atomically.
+	return ::rename(QFile::encodeName(from).constData(),
+					QFile::encodeName(to).constData()) == 0;
+#else
+	QFile::remove(to);
+	return QFile::rename(from, to);
+#endif
+}
+
+template<typename ThreadPolicy>
+bool DictionaryDB<ThreadPolicy>::commit(const QString& dbname)
+{
+	if (!replaceFile(dbname + containerExtension_ + newSuffix_,
+					 dbname + containerExtension_))
+		return false;
+	return replaceFile(dbname + dbExtension_ + newSuffix_,
+					   dbname + dbExtension_);
+}
+
+template<typename ThreadPolicy>
+void DictionaryDB<ThreadPolicy>::recover(const QString& dbname)
+{
+	QString newDb = dbname + dbExtension_ + newSuffix_;
+	QString newContainer = dbname + containerExtension_ + newSuffix_;
+	if (QFile::exists(newDb) && !QFile::exists(newContainer)) {
+		// Crashed between the renames of commit().
+		replaceFile(newDb, dbname + dbExtension_);
+		return;
+	}
+	QFile::remove(newDb);
+	QFile::remove(newContainer);
 }
 
 template<typename ThreadPolicy>
@@ -296,21 +509,40 @@ void DictionaryDB<ThreadPolicy>::load(const typename
 	GramNode<ThreadPolicy>::Container* container)
 {
     ThreadPolicy::lockForWrite();
-	reopen(QIODevice::ReadOnly);
+	if (containerFile_ == 0)
+		reopen(QIODevice::ReadOnly);
 	
 	Q_ASSERT(containerFile_ != 0);
 	Q_ASSERT(containerFile_->isOpen());
 	Q_ASSERT(containerFile_->isReadable());
 
 	QDataStream containerStream(containerFile_);
-	containerFile_->seek(containerPos_[container->id()]);
+	if (container->slot() >= (quint32)containerPos_.size()) {
+		ThreadPolicy::unlock();
+		throw Exception(Exception::CorruptIndex);
+	}
+	containerFile_->seek(containerPos_[container->slot()]);
 	// All members of container are mutable so this is valid!
 	container->loadDeep(containerStream);
 	
-	close();
     ThreadPolicy::unlock();
 }
 
+template<typename ThreadPolicy>
+quint64 DictionaryDB<ThreadPolicy>::memoryUsage() const
+{
+	ThreadPolicy::lockForRead();
+	quint64 rv = (containerPos_.capacity() > 0)?
+		sizeof(QVectorData) + containerPos_.capacity() * sizeof(quint64) : 0;
+	if (dbfile_ != 0)
+		rv += sizeof(QFile) + sizeof(QDataStream) +
+			Dictionary::MemoryUsage::fileBuffers;
+	if (containerFile_ != 0)
+		rv += sizeof(QFile) + Dictionary::MemoryUsage::fileBuffers;
+	ThreadPolicy::unlock();
+	return rv;
+}
+
 } // namespace DictionaryImpl
 
 } // namespace Distiller
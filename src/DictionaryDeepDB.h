@@ -12,6 +12,7 @@
 #include "GramNode.h"
 #include "AbstractDB.h"
 #include "Private.h"
+#include "AbstractNormalizer.h"
 
 namespace Distiller
 {
@@ -40,9 +41,9 @@ class DictionaryDeepDB :
 	
 	void close();
 	
-	void saveFileFormat();
+	void saveFileFormat(const Private& d);
 	
-	bool checkFileFormat();
+	bool checkFileFormat(const Private& d);
 	
 	void saveMembers(const Private& d);
 	
@@ -52,7 +53,8 @@ public:
 
 	static const quint16 magicByte_ = 0xFFE2;
 
-	static const quint16 version_ = 0x0001;
+	/// Version 4 stores the keys of the removed entries.
+	static const quint16 version_ = 0x0004;
 
 	DictionaryDeepDB();
 	
@@ -118,7 +120,7 @@ void DictionaryDeepDB<ThreadPolicy>::close()
 }
 
 template <typename ThreadPolicy>
-void DictionaryDeepDB<ThreadPolicy>::saveFileFormat()
+void DictionaryDeepDB<ThreadPolicy>::saveFileFormat(const Private& d)
 {
 	Q_ASSERT(stream_ != 0);
 	Q_ASSERT(file_ != 0);
@@ -126,10 +128,11 @@ void DictionaryDeepDB<ThreadPolicy>::saveFileFormat()
 	// Write file format and version.
 	*stream_ << magicByte_;
 	*stream_ << version_;
+	*stream_ << (d.normalizer_? d.normalizer_->name() : QString());
 }
 	
 template <typename ThreadPolicy>
-bool DictionaryDeepDB<ThreadPolicy>::checkFileFormat()
+bool DictionaryDeepDB<ThreadPolicy>::checkFileFormat(const Private& d)
 {
 	Q_ASSERT(stream_ != 0);
 	Q_ASSERT(file_ != 0);
@@ -141,6 +144,12 @@ bool DictionaryDeepDB<ThreadPolicy>::checkFileFormat()
 	*stream_ >> magic_byte >> version;
 	if (magic_byte != magicByte_) return false;
 	if (version != version_) return false;
+
+	// The entries must have been encoded like the queries.
+	QString normalizer;
+	*stream_ >> normalizer;
+	if (normalizer != (d.normalizer_? d.normalizer_->name() : QString()))
+		return false;
 	return true;
 }
 
@@ -155,6 +164,8 @@ void DictionaryDeepDB<ThreadPolicy>::saveMembers(const Private& d)
 	*stream_ << d.encodedEntries_;
 	*stream_ << d.entries_;
 	*stream_ << d.bitencodedEntries_;
+	*stream_ << d.histograms_;
+	*stream_ << d.removed_;
 	*stream_ << d.gramHash_;
 }
 
@@ -166,12 +177,14 @@ void DictionaryDeepDB<ThreadPolicy>::loadMembers(Private &d)
 
 	// Load members.
 	*stream_ >> d.gramSize_;
-	IF_PROFILER(d.profiler.timer.start());
-	*stream_ >> d.encodedEntries_;
-	*stream_ >> d.entries_;
-	*stream_ >> d.bitencodedEntries_;
-	IF_PROFILER(d.profiler.loadstringarray_time =
-		d.profiler.timer.elapsed());
+	{
+		IF_PROFILER(ProfilerTimer timer(&d.profiler, Profiler::LoadStringArray));
+		*stream_ >> d.encodedEntries_;
+		*stream_ >> d.entries_;
+		*stream_ >> d.bitencodedEntries_;
+		*stream_ >> d.histograms_;
+	}
+	*stream_ >> d.removed_;
 	*stream_ >> d.gramHash_;
 }
 
@@ -180,7 +193,7 @@ bool DictionaryDeepDB<ThreadPolicy>::load(Private& d)
 {
 	if (open(d.dictFilename_, QIODevice::ReadOnly) == false)
 		return false;
-	if (checkFileFormat() == false)
+	if (checkFileFormat(d) == false)
 		return false;
 	loadMembers(d);
 	close();
@@ -192,7 +205,7 @@ bool DictionaryDeepDB<ThreadPolicy>::save(const Private& d)
 {
 	if (open(QIODevice::WriteOnly) == false)
 		return false;
-	saveFileFormat();
+	saveFileFormat(d);
 	saveMembers(d);
 	close();
 	return true;
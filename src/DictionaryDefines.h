@@ -2,9 +2,21 @@
 #ifndef DISTILLER_DICTIONARYIMPL_DICTIONARAYDEFINES_H
 #define DISTILLER_DICTIONARYIMPL_DICTIONARAYDEFINES_H
 
-#define DICTIONARY_WITH_PROFILER
+/**
+ * The profiler and the DebugInfo are compiled in by default. Both
+ * cost nothing but a branch unless they are used: the profiler
+ * records only while Profiler::enabled(), DebugInfo is collected
+ * only if one is passed to the query. Define DICTIONARY_NO_PROFILER
+ * or DICTIONARY_NO_DEBUGINFO to compile them out.
+ */
 
-#define DICTIONARY_WITH_DEBUGINFO
+#ifndef DICTIONARY_NO_PROFILER
+#	define DICTIONARY_WITH_PROFILER
+#endif
+
+#ifndef DICTIONARY_NO_DEBUGINFO
+#	define DICTIONARY_WITH_DEBUGINFO
+#endif
 
 #ifdef DICTIONARY_WITH_PROFILER
 #	define IF_PROFILER(cmd) cmd
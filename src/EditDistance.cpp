@@ -48,6 +48,8 @@ int EditDistance::Levenshtein(const SimpleString& pattern,
 {
 	if (matchType == SubstringMatch)
 		return Levenshtein_substring(pattern, text);
+	if (matchType == PrefixMatch)
+		return Levenshtein_prefix(pattern, text);
 	return Levenshtein_exact(pattern, text);
 }
 
@@ -57,6 +59,8 @@ int EditDistance::Levenshtein(const QString& pattern,
 {
 	if (matchType == SubstringMatch)
 		return Levenshtein_substring(SimpleString(pattern), SimpleString(text));
+	if (matchType == PrefixMatch)
+		return Levenshtein_prefix(SimpleString(pattern), SimpleString(text));
 	return Levenshtein_exact(SimpleString(pattern), SimpleString(text));
 }
 
@@ -67,6 +71,8 @@ int EditDistance::Ukkonen(const SimpleString& pattern,
 {
 	if (matchType == SubstringMatch)
 		return Ukkonen_substring(pattern, text, maxTypos);
+	if (matchType == PrefixMatch)
+		return Ukkonen_prefix(pattern, text, maxTypos);
 	return Ukkonen_exact(pattern, text, maxTypos);
 }
 
@@ -78,6 +84,9 @@ int EditDistance::Ukkonen(const QString& pattern,
 	if (matchType == SubstringMatch)
 		return Ukkonen_substring(SimpleString(pattern), 
 			SimpleString(text), maxTypos);
+	if (matchType == PrefixMatch)
+		return Ukkonen_prefix(SimpleString(pattern), 
+			SimpleString(text), maxTypos);
 	return Ukkonen_exact(SimpleString(pattern), SimpleString(text), maxTypos);
 }
 
@@ -172,6 +181,14 @@ int EditDistance::Levenshtein_substring(const SimpleString& pattern,
 	return rv;
 }
 
+int EditDistance::Levenshtein_prefix(const SimpleString& pattern, 
+									 const SimpleString& text)
+{
+	// Every distance is below this bound.
+	return Ukkonen_prefix(pattern, text,
+		qMax<uint>(pattern.size(), text.size()));
+}
+
 /**
  * Optimized version of the Levenshtein distance.
  *
@@ -497,6 +514,89 @@ int EditDistance::Ukkonen_substring(const SimpleString& aPattern,
 	return found? rv : maxTypos + 1;
 }
 
+/**
+ * Calculates the minimum edit distance of pattern to a prefix
+ * of text.
+ *
+ * Example:
+ * pattern: "amrs"
+ * text:    "armstrong"
+ * result:  2
+ *
+ * D[i][j] is the distance of the first i characters of pattern to
+ * the first j characters of text, the result is the minimum of the
+ * last row D[m][j]. Unlike in Ukkonen_substring() the first row is
+ * not 0 since the match has to start at the beginning of text.
+ *
+ * Every cell is at least the minimum of the previous column, so
+ * the minimum of the columns never decreases. As soon as it
+ * exceeds maxTypos (or the best result found so far) no prefix
+ * of the remaining text can do better and we stop.
+ */
+int EditDistance::Ukkonen_prefix(const SimpleString& aPattern,
+								 const SimpleString& aText,
+								 uint maxTypos)
+{
+	SimpleString pattern(aPattern);
+	SimpleString text(aText);
+	
+	uint m = pattern.size();
+	uint n = text.size();
+	
+	Q_ASSERT(maxTypos < UINT_MAX);
+
+	// Trivial cases.
+	if (text.startsWith(pattern))
+		return 0;
+	if (m > n + maxTypos)
+		return maxTypos + 1;
+	
+	// Levenshtein_prefix() passes bounds beyond 255, so the cells
+	// are wider than the ones of the other functions.
+	QVector<uint> V1(m + 1);
+	QVector<uint> V2(m + 1);
+	V2.fill(0);
+	
+	QVector<uint>* D1 = &V1;
+	QVector<uint>* D2 = &V2;
+	
+	// Initialize D1, the empty prefix of text.
+	for (uint i = 0; i < m + 1; i++)  {
+		(*D1)[i] = i;
+	}
+	uint rv = m;
+	
+	for (uint j = 1; j < n + 1; j++) {
+		(*D2)[0] = j;
+		uint columnMin = j;
+		for (uint i = 1; i < m + 1; i++) {
+			if (pattern[i - 1] == text[j - 1])
+				(*D2)[i] = (*D1)[i-1];
+			else {
+				(*D2)[i] = qMin(qMin(
+								(*D1)[i-1] + 1,
+								(*D2)[i-1] + 1),
+								(*D1)[i]   + 1);
+			}
+			if ((*D2)[i] < columnMin)
+				columnMin = (*D2)[i];
+#ifdef _DEBUG
+			ukkonen_counter++;
+#endif
+		}
+		if ((*D2)[m] < rv)
+			rv = (*D2)[m];
+		if (rv == 0)
+			return 0;
+		if (columnMin >= rv || columnMin > maxTypos)
+			// No longer prefix can do better.
+			break;
+		qSwap(D1, D2);
+		D2->fill(0);
+	}
+	return (rv <= maxTypos)? rv : maxTypos + 1;
+}
+
 void EditDistance::resetLevenshteinCounter()
 {
 	levenshtein_counter = 0;
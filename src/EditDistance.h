@@ -15,14 +15,16 @@ public:
 
 	enum MatchType {
 		ExactMatch,
-		SubstringMatch
+		SubstringMatch,
+		PrefixMatch
 	};
 
 	/**
 	 * Returns the edit distance between pattern and text.
 	 * If matchType == SubstringMatch, the pattern can be surrounded
-	 * by other text. Otherwise the pattern is assumed to be
-	 * a misspelled version of the whole text.
+	 * by other text. If matchType == PrefixMatch, the pattern can
+	 * be followed by other text. Otherwise the pattern is assumed
+	 * to be a misspelled version of the whole text.
 	 *
 	 */
 	static int calc(const SimpleString& pattern,
@@ -113,6 +115,24 @@ public:
 	static int Levenshtein_substring(const SimpleString& pattern,
 									 const SimpleString& text);
 
+	/**
+	 * Returns the smallest edit distance of a prefix
+	 * of text to pattern.
+	 *
+	 * Example:
+	 * text:    "armstrong"
+	 * pattern: "arms"
+	 * Returns: 0
+	 *
+	 * text:    "armstrong"
+	 * pattern: "amrs"
+	 * Returns: 2
+	 *
+	 * Needs O(len(pattern)) space.
+	 */
+	static int Levenshtein_prefix(const SimpleString& pattern,
+								  const SimpleString& text);
+
 	/**
 	 * An optimized version of the Levenshtein distance.
 	 * Optimizied in both space and time consumption.
@@ -148,6 +168,20 @@ public:
 	static int Ukkonen_substring(const SimpleString& aPattern,
 								 const SimpleString& aText, 
 								 uint maxTypos);
+
+	/**
+	 * Returns the smallest edit distance of a prefix of text
+	 * to pattern, like Levenshtein_prefix().
+	 *
+	 * The computation stops as soon as no prefix of text can be
+	 * within maxTypos, then a value greater than maxTypos is
+	 * returned.
+	 *
+	 * Needs O(len(pattern)) space.
+	 */
+	static int Ukkonen_prefix(const SimpleString& aPattern,
+							  const SimpleString& aText,
+							  uint maxTypos);
 								 
 	static int Stettner_exact(const QString& pattern,
 							  const QString& text,
@@ -0,0 +1,430 @@
+#include <core/precompiled.h>
+
+#include <QDir>
+
+#include <algorithm>
+
+#include "DictionaryDefines.h"
+#include "Private.h"
+#include "DictionaryDB.h"
+#include "DictException.h"
+#include "BitDistance.h"
+#include "CharHistogram.h"
+#include "ExternalBuilder.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+/// Approximate memory overhead of a QString besides its characters.
+static const quint64 stringOverhead = 32;
+
+/**
+ * Reads the relations of a run one after the other.
+ */
+class ExternalBuilder::Run
+{
+
+	QDataStream stream_;
+
+	/// Position of the run in the merge.
+	int index_;
+
+	quint32 size_;
+
+	quint32 remaining_;
+
+	GramKey current_;
+
+public:
+
+	Run(QIODevice* device, int index) :
+		stream_(),
+		index_(index),
+		size_(0),
+		remaining_(0),
+		current_()
+	{
+		device->seek(0);
+		stream_.setDevice(device);
+		stream_ >> size_;
+		remaining_ = size_;
+	}
+
+	/**
+	 * Reads the next relation. Returns false if the run is
+	 * exhausted or can't be read.
+	 */
+	bool next()
+	{
+		if (remaining_ == 0 || stream_.status() != QDataStream::Ok)
+			return false;
+		stream_ >> current_.gram >> current_.key;
+		remaining_--;
+		return stream_.status() == QDataStream::Ok;
+	}
+
+	/// Number of relations in the run.
+	quint32 size() const
+		{ return size_; }
+
+	/// True if the run couldn't be read to its end.
+	bool failed() const
+		{ return stream_.status() != QDataStream::Ok; }
+
+	const GramKey& current() const
+		{ return current_; }
+
+	/**
+	 * Orders the runs for a heap with the smallest gram on top.
+	 * Runs with the same gram are taken in the order they were
+	 * written, so the keys stay ascending.
+	 */
+	static bool greater(const Run* lhs, const Run* rhs)
+	{
+		if (lhs->current_.gram != rhs->current_.gram)
+			return rhs->current_.gram < lhs->current_.gram;
+		return lhs->index_ > rhs->index_;
+	}
+
+};
+
+/**
+ * Merges runs and delivers the keys of one gram after the other.
+ */
+class ExternalBuilder::Merger
+{
+
+	QList<Run*> runs_;
+
+	/// The runs which are not exhausted, see Run::greater().
+	QVector<Run*> heap_;
+
+	quint64 total_;
+
+	quint64 done_;
+
+public:
+
+	Merger() :
+		runs_(),
+		heap_(),
+		total_(0),
+		done_(0)
+		{ }
+
+	~Merger()
+	{
+		qDeleteAll(runs_);
+	}
+
+	/**
+	 * Opens the runs in the order they were written. Returns
+	 * false if one can't be opened.
+	 */
+	bool open(const QList<QTemporaryFile*>& files)
+	{
+		for (int i = 0; i < files.size(); i++) {
+			if (files[i]->open() == false)
+				return false;
+			Run* run = new Run(files[i], i);
+			runs_.append(run);
+			total_ += run->size();
+			if (run->next()) {
+				heap_.append(run);
+				std::push_heap(heap_.begin(), heap_.end(), Run::greater);
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Takes the smallest gram and its keys, ascending and without
+	 * duplicates. Returns false if all runs are exhausted.
+	 */
+	bool next(QString& gram, QVector<KeyType>& keys)
+	{
+		keys.clear();
+		if (heap_.isEmpty())
+			return false;
+		gram = heap_.first()->current().gram;
+		while (heap_.isEmpty() == false &&
+			   heap_.first()->current().gram == gram)
+		{
+			std::pop_heap(heap_.begin(), heap_.end(), Run::greater);
+			Run* run = heap_.last();
+			KeyType key = run->current().key;
+			// A gram can occur more than once in the same entry.
+			if (keys.isEmpty() || keys.last() != key)
+				keys.append(key);
+			done_++;
+			if (run->next())
+				std::push_heap(heap_.begin(), heap_.end(), Run::greater);
+			else
+				heap_.pop_back();
+		}
+		return true;
+	}
+
+	/// True if a run couldn't be read to its end.
+	bool failed() const
+	{
+		foreach (const Run* run, runs_) {
+			if (run->failed())
+				return true;
+		}
+		return false;
+	}
+
+	/// Number of relations in the runs.
+	quint64 total() const
+		{ return total_; }
+
+	/// Number of relations merged so far.
+	quint64 done() const
+		{ return done_; }
+
+};
+
+ExternalBuilder::ExternalBuilder(Dictionary& dict, quint64 memoryLimit,
+								 AbstractBuildProgress* progress) :
+	d_(*dict.d_),
+	progress_(progress),
+	memoryLimit_(qMax(memoryLimit, minMemoryLimit)),
+	tempPath_(QDir::tempPath()),
+	buffer_(),
+	bufferSize_(0),
+	runs_(),
+	entryHashes_()
+{ }
+
+ExternalBuilder::~ExternalBuilder()
+{
+	deleteRuns();
+}
+
+void ExternalBuilder::setTempPath(const QString& path)
+{
+	tempPath_ = path;
+}
+
+void ExternalBuilder::deleteRuns()
+{
+	// QTemporaryFile removes the file on destruction.
+	qDeleteAll(runs_);
+	runs_.clear();
+}
+
+void ExternalBuilder::reportProgress(AbstractBuildProgress::Stage stage,
+									 quint64 done, quint64 total)
+{
+	if (progress_)
+		progress_->progress(stage, done, total);
+}
+
+bool ExternalBuilder::isDuplicate(const QString& encodedLine) const
+{
+	QMultiHash<uint, KeyType>::const_iterator i =
+		entryHashes_.constFind(qHash(encodedLine));
+	while (i != entryHashes_.constEnd() && i.key() == qHash(encodedLine)) {
+		if (d_.encodedEntries_.isEqual(encodedLine, i.value()))
+			return true;
+		i++;
+	}
+	return false;
+}
+
+bool ExternalBuilder::processLine(const QString& line)
+{
+	if (static_cast<uint>(d_.encodedEntries_.size()) == KEYTYPE_MAX)
+		throw Exception(Exception::TooManyEntries);
+
+	QString encodedLine = d_.encode(line);
+	if (encodedLine.isEmpty()) return true;
+	if (isDuplicate(encodedLine)) return true;
+
+	KeyType key = d_.encodedEntries_.size();
+	entryHashes_.insert(qHash(encodedLine), key);
+	d_.encodedEntries_.append(encodedLine);
+	d_.entries_.append(line);
+	d_.bitencodedEntries_.append(
+		BitDistance::bitPattern(encodedLine.unicode(), encodedLine.size()));
+	d_.histograms_.append(
+		CharHistogram(encodedLine.unicode(), encodedLine.size()));
+
+	QStringList grams = d_.grams(encodedLine);
+	foreach (const QString& gram, grams) {
+		buffer_.append(GramKey(gram, key));
+		bufferSize_ += sizeof(GramKey) + stringOverhead +
+			sizeof(QChar) * gram.size();
+	}
+	if (bufferSize_ >= memoryLimit_)
+		return spill();
+	return true;
+}
+
+QTemporaryFile* ExternalBuilder::createRun() const
+{
+	QTemporaryFile* file = new QTemporaryFile(
+		QDir(tempPath_).filePath("dictionary-run-XXXXXX"));
+	if (!file->open()) {
+		delete file;
+		return 0;
+	}
+	return file;
+}
+
+bool ExternalBuilder::spill()
+{
+	if (buffer_.isEmpty())
+		return true;
+
+	// The buffer is filled in key order, a stable sort keeps
+	// the keys of equal grams ascending.
+	qStableSort(buffer_.begin(), buffer_.end());
+
+	QTemporaryFile* file = createRun();
+	if (file == 0)
+		return false;
+	runs_.append(file);
+
+	QDataStream out(file);
+	out << (quint32)buffer_.size();
+	for (QVector<GramKey>::const_iterator i = buffer_.constBegin();
+		 i != buffer_.constEnd(); i++)
+	{
+		out << i->gram << (quint32)i->key;
+	}
+	bool rv = (out.status() == QDataStream::Ok);
+	// Reopened by the merge, don't hold a descriptor per run.
+	file->close();
+
+	buffer_.clear();
+	bufferSize_ = 0;
+	return rv;
+}
+
+QTemporaryFile* ExternalBuilder::mergeRuns(
+	const QList<QTemporaryFile*>& files) const
+{
+	QTemporaryFile* file = createRun();
+	if (file == 0)
+		return 0;
+	Merger merger;
+	if (merger.open(files) == false) {
+		delete file;
+		return 0;
+	}
+
+	// The size is known when the relations are written.
+	QDataStream out(file);
+	out << (quint32)0;
+	quint32 size = 0;
+	QString gram;
+	QVector<KeyType> keys;
+	while (merger.next(gram, keys)) {
+		foreach (KeyType key, keys)
+			out << gram << (quint32)key;
+		size += keys.size();
+	}
+	file->seek(0);
+	out << size;
+	bool rv = (out.status() == QDataStream::Ok && merger.failed() == false);
+	file->close();
+	if (rv == false) {
+		delete file;
+		return 0;
+	}
+	return file;
+}
+
+bool ExternalBuilder::merge()
+{
+	// Merging groups of consecutive runs keeps the keys of a gram
+	// ascending between the runs.
+	while (runs_.size() > maxFanIn) {
+		QList<QTemporaryFile*> pass;
+		qSwap(pass, runs_);
+		while (pass.isEmpty() == false) {
+			QList<QTemporaryFile*> group = pass.mid(0, maxFanIn);
+			pass = pass.mid(group.size());
+			QTemporaryFile* file = mergeRuns(group);
+			qDeleteAll(group);
+			if (file == 0) {
+				qDeleteAll(pass);
+				return false;
+			}
+			runs_.append(file);
+		}
+	}
+
+	Private::DB db;
+	if (!db.beginSave(d_.dictFilename_ + Private::DB::newSuffix_))
+		return false;
+
+	Merger merger;
+	if (merger.open(runs_) == false)
+		return false;
+	QString gram;
+	QVector<KeyType> keys;
+	while (merger.next(gram, keys)) {
+		// Write the Container and keep just its id and size.
+		Private::Value::PtrToContainer p(new Private::Value::Container(true));
+		p->append(keys);
+		db.appendContainer(*p);
+		p->unload(d_.db_);
+		d_.gramHash_.insert(gram, p);
+
+		reportProgress(AbstractBuildProgress::Merging, merger.done(),
+			merger.total());
+	}
+	if (merger.failed())
+		return false;
+
+	d_.gramHash_.sort();
+	return db.endSave(d_) && Private::DB::commit(d_.dictFilename_);
+}
+
+bool ExternalBuilder::buildFrom(const QString& dictFile)
+{
+	d_.clear();
+	d_.dictFilename_ = dictFile;
+	QFile file(dictFile);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		return false;
+	quint64 total = file.size();
+	QTextStream in(&file);
+	in.setCodec("UTF-8");
+
+	quint64 lineCounter = 0;
+	while(!in.atEnd()) {
+		if (processLine(in.readLine()) == false) {
+			deleteRuns();
+			return false;
+		}
+		lineCounter += 1;
+		if (lineCounter % 10000 == 0)
+			reportProgress(AbstractBuildProgress::Encoding, file.pos(), total);
+	}
+	reportProgress(AbstractBuildProgress::Encoding, total, total);
+	entryHashes_.clear();
+
+	bool rv = spill() && merge();
+	deleteRuns();
+	if (rv == false)
+		return false;
+
+	// The log of the old dictionary files doesn't apply anymore.
+	DeltaLog::remove(dictFile);
+
+	// Reopen the dictionary, the Containers are loaded lazily.
+	d_.clear();
+	d_.dictFilename_ = dictFile;
+	return d_.load();
+}
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
@@ -0,0 +1,166 @@
+#ifndef DISTILLER_DICTIONARYIMPL_EXTERNALBUILDER_H
+#define DISTILLER_DICTIONARYIMPL_EXTERNALBUILDER_H
+
+#pragma once
+
+#include <QTemporaryFile>
+
+#include "AbstractBuildProgress.h"
+#include "KeyDistTuple.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+/**
+ * Builds the dictionary files (.idb and .kdb) for dictionaries whose
+ * index does not fit into memory.
+ *
+ * Instead of inserting every (gram, key) relation into the GramHash
+ * we collect them in a buffer. If the buffer exceeds the memory limit
+ * it is sorted by gram and written to a temporary file (a run).
+ * Finally the runs are merged: the merge delivers the relations
+ * ordered by gram and -- since the keys are ascending within a run
+ * and between the runs -- by key. Every gram results in one Container
+ * which is written to the container file and freed right away, so
+ * the GramHash holds only the ids and sizes of the Containers.
+ *
+ * At most maxFanIn runs are merged at once, so the number of open
+ * files stays bounded. If there are more runs, consecutive groups
+ * of them are merged into longer runs first. The smallest gram of
+ * the runs is taken from a heap.
+ *
+ * The memory limit bounds the buffer of the relations only. The
+ * entries, a hash per entry for dropping duplicates and the
+ * GramHash with an id and a size per distinct gram are kept in
+ * memory besides, as are the entries when the dictionary is loaded.
+ */
+class ExternalBuilder
+{
+
+public:
+
+	/**
+	 * A (gram, key) relation.
+	 */
+	class GramKey
+	{
+
+	public:
+
+		QString gram;
+
+		KeyType key;
+
+		GramKey() : gram(), key(KeyDistTuple::invalidKey)
+			{ }
+
+		GramKey(const QString& aGram, KeyType aKey) :
+			gram(aGram), key(aKey)
+			{ }
+
+		bool operator < (const GramKey& rhs) const
+			{ return gram < rhs.gram; }
+
+	};
+
+	/// The smallest memory limit accepted.
+	static const quint64 minMemoryLimit = 1024 * 1024;
+
+	/// The maximum number of runs merged at once.
+	static const int maxFanIn = 64;
+
+private:
+
+	class Run;
+
+	class Merger;
+
+	Private& d_;
+
+	AbstractBuildProgress* progress_;
+
+	quint64 memoryLimit_;
+
+	QString tempPath_;
+
+	/// Relations which have not been written to a run yet.
+	QVector<GramKey> buffer_;
+
+	/// Estimated memory used by buffer_.
+	quint64 bufferSize_;
+
+	/// The runs written so far, closed until they are merged.
+	QList<QTemporaryFile*> runs_;
+
+	/**
+	 * Hash of the encoded entries --> key. Used for removing
+	 * duplicates without keeping a second copy of every entry.
+	 */
+	QMultiHash<uint, KeyType> entryHashes_;
+
+	bool isDuplicate(const QString& encodedLine) const;
+
+	/**
+	 * Inserts a line into the dictionary.
+	 * Throws Exception(Exception::TooManyEntries) if the maximum numbers
+	 * of entries is exceeded. Returns false if a run couldn't
+	 * be written.
+	 */
+	bool processLine(const QString& line);
+
+	/**
+	 * Creates and opens an empty run. Returns 0 on failure.
+	 */
+	QTemporaryFile* createRun() const;
+
+	/**
+	 * Sorts the buffer and writes it to a new run.
+	 */
+	bool spill();
+
+	/**
+	 * Merges files into a new run. Returns 0 on failure.
+	 */
+	QTemporaryFile* mergeRuns(const QList<QTemporaryFile*>& files) const;
+
+	/**
+	 * Merges all runs and writes the Containers and the index.
+	 */
+	bool merge();
+
+	void deleteRuns();
+
+	void reportProgress(AbstractBuildProgress::Stage stage,
+						quint64 done, quint64 total);
+
+public:
+
+	/**
+	 * memoryLimit is the number of bytes the builder may use
+	 * for buffering (gram, key) relations.
+	 */
+	ExternalBuilder(Dictionary& dict, quint64 memoryLimit,
+					AbstractBuildProgress* progress = 0);
+
+	~ExternalBuilder();
+
+	/**
+	 * Directory for the temporary runs. Defaults to QDir::tempPath().
+	 */
+	void setTempPath(const QString& path);
+
+	/**
+	 * Builds the dictionary files for dictFile and loads them.
+	 */
+	bool buildFrom(const QString& dictFile);
+
+};
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
+
+#endif
@@ -3,7 +3,13 @@
 
 #pragma once
 
+#include <algorithm>
+
+#include <QVector>
+
 #include "GramNode.h"
+#include "MemoryUsage.h"
+#include "Profiler.h"
 
 namespace Distiller
 {
@@ -11,16 +17,13 @@ namespace Distiller
 namespace DictionaryImpl
 {
 
-template<typename ThreadPolicy>
-class DictionaryDB;
-
 /**
  * GramHash stores relations between grams (substrings of
- * a string) and list of keys. For every gram we get a list 
+ * a string) and list of keys. For every gram we get a list
  * of keys, where the gram occours. We store this list of keys
  * in a Container, that can be a Vector of keys or a
  * Burkhard-Keller-Tree.
- * 
+ *
  * What makes this data structure a bit complicated is the
  * need to get the proper keys for all suffixes of the stores
  * grams down to a length of minGramSize as well.
@@ -32,115 +35,130 @@ class DictionaryDB;
  * entry "A Foo Bar". It is the 11th entry in our dictionary.
  *
  * So we want to store the relation "foob" --> 11.
- * 
+ *
  * Since we need to look up suffixes of the grams as well we
- * also have to store
+ * also need
  *
  *     "foo" --> 11
  *     "fo"  --> 11
  *
  * (Assuming that minGramSize equals 2).
  *
- * We don't need to store copies of the Container, which would be
- * a waste of space. We just save references to the Container in 
- * the suffixes. So our example would look like this:
+ * We don't store these relations at all. Every gram has exactly
+ * one Container, and the grams are kept in a table sorted
+ * lexicographically:
  *
- *    GramNode    List of          Container 
- *                PtrToContainer     (usually of type KeyList)
+ *    Gram      PtrToContainer     Container
+ *                                 (usually of type KeyList)
  * -----------------------------------------------------------
  *
- *     "foob" --->[0xFE]
- *                   |
- *                   +-----------> [7, 10, 13, ...]
+ *     "fo"  ---> [0xFC] ---------> [5]
+ *     "foob" --> [0xFE] ---------> [7, 10, 13, ...]
+ *     "fooc" --> [0xFD] ---------> [8, 12, 4, 6, ...]
  *
- *     "fooc" --->[0xFD]
- *                   | 
- *                   +-----------> [8, 12, 4, 6, ...]
- *                 
- * "foo" is the suffix of both the grams "foob" and "fooc"
- * so we need a list of pointers to both Containers.
+ * All grams "foo" is a suffix of follow each other in the table,
+ * so the Containers of "foo" are the range from "foob" to
+ * "fooc", the Containers of "fo" the range from "fo" to "fooc".
+ * A lookup is a binary search for both ends of the range, and
+ * a GramNode just refers to it.
  *
- *     "foo" ---->[0xFE, 0xFD]
+ * Despite its name GramHash therefore holds two flat vectors,
+ * without hash buckets and without lists of pointers for the
+ * short grams, which point to thousands of Containers.
  *
- * The same applies to "fo", which is also a suffix of "foob"
- * and "fooc". 
- *
- *     "fo" ----->[0xFE, 0xFD] 
+ * Inserting a single gram keeps the table sorted and moves the
+ * grams behind it. The bulk insertions used when building and
+ * loading a dictionary just append and leave it to sort() to
+ * order the table and merge the Containers of equal grams.
  */
 template <typename ThreadPolicy = NoThreadPolicy>
-class GramHash :
-	protected QHash<QString, GramNode<ThreadPolicy> >
+class GramHash
 {
 
 public:
-	
+
 	typedef GramNode<ThreadPolicy> Value;
 
 private:
 
-	typedef QHash<QString, Value> Super;
+	typedef typename Value::PtrToContainer PtrToContainer;
 
 	/**
-	 * distinctiveContainers_ is a helper member. We need it to
-	 * correctly serialize and deserialize the GramHash.
-	 *
-	 * The hash itself stores GramNodes which points to Containers.
-	 * Suffixes of Grams point to the same Containers. 
-	 *
-	 * To serialize and deserialize the GramHash in a QDataStream
-	 * we're interested only in the distinctive Containers, so we have
-	 * to save links to them also. Otherwise we had to compute
-	 * which Containers had been serialized already, which is not as
-	 * easy as just storing pointers to them.
+	 * Compares a prefix with the grams of the table. The grams
+	 * starting with the prefix compare equal to it.
+	 */
+	class PrefixLess
+	{
+
+		int size_;
+
+	public:
+
+		PrefixLess(int size) : size_(size)
+			{ }
+
+		bool operator () (const QString& prefix, const QString& gram) const
+			{ return QStringRef::compare(gram.leftRef(size_), prefix) > 0; }
+
+	};
+
+	/**
+	 * Orders the positions of the table by their grams.
+	 */
+	class IndexLess
+	{
+
+		const QVector<QString>& grams_;
+
+	public:
+
+		IndexLess(const QVector<QString>& grams) : grams_(grams)
+			{ }
+
+		bool operator () (int a, int b) const
+			{ return grams_[a] < grams_[b]; }
+
+	};
+
+	/// The grams, sorted unless unsorted_ is set.
+	QVector<QString> grams_;
+
+	/// containers_[i] is the Container of grams_[i].
+	QVector<PtrToContainer> containers_;
+
+	/**
+	 * Set by the bulk insertions if a gram isn't appended in
+	 * order, until sort() is called.
 	 */
-	QHash<QString, Value> distinctiveContainers_;
-	
-	quint32 gramCount_;
+	bool unsorted_;
 
 	quint32 minGramSize_;
 
 	quint32 maxGramSize_;
 
 	/**
-	 * Inserts a distinctive PtrToContainer.
-	 *
-	 * \note The Container is assumed to be distinctive,  
-	 * the method doesn't check that. It just adds it to
-	 * distinctiveContainers_.
+	 * Returns the position of the first gram not less than gram.
 	 */
-	void insertDistinctivePtrToContainer(const QString& gram, 
-		const typename Value::PtrToContainer& p);
-		
+	int lowerBound(const QString& gram) const;
+
 	/**
-	 * Inserts a given PtrToContainer for a gram and all its
-	 * suffixes down to minGramSize.
-	 *
-	 * Constructs proper GramNodes where necessary.
-	 *
-	 * \note This method doesn't append p to distinctiveKeySets_.
+	 * Returns the positions [first, last) of the grams gram is
+	 * a suffix of, including gram itself.
 	 */
-	void insertPtrToContainer(const QString& gram,
-							  const typename Value::PtrToContainer& p);
-						 
+	void range(const QString& gram, int& first, int& last) const;
+
 	/**
-	 * Inserts every PtrToContainer of node into the data
-	 * structure.
-	 *
-	 * Node itself isn't inserted but the method iterates
-	 * over all PtrToContainer and inserts them using
-	 * insertPtrToContainer().
-	 *
-	 * \note Assumes that every PtrToContainer points to a 
-	 * distinctive Container.
+	 * Appends a Container for gram to the table.
 	 */
-	void insertNode(const QString& gram,
-					const Value& node);
+	void append(const QString& gram, const PtrToContainer& p);
 
-public:
+	/**
+	 * Reads a gram and its Containers, each of them by load.
+	 */
+	template <typename Load>
+	void loadGram(QDataStream& in, Load load);
 
-    typedef typename Super::iterator iterator;
-	
-    typedef typename Super::const_iterator const_iterator;
+public:
 
 	IF_PROFILER(mutable Profiler* profiler);
 
@@ -152,72 +170,102 @@ public:
 			 quint32 minGramSize = defaultMinGramSize);
 
 	/**
-	 * Inserts a (key, distance) tuple for gram and all of it's 
+	 * Inserts a key for gram, which is found by all of its
 	 * suffixes down to a length of minGramSize.
-	 * 
-	 * Constructs Containers and proper GramNodes.
 	 *
-	 * You have to recalculate all of the GramNode's valueCounter_
-	 * afterwards by runnung reCountAllNodes().
+	 * Constructs the Container of gram if necessary and keeps
+	 * the table sorted.
 	 */
 	void insert(const QString& gram, KeyType key);
-	
+
+	/**
+	 * Inserts a list of keys for gram at once. Used by the
+	 * Builder to merge the grams collected by its threads.
+	 *
+	 * This is a bulk insertion: the Container is appended even
+	 * if gram is there already. You have to call sort()
+	 * afterwards.
+	 */
+	void insert(const QString& gram, const QVector<KeyType>& keys);
+
+	/**
+	 * Inserts a complete Container for gram.
+	 *
+	 * This is a bulk insertion, you have to call sort()
+	 * afterwards. The ExternalBuilder inserts the grams in sorted
+	 * order, so sort() has nothing to do.
+	 */
+	void insert(const QString& gram, const PtrToContainer& p);
+
+	/**
+	 * Sorts the table after bulk insertions and merges the
+	 * Containers of equal grams.
+	 */
+	void sort();
+
 	quint32 minGramSize() const;
-	
+
 	quint32 maxGramSize() const;
-		
+
 	bool contains(const QString& gram) const;
-		
+
+	/**
+	 * Returns every Container of the hash exactly once, in the
+	 * order of the table. saveShallow() numbers the Containers in
+	 * this order, so a DB has to write them in this order too.
+	 */
+	QList<PtrToContainer> containers() const;
+
+	/**
+	 * Number of Containers.
+	 */
+	int size() const;
+
+	/**
+	 * Adds the memory of the table and the Containers to usage.
+	 */
+	void memoryUsage(Dictionary::MemoryUsage& usage) const;
+
 	/**
-	 * Recalculates the valueCounter_ of all nodes.
+	 * Removes key from the Container of gram, where insert()
+	 * put it.
+	 *
+	 * Returns true if the key has been found.
 	 */
-	void reCountAllNodes();
+	bool remove(const QString& gram, KeyType key);
 
 	QDataStream& loadDeep(QDataStream& in);
 
-	friend QDataStream& operator >> (QDataStream& in, 
+	friend QDataStream& operator >> (QDataStream& in,
 									 GramHash<ThreadPolicy>& node)
     { return node.loadDeep(in); }
 
 	QDataStream& saveDeep(QDataStream& out) const;
-	
-	friend QDataStream& operator << (QDataStream& out, 
+
+	friend QDataStream& operator << (QDataStream& out,
                                      const GramHash<ThreadPolicy>& hash)
     { return hash.saveDeep(out); }
 
 	void loadShallow(QDataStream& in,
 					 AbstractDB<typename Value::Container>* db);
-	
+
 	void saveShallow(QDataStream& out) const;
-	
-	const_iterator constBegin() const;
-	
-	const_iterator begin() const;
-	
-	const_iterator constEnd() const;	
-	
-	const_iterator end() const;
-	
+
+	/**
+	 * Returns the Containers of gram and of all grams it is a
+	 * suffix of.
+	 */
 	const Value operator[] (const QString& gram) const;
-	
-	Value& operator[] (const QString& gram);
-	
-	iterator begin();
-	
-	iterator end();
-	
+
 	void clear();
-		
-    template<typename>
-	friend class DictionaryDB;
 };
 
 template <typename ThreadPolicy>
 GramHash<ThreadPolicy>::GramHash(quint32 maxGramSize,
-								 quint32 minGramSize) : 
-	QHash<QString, Value>(),
-	distinctiveContainers_(),
-	gramCount_(0),
+								 quint32 minGramSize) :
+	grams_(),
+	containers_(),
+	unsorted_(false),
 	minGramSize_(minGramSize),
 	maxGramSize_(maxGramSize)
 #ifdef DICTIONARY_WITH_PROFILER
@@ -236,201 +284,290 @@ quint32 GramHash<ThreadPolicy>::maxGramSize() const
 {
 	return maxGramSize_;
 }
-	
+
 template <typename ThreadPolicy>
-void GramHash<ThreadPolicy>::reCountAllNodes()
+int GramHash<ThreadPolicy>::lowerBound(const QString& gram) const
 {
-	for (iterator i = begin(); i != end(); i++)
-		i->reCount();
-	for (iterator j = distinctiveContainers_.begin(); 
-                j != distinctiveContainers_.end(); j++)
-		j->reCount();
+	Q_ASSERT(unsorted_ == false);
+	return std::lower_bound(grams_.constBegin(), grams_.constEnd(), gram)
+		- grams_.constBegin();
 }
 
 template <typename ThreadPolicy>
-void GramHash<ThreadPolicy>::insertDistinctivePtrToContainer(
-	const QString& gram, 
-	const typename Value::PtrToContainer& p
-)
+void GramHash<ThreadPolicy>::range(const QString& gram,
+								   int& first, int& last) const
 {
-	Q_ASSERT((quint32)gram.size() >= minGramSize_ &&
-			 (quint32)gram.size() <= maxGramSize_);
-	Value node;
-	node.append(p);
-	distinctiveContainers_.insert(gram, node);
+	Q_ASSERT(unsorted_ == false);
+	first = lowerBound(gram);
+	// The grams starting with gram follow the first one.
+	typename QVector<QString>::const_iterator i = std::upper_bound(
+		grams_.constBegin() + first, grams_.constEnd(), gram,
+		PrefixLess(gram.size()));
+	last = i - grams_.constBegin();
 }
 
 template <typename ThreadPolicy>
-bool GramHash<ThreadPolicy>::contains(const QString& gram) const
+bool GramHash<ThreadPolicy>::remove(const QString& gram, KeyType key)
 {
-	return Super::contains(gram);
+	/**
+	 * insert() and the builders put the key into the Container of
+	 * the gram itself, and the DictionaryDB rejects files of older
+	 * versions. So the other Containers of the range, which might
+	 * have to be loaded from disk, don't need to be checked.
+	 */
+	quint32 size = qMin<quint32>(maxGramSize_, gram.size());
+	QString subgram = gram.left(size);
+	int i = lowerBound(subgram);
+	if (i == grams_.size() || grams_[i] != subgram)
+		return false;
+	return containers_[i]->remove(key);
 }
 
 template <typename ThreadPolicy>
-void GramHash<ThreadPolicy>::insertPtrToContainer(const QString& gram,
-	const typename Value::PtrToContainer& p)
-{	
-	Q_ASSERT((quint32)gram.size() >= minGramSize_ &&
-			 (quint32)gram.size() <= maxGramSize_);
-			 
-	QString subgram = gram;
-	quint32 size = gram.size();
-	while (size >= minGramSize_) {
-		if (contains(subgram) == false) {
-			Value node;
-			node.append(p);
-			Super::insert(subgram, node);
-			gramCount_ += 1;
-		}
-		else
-			(*this)[subgram].append(p);
-		size--;
-		subgram = gram.left(size);
-	}
+bool GramHash<ThreadPolicy>::contains(const QString& gram) const
+{
+	int i = lowerBound(gram);
+	return i < grams_.size() && grams_[i].startsWith(gram);
 }
 
 template <typename ThreadPolicy>
-void GramHash<ThreadPolicy>::insert(const QString& gram, 
-									KeyType key)
+QList<typename GramHash<ThreadPolicy>::PtrToContainer>
+GramHash<ThreadPolicy>::containers() const
 {
-	quint32 size = qMin<quint32>(maxGramSize_, gram.size());
-	QString subgram = gram.left(size);
-	if (contains(subgram)) {
-		/**
-		 * Node already there, just insert (key, distance) tuple.
-		 *
-		 * Since this insertion expands a Container directly,
-		 * all valueCount_ members of GramNodes that point to this
-		 * Container get out of sync!
-		 *
-		 * You have to run reCountAllNodes() to recalculate the 
-		 * valueCount_ of all GramNodes!
-		 */ 
-		(*this)[subgram].append(key);
-	}
-	else {
-        typename Value::PtrToContainer p(new typename Value::Container(true));
-		p->append(key);
-		// We have a newly created Container here, so
-		// add it to distinctiveContainer_.
-		insertDistinctivePtrToContainer(subgram, p);
-		// Finally append PtrToContainer to list.
-		insertPtrToContainer(subgram, p);
-	}
+	return containers_.toList();
 }
 
 template <typename ThreadPolicy>
-void GramHash<ThreadPolicy>::insertNode(const QString& gram, 
-										const Value& node)
+int GramHash<ThreadPolicy>::size() const
 {
-    for (typename Value::const_iterator i = node.constBegin();
-		 i != node.constEnd(); i++)
-	{
-		insertDistinctivePtrToContainer(gram, *i);
-		insertPtrToContainer(gram, *i);
-	}
+	return containers_.size();
 }
 
 template <typename ThreadPolicy>
-typename GramHash<ThreadPolicy>::const_iterator
-GramHash<ThreadPolicy>::constBegin() const
+void GramHash<ThreadPolicy>::memoryUsage(Dictionary::MemoryUsage& usage) const
 {
-	return Super::constBegin();
+	/**
+	 * QSharedPointer allocates a block with the strong and the
+	 * weak reference count and a pointer to the deleter.
+	 */
+	static const quint64 controlBlockSize = 2 * sizeof(int) + sizeof(void*);
+
+	static const quint64 stringHeader = 4 * sizeof(int) + sizeof(void*);
+
+	if (grams_.capacity() > 0)
+		usage.gramHash += sizeof(QVectorData) +
+			grams_.capacity() * sizeof(QString);
+	if (containers_.capacity() > 0)
+		usage.gramHash += sizeof(QVectorData) +
+			containers_.capacity() * sizeof(PtrToContainer);
+	foreach (const QString& gram, grams_)
+		usage.gramHash += stringHeader + (gram.capacity() + 1) * sizeof(QChar);
+
+	foreach (const PtrToContainer& p, containers_) {
+		usage.containers += sizeof(typename Value::Container);
+		usage.controlBlocks += controlBlockSize;
+		if (p->isLoaded()) {
+			usage.loadedContainers++;
+			usage.postings += p->memoryUsage();
+		}
+		else
+			usage.unloadedContainers++;
+	}
 }
-	
+
 template <typename ThreadPolicy>
-typename GramHash<ThreadPolicy>::const_iterator
-GramHash<ThreadPolicy>::begin() const
+void GramHash<ThreadPolicy>::append(const QString& gram,
+									const PtrToContainer& p)
 {
-	return Super::begin();
+	Q_ASSERT((quint32)gram.size() >= minGramSize_ &&
+			 (quint32)gram.size() <= maxGramSize_);
+	if (grams_.isEmpty() == false && (grams_.last() < gram) == false)
+		unsorted_ = true;
+	grams_.append(gram);
+	containers_.append(p);
 }
-	
+
 template <typename ThreadPolicy>
-typename GramHash<ThreadPolicy>::const_iterator
-GramHash<ThreadPolicy>::constEnd() const
+void GramHash<ThreadPolicy>::insert(const QString& gram,
+									KeyType key)
 {
-	return Super::constEnd();
+	quint32 size = qMin<quint32>(maxGramSize_, gram.size());
+	QString subgram = gram.left(size);
+	int i = lowerBound(subgram);
+	if (i < grams_.size() && grams_[i] == subgram) {
+		// Container already there, just insert the key.
+		containers_[i]->append(key);
+	}
+	else {
+		Q_ASSERT(size >= minGramSize_);
+        PtrToContainer p(new typename Value::Container(true));
+		p->append(key);
+		grams_.insert(i, subgram);
+		containers_.insert(i, p);
+	}
 }
-	
+
 template <typename ThreadPolicy>
-typename GramHash<ThreadPolicy>::const_iterator
-GramHash<ThreadPolicy>::end() const
+void GramHash<ThreadPolicy>::insert(const QString& gram,
+									const QVector<KeyType>& keys)
 {
-	return Super::end();
+	if (keys.isEmpty())
+		return;
+	quint32 size = qMin<quint32>(maxGramSize_, gram.size());
+	PtrToContainer p(new typename Value::Container(true));
+	p->append(keys);
+	append(gram.left(size), p);
 }
-	
+
 template <typename ThreadPolicy>
-typename GramHash<ThreadPolicy>::iterator
-GramHash<ThreadPolicy>::begin()
+void GramHash<ThreadPolicy>::insert(const QString& gram,
+									const PtrToContainer& p)
 {
-	return Super::begin();
+	append(gram, p);
 }
-	
+
 template <typename ThreadPolicy>
-typename GramHash<ThreadPolicy>::iterator
-GramHash<ThreadPolicy>::end()
+void GramHash<ThreadPolicy>::sort()
 {
-	return Super::end();
+	if (unsorted_ == false)
+		return;
+
+	IF_PROFILER(ProfilerTimer timer(profiler, Profiler::Sort));
+
+	// Sorting stable keeps the keys of a gram in the order
+	// they have been inserted.
+	QVector<int> order(grams_.size());
+	for (int i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), IndexLess(grams_));
+
+	QVector<QString> grams;
+	QVector<PtrToContainer> containers;
+	grams.reserve(grams_.size());
+	containers.reserve(containers_.size());
+	foreach (int i, order) {
+		if (grams.isEmpty() == false && grams.last() == grams_[i])
+			containers.last()->append(containers_[i]->keys());
+		else {
+			grams.append(grams_[i]);
+			containers.append(containers_[i]);
+		}
+	}
+	grams_ = grams;
+	containers_ = containers;
+	unsorted_ = false;
 }
 
 template <typename ThreadPolicy>
 void GramHash<ThreadPolicy>::clear()
 {
-	Super::clear();
+	grams_.clear();
+	containers_.clear();
+	unsorted_ = false;
 }
 
 template <typename ThreadPolicy>
-const typename GramHash<ThreadPolicy>::Value 
+const typename GramHash<ThreadPolicy>::Value
 GramHash<ThreadPolicy>::operator[] (const QString& gram) const
 {
-	return Super::operator[](gram);
+	int first;
+	int last;
+	range(gram, first, last);
+	return Value(containers_.constData() + first,
+				 containers_.constData() + last);
 }
 
 template <typename ThreadPolicy>
-typename GramHash<ThreadPolicy>::Value&
-GramHash<ThreadPolicy>::operator[] (const QString& gram)
+template <typename Load>
+void GramHash<ThreadPolicy>::loadGram(QDataStream& in, Load load)
 {
-	return Super::operator[](gram);
+	QString gram;
+	quint32 count;
+	in >> gram >> count;
+	while (count-- > 0) {
+		PtrToContainer p;
+		{
+			IF_PROFILER(ProfilerTimer timer(profiler, Profiler::CreateNode));
+			p = PtrToContainer(new typename Value::Container);
+			load(*p);
+		}
+		IF_PROFILER(ProfilerTimer timer(profiler, Profiler::InsertNode));
+		append(gram, p);
+	}
 }
 
+/**
+ * Reads a Container with all its keys.
+ */
+template <typename Container>
+class LoadDeep
+{
+
+	QDataStream& in_;
+
+public:
+
+	LoadDeep(QDataStream& in) : in_(in)
+		{ }
+
+	void operator () (Container& container)
+		{ container.loadDeep(in_); }
+
+};
+
+/**
+ * Reads the id and size of a Container, its keys are loaded
+ * from db when they are needed.
+ */
+template <typename Container>
+class LoadShallow
+{
+
+	QDataStream& in_;
+
+	AbstractDB<Container>* db_;
+
+public:
+
+	LoadShallow(QDataStream& in, AbstractDB<Container>* db) :
+		in_(in), db_(db)
+		{ }
+
+	void operator () (Container& container)
+		{ container.loadShallow(in_, db_); }
+
+};
+
 template <typename ThreadPolicy>
 QDataStream& GramHash<ThreadPolicy>::loadDeep(QDataStream& in)
 {
 	quint32 size;
 	in >> size;
-	
-	while (size-- > 0) {
-		QString gram;
-		Value node;
-		in >> gram;
-		
-		IF_PROFILER(node.profiler = profiler);
-		node.loadDeep(in);
-		
-		IF_PROFILER(profiler->timer.restart());
-		insertNode(gram, node);
-		IF_PROFILER(profiler->insertnode_time += profiler->timer.elapsed());
-	}
-	IF_PROFILER(profiler->timer.restart());
-	reCountAllNodes();
-	IF_PROFILER(profiler->recount_time += profiler->timer.elapsed());
-	
+
+	grams_.reserve(size);
+	containers_.reserve(size);
+	LoadDeep<typename Value::Container> load(in);
+	while (size-- > 0)
+		loadGram(in, load);
+	sort();
+
 	return in;
 }
 
 template <typename ThreadPolicy>
 QDataStream& GramHash<ThreadPolicy>::saveDeep(QDataStream& out) const
 {
-	out << (quint32)distinctiveContainers_.size();
-	
-    for (typename Value::const_iterator i =
-		 distinctiveContainers_.constBegin();
-		 i != distinctiveContainers_.constEnd(); i++)
-	{
-		out << i.key();
-		i->saveDeep(out);
+	out << (quint32)grams_.size();
+
+	// Every gram is written like a GramNode holding a single
+	// Container, the layout of the files written before the
+	// table was sorted.
+	for (int i = 0; i < grams_.size(); i++) {
+		out << grams_[i];
+		out << (quint32)1;
+		containers_[i]->saveDeep(out);
 	}
-	
+
 	return out;
 }
 
@@ -442,33 +579,25 @@ void GramHash<ThreadPolicy>::loadShallow(QDataStream& in,
 	quint32 size;
 	in >> size;
 
-	while (size-- > 0) {
-		QString gram;
-		Value node;
-		IF_PROFILER(node.profiler = profiler);
-		in >> gram;
-		
-		node.loadShallow(in, db);
-		
-		IF_PROFILER(profiler->timer.restart());
-		insertNode(gram, node);
-		IF_PROFILER(profiler->insertnode_time += profiler->timer.elapsed());
-	}
-	IF_PROFILER(profiler->timer.restart());
-	reCountAllNodes();
-	IF_PROFILER(profiler->recount_time += profiler->timer.elapsed());
+	grams_.reserve(size);
+	containers_.reserve(size);
+	LoadShallow<typename Value::Container> load(in, db);
+	while (size-- > 0)
+		loadGram(in, load);
+	sort();
 }
 
 template <typename ThreadPolicy>
 void GramHash<ThreadPolicy>::saveShallow(QDataStream& out) const
 {
-	out << (quint32)distinctiveContainers_.size();
-	
-	for (const_iterator i = distinctiveContainers_.constBegin();
-		 i != distinctiveContainers_.constEnd(); i++)
-	{
-		out << i.key();
-		i.value().saveShallow(out);
+	out << (quint32)grams_.size();
+
+	// Same layout as saveDeep(). The slot of a Container is its
+	// position in the table, see containers().
+	for (int i = 0; i < grams_.size(); i++) {
+		out << grams_[i];
+		out << (quint32)1;
+		containers_[i]->saveShallow(out, i);
 	}
 }
 
@@ -476,5 +605,4 @@ void GramHash<ThreadPolicy>::saveShallow(QDataStream& out) const
 
 } // namespace Distiller
 
-#endif 
-
+#endif
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <QAtomicInt>
 #include <QSharedPointer>
 #include <QReadWriteLock>
 
@@ -18,6 +19,8 @@
 #include "BitDistance.h"
 #include "SearchInfo.h"
 #include "KeyDistTuple.h"
+#include "TopKCollector.h"
+#include "BudgetAccount.h"
 
 namespace Distiller
 {
@@ -74,9 +77,10 @@ private:
 
 	/**
 	 * Each KeyList has a unique Id. We use a static counter
-	 * to generate new Ids.
+	 * to generate new Ids. It is atomic, since KeyLists are
+	 * created by background reloads and compactions as well.
 	 */
-	static IdType idCounter_;
+	static QAtomicInt idCounter_;
 	
 	/**
 	 * Since we implement lazy loading all the members
@@ -108,11 +112,24 @@ private:
 	 * The size of the list.
 	 */
 	mutable int size_;
+
+	/**
+	 * Position of the KeyList in the index files it is loaded
+	 * from, see DictionaryDB.
+	 */
+	mutable quint32 slot_;
 	
 	/**
 	 * Loads the KeyList from disc.
 	 */
 	void load() const;
+
+	/**
+	 * Loads the KeyList and locks it for reading. Private::compact()
+	 * may unload it between load() and the lock, so it's loaded
+	 * again until it's loaded while locked.
+	 */
+	void lockLoadedForRead() const;
 	
 public:
 
@@ -125,11 +142,28 @@ public:
 	 * Throws Exception(Exception::OutOfIds) if we're out of Ids.
 	 */
 	static IdType newId();
+
+	/**
+	 * Makes sure newId() never returns id, which has been read
+	 * from disk.
+	 */
+	static void reserveId(IdType id);
 	
 	/**
 	 * Returns the Id of this KeyList.
 	 */
 	IdType id() const;
+
+	/**
+	 * Returns the slot read by loadShallow().
+	 */
+	quint32 slot() const;
+
+	/**
+	 * Sets the slot of the KeyList in new index files, see
+	 * DictionaryDB::replace().
+	 */
+	void setSlot(quint32 slot) const;
 		
 	/**
 	 * Returns true if the KeyList is fully loaded.
@@ -142,16 +176,44 @@ public:
 	 * where the keys refer to.
 	 */
 	KeyDistTuple find(const SearchInfo& searchInfo);
+
+	/**
+	 * Offers every key within the bound of the collector to
+	 * the collector.
+	 */
+	void collect(const SearchInfo& searchInfo, TopKCollector& collector);
 			   
 	/**
 	 * Append a key to the list.
 	 */
 	void append(KeyType v);
+
+	/**
+	 * Append a list of keys to the list.
+	 */
+	void append(const QVector<KeyType>& keys);
+
+	/**
+	 * Removes all occurrences of key from the list.
+	 * Returns true if the key has been found.
+	 */
+	bool remove(KeyType key);
+
+	/**
+	 * Returns a (shallow) copy of the keys.
+	 */
+	QVector<KeyType> keys() const;
 		
 	/**
 	 * Returns the number of keys in the list.
 	 */
 	int size() const;
+
+	/**
+	 * Returns the bytes allocated for the keys, 0 if the
+	 * KeyList isn't loaded.
+	 */
+	quint64 memoryUsage() const;
 		
 	/**
 	 * Saves the whole KeyList in a QDataStream.
@@ -172,22 +234,30 @@ public:
                 { return keyList.loadDeep(in); }
 
 	/**
-	 * Saves just the id and the size to QDataStream.
+	 * Saves just the slot and the size to QDataStream. slot is
+	 * the position of the KeyList in the container file.
 	 */
-	void saveShallow(QDataStream& out) const;
+	void saveShallow(QDataStream& out, quint32 slot) const;
 	
 	/**
-	 * Load just the id and the size from QDataStream.
+	 * Load just the slot and the size from QDataStream.
 	 */
 	void loadShallow(QDataStream& in,
 		AbstractDB<KeyList<ThreadPolicy> >* db);
+
+	/**
+	 * Frees the keys but keeps the id and the size. The keys
+	 * are loaded again from db on the next access, so the KeyList
+	 * must have been saved to db before.
+	 */
+	void unload(AbstractDB<KeyList<ThreadPolicy> >* db) const;
 	
     template<typename>
 	friend class DictionaryDB;
 };
 
 template<typename ThreadPolicy>
-typename KeyList<ThreadPolicy>::IdType KeyList<ThreadPolicy>::idCounter_ = 0;
+QAtomicInt KeyList<ThreadPolicy>::idCounter_(0);
 
 template<typename ThreadPolicy>
 KeyList<ThreadPolicy>::KeyList(bool loaded) : 
@@ -196,7 +266,8 @@ KeyList<ThreadPolicy>::KeyList(bool loaded) :
 	id_(newId()),
 	loaded_(loaded),
 	list_(),
-	size_(0)
+	size_(0),
+	slot_(0)
 { }
 
 template<typename ThreadPolicy>
@@ -205,20 +276,38 @@ KeyList<ThreadPolicy>::KeyList(quint16 id) :
 	db_(0),
 	loaded_(false),
 	list_(),
-	size_(0)
+	size_(0),
+	slot_(0)
 {
-	if (id >= idCounter_)
-		idCounter_ = id;
+	reserveId(id);
 }
 
 template<typename ThreadPolicy>
 typename KeyList<ThreadPolicy>::IdType
 KeyList<ThreadPolicy>::newId()
 {	
-	if (idCounter_ == IDTYPE_MAX)
-		// We're out of IDs.
-		throw Exception(Exception::OutOfIds);
-	return ++idCounter_; 
+	while (true) {
+		int current = idCounter_;
+		if ((IdType)current == IDTYPE_MAX)
+			// We're out of IDs.
+			throw Exception(Exception::OutOfIds);
+		IdType id = (IdType)current + 1;
+		if (idCounter_.testAndSetOrdered(current, (int)id))
+			return id;
+	}
+}
+
+template<typename ThreadPolicy>
+void KeyList<ThreadPolicy>::reserveId(IdType id)
+{
+	while (true) {
+		int current = idCounter_;
+		if ((IdType)current >= id ||
+			idCounter_.testAndSetOrdered(current, (int)id))
+		{
+			return;
+		}
+	}
 }
 
 template<typename ThreadPolicy>
@@ -228,6 +317,18 @@ KeyList<ThreadPolicy>::id() const
 	return id_;
 }
 	
+template<typename ThreadPolicy>
+quint32 KeyList<ThreadPolicy>::slot() const
+{
+	return slot_;
+}
+
+template<typename ThreadPolicy>
+void KeyList<ThreadPolicy>::setSlot(quint32 slot) const
+{
+	slot_ = slot;
+}
+
 template<typename ThreadPolicy>
 bool KeyList<ThreadPolicy>::isLoaded() const
 {
@@ -240,20 +341,73 @@ bool KeyList<ThreadPolicy>::isLoaded() const
 	
 template<typename ThreadPolicy>
 void KeyList<ThreadPolicy>::append(KeyType v)
-{	
+{
+	load();
+    ThreadPolicy::lockForWrite();
 	list_.append(v);
-	size_++; 
+	size_++;
+    ThreadPolicy::unlock();
 }
-	
+
+template<typename ThreadPolicy>
+void KeyList<ThreadPolicy>::append(const QVector<KeyType>& keys)
+{
+	load();
+    ThreadPolicy::lockForWrite();
+	list_ += keys;
+	size_ += keys.size();
+    ThreadPolicy::unlock();
+}
+
+template<typename ThreadPolicy>
+bool KeyList<ThreadPolicy>::remove(KeyType key)
+{
+	load();
+    ThreadPolicy::lockForWrite();
+	int j = 0;
+	for (int i = 0; i < list_.size(); i++) {
+		if (list_[i] != key)
+			list_[j++] = list_[i];
+	}
+	bool rv = (j < list_.size());
+	if (rv) {
+		list_.resize(j);
+		size_ = j;
+	}
+    ThreadPolicy::unlock();
+	return rv;
+}
+
+template<typename ThreadPolicy>
+QVector<KeyType> KeyList<ThreadPolicy>::keys() const
+{
+	lockLoadedForRead();
+	QVector<KeyType> rv = list_;
+    ThreadPolicy::unlock();
+	return rv;
+}
+
 template<typename ThreadPolicy>
 int KeyList<ThreadPolicy>::size() const
 {
 	return (isLoaded())? list_.size() : size_;
 }
 	
+template<typename ThreadPolicy>
+quint64 KeyList<ThreadPolicy>::memoryUsage() const
+{
+    ThreadPolicy::lockForRead();
+	quint64 rv = (list_.capacity() > 0)?
+		sizeof(QVectorData) + list_.capacity() * sizeof(KeyType) : 0;
+    ThreadPolicy::unlock();
+	return rv;
+}
+	
 template<typename ThreadPolicy>
 QDataStream& KeyList<ThreadPolicy>::saveDeep(QDataStream& out) const
 {
+	// A Container which hasn't been accessed yet is still on disk.
+	load();
 	out << id_;
 	out << (quint32)list_.size();
 	out << list_;
@@ -267,6 +421,7 @@ template<typename ThreadPolicy>
 QDataStream& KeyList<ThreadPolicy>::loadDeep(QDataStream& in) const
 {
 	in >> id_;
+	reserveId(id_);
 	quint32 size;
 	in >> size;
 	size_ = size;
@@ -276,9 +431,9 @@ QDataStream& KeyList<ThreadPolicy>::loadDeep(QDataStream& in) const
 }
 
 template<typename ThreadPolicy>
-void KeyList<ThreadPolicy>::saveShallow(QDataStream& out) const
+void KeyList<ThreadPolicy>::saveShallow(QDataStream& out, quint32 slot) const
 {
-	out << (quint32)id_;
+	out << slot;
 	out << (quint32)size_;
 }
 
@@ -287,37 +442,73 @@ void KeyList<ThreadPolicy>::loadShallow(QDataStream& in,
 	AbstractDB<KeyList<ThreadPolicy> >* db)
 {
 	Q_ASSERT(db != 0);
-	quint32 id;
 	quint32 size;
-	in >> id;
+	in >> slot_;
 	in >> size;
-    id_ = (typename KeyList::IdType)id;
 	size_ = size;
 	loaded_ = false;
 	db_ = db;
 }
 
+template<typename ThreadPolicy>
+void KeyList<ThreadPolicy>::unload(AbstractDB<KeyList<ThreadPolicy> >* db) const
+{
+    ThreadPolicy::lockForWrite();
+	size_ = list_.size();
+	list_ = QVector<KeyType>();
+	loaded_ = false;
+	db_ = db;
+    ThreadPolicy::unlock();
+}
+
 template<typename ThreadPolicy>
 void KeyList<ThreadPolicy>::load() const
 {
 	if (isLoaded() == true) return;
     ThreadPolicy::lockForWrite();
+	if (loaded_) {
+		// Loaded by another thread meanwhile.
+		ThreadPolicy::unlock();
+		return;
+	}
 	Q_ASSERT(db_ != 0);
-	db_->load(this);
+	try {
+		db_->load(this);
+	}
+	catch (...) {
+		ThreadPolicy::unlock();
+		throw;
+	}
 	loaded_ = true;
     ThreadPolicy::unlock();
 }
 
+template<typename ThreadPolicy>
+void KeyList<ThreadPolicy>::lockLoadedForRead() const
+{
+	for (;;) {
+		load();
+		ThreadPolicy::lockForRead();
+		if (loaded_)
+			return;
+		ThreadPolicy::unlock();
+	}
+}
+
 template<typename ThreadPolicy>
 KeyDistTuple KeyList<ThreadPolicy>::find(const SearchInfo& searchInfo)
 {
-	load();
-    ThreadPolicy::lockForRead();
+	searchInfo.countContainer(isLoaded());
+	lockLoadedForRead();
 
+	BudgetAccount* account = searchInfo.account();
 	KeyDistTuple rv;	
 	for (const_iterator i = list_.constBegin(); 
 		 i != list_.constEnd(); i++)
 	{
+		if (account != 0 && account->charge() == false)
+			// Out of budget, return the best match so far.
+			break;
 		KeyType key = *i;
 		DistType dist = searchInfo.calcDistance(key);
 		if (dist < rv.distance())
@@ -329,6 +520,29 @@ KeyDistTuple KeyList<ThreadPolicy>::find(const SearchInfo& searchInfo)
 	return rv;
 }
 
+template<typename ThreadPolicy>
+void KeyList<ThreadPolicy>::collect(const SearchInfo& searchInfo,
+									TopKCollector& collector)
+{
+	searchInfo.countContainer(isLoaded());
+	lockLoadedForRead();
+
+	BudgetAccount* account = searchInfo.account();
+	for (const_iterator i = list_.constBegin(); 
+		 i != list_.constEnd(); i++)
+	{
+		if (collector.isComplete())
+			break;
+		if (account != 0 && account->charge() == false)
+			break;
+		KeyType key = *i;
+		DistType dist = searchInfo.calcDistance(key, collector.bound());
+		if (dist != KeyDistTuple::invalidDistance)
+			collector.offer(key, dist);
+	}
+    ThreadPolicy::unlock();
+}
+
 } // namespace DictionaryImpl
 
 } // namespace Distiller
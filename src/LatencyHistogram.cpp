@@ -0,0 +1,107 @@
+#include <core/precompiled.h>
+
+#include "LatencyHistogram.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+LatencyHistogram::LatencyHistogram()
+{
+	reset();
+}
+
+int LatencyHistogram::bucket(qint64 nsecs)
+{
+	if (nsecs < 0)
+		nsecs = 0;
+	quint64 value = qMin<quint64>(nsecs, (Q_UINT64_C(1) << maxBits_) - 1);
+	if (value < (quint64)(1 << subBucketBits_))
+		return (int)value;
+	// Position of the highest set bit.
+	int highest = 0;
+	while ((value >> highest) > 1)
+		highest++;
+	// value >> shift is in [subBucketHalf_, 2 * subBucketHalf_).
+	int shift = highest - (subBucketBits_ - 1);
+	return shift * subBucketHalf_ + (int)(value >> shift);
+}
+
+qint64 LatencyHistogram::highestValue(int bucket)
+{
+	if (bucket < (1 << subBucketBits_))
+		return bucket;
+	int shift = bucket / subBucketHalf_ - 1;
+	qint64 sub = bucket - shift * subBucketHalf_;
+	return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+	for (int i = 0; i < bucketCount_; i++) {
+		int count = other.counts_[i];
+		if (count != 0)
+			counts_[i].fetchAndAddRelaxed(count);
+	}
+}
+
+void LatencyHistogram::reset()
+{
+	for (int i = 0; i < bucketCount_; i++)
+		counts_[i] = 0;
+}
+
+quint64 LatencyHistogram::count() const
+{
+	quint64 rv = 0;
+	for (int i = 0; i < bucketCount_; i++)
+		rv += (uint)static_cast<int>(counts_[i]);
+	return rv;
+}
+
+qint64 LatencyHistogram::percentile(double fraction) const
+{
+	quint64 total = count();
+	if (total == 0)
+		return 0;
+	fraction = qBound(0.0, fraction, 1.0);
+	quint64 rank = qMax<quint64>(1, (quint64)(fraction * total + 0.5));
+	quint64 seen = 0;
+	for (int i = 0; i < bucketCount_; i++) {
+		seen += (uint)static_cast<int>(counts_[i]);
+		if (seen >= rank)
+			return highestValue(i);
+	}
+	return max();
+}
+
+qint64 LatencyHistogram::max() const
+{
+	for (int i = bucketCount_ - 1; i >= 0; i--) {
+		if (static_cast<int>(counts_[i]) != 0)
+			return highestValue(i);
+	}
+	return 0;
+}
+
+double LatencyHistogram::mean() const
+{
+	quint64 total = 0;
+	double sum = 0;
+	for (int i = 0; i < bucketCount_; i++) {
+		uint count = static_cast<int>(counts_[i]);
+		if (count == 0)
+			continue;
+		// Middle of the bucket.
+		qint64 low = (i == 0)? 0 : highestValue(i - 1) + 1;
+		sum += count * (low + highestValue(i)) / 2.0;
+		total += count;
+	}
+	return (total > 0)? sum / total : 0;
+}
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
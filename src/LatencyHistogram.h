@@ -0,0 +1,91 @@
+#ifndef DISTILLER_DICTIONARYIMPL_LATENCYHISTOGRAM_H
+#define DISTILLER_DICTIONARYIMPL_LATENCYHISTOGRAM_H
+
+#pragma once
+
+#include <QAtomicInt>
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+/**
+ * Histogram of durations in nanoseconds with a bounded relative
+ * error, like an HDR histogram.
+ *
+ * Durations below 32 ns have a bucket each. Above, every power of
+ * two is split into 16 buckets, so a bucket covers at most 1/16 of
+ * its values and percentile() is at most 6.25% too large. Durations
+ * of more than 2^44 ns (about 4.9 hours) are counted as 2^44 ns.
+ *
+ * The counts are atomic: record() and merge() may be called while
+ * other threads read the histogram. LatencyRecorder stripes the
+ * histograms over the threads, so record() is rarely contended.
+ */
+class LatencyHistogram
+{
+
+	static const int subBucketBits_ = 5;
+
+	static const int subBucketHalf_ = 1 << (subBucketBits_ - 1);
+
+	static const int maxBits_ = 44;
+
+	static const int bucketCount_ =
+		(maxBits_ - subBucketBits_ + 2) * subBucketHalf_;
+
+	QAtomicInt counts_[bucketCount_];
+
+	static int bucket(qint64 nsecs);
+
+	/// Largest duration counted in bucket.
+	static qint64 highestValue(int bucket);
+
+public:
+
+	LatencyHistogram();
+
+	void record(qint64 nsecs)
+		{ counts_[bucket(nsecs)].ref(); }
+
+	/**
+	 * Adds the counts of other.
+	 */
+	void merge(const LatencyHistogram& other);
+
+	void reset();
+
+	/// Number of recorded durations.
+	quint64 count() const;
+
+	/**
+	 * Returns the duration (in ns) which isn't exceeded by the
+	 * given fraction (0 to 1) of the recorded durations, 0 if
+	 * nothing has been recorded.
+	 */
+	qint64 percentile(double fraction) const;
+
+	qint64 p50() const
+		{ return percentile(0.5); }
+
+	qint64 p99() const
+		{ return percentile(0.99); }
+
+	qint64 p999() const
+		{ return percentile(0.999); }
+
+	/// Largest recorded duration, within the precision.
+	qint64 max() const;
+
+	/// Mean duration, computed from the buckets.
+	double mean() const;
+
+};
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
+
+#endif 
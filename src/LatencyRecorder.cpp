@@ -0,0 +1,81 @@
+#include <core/precompiled.h>
+
+#include <QThreadStorage>
+
+#include "LatencyRecorder.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+/// The stripe of every thread which has recorded a duration.
+static QThreadStorage<int*> threadStripe;
+
+static QAtomicInt nextStripe(0);
+
+LatencyRecorder::LatencyRecorder(int n) :
+	size_(n)
+{
+	for (int i = 0; i < stripeCount_; i++)
+		stripes_[i] = 0;
+}
+
+LatencyRecorder::~LatencyRecorder()
+{
+	for (int i = 0; i < stripeCount_; i++)
+		delete[] static_cast<LatencyHistogram*>(stripes_[i]);
+}
+
+int LatencyRecorder::stripe()
+{
+	if (threadStripe.hasLocalData() == false)
+		threadStripe.setLocalData(
+			new int(nextStripe.fetchAndAddRelaxed(1) % stripeCount_));
+	return *threadStripe.localData();
+}
+
+LatencyHistogram* LatencyRecorder::local()
+{
+	QAtomicPointer<LatencyHistogram>& p = stripes_[stripe()];
+	LatencyHistogram* rv = p;
+	if (rv == 0) {
+		// Another thread of the stripe may be faster.
+		LatencyHistogram* histograms = new LatencyHistogram[size_];
+		if (p.testAndSetOrdered(0, histograms))
+			rv = histograms;
+		else {
+			delete[] histograms;
+			rv = p;
+		}
+	}
+	return rv;
+}
+
+LatencyHistogram LatencyRecorder::histogram(int i) const
+{
+	Q_ASSERT(i >= 0 && i < size_);
+	LatencyHistogram rv;
+	for (int stripe = 0; stripe < stripeCount_; stripe++) {
+		const LatencyHistogram* histograms = stripes_[stripe];
+		if (histograms)
+			rv.merge(histograms[i]);
+	}
+	return rv;
+}
+
+void LatencyRecorder::reset()
+{
+	for (int stripe = 0; stripe < stripeCount_; stripe++) {
+		LatencyHistogram* histograms = stripes_[stripe];
+		if (histograms) {
+			for (int i = 0; i < size_; i++)
+				histograms[i].reset();
+		}
+	}
+}
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
@@ -0,0 +1,74 @@
+#ifndef DISTILLER_DICTIONARYIMPL_LATENCYRECORDER_H
+#define DISTILLER_DICTIONARYIMPL_LATENCYRECORDER_H
+
+#pragma once
+
+#include <QAtomicPointer>
+
+#include "LatencyHistogram.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+/**
+ * Records durations into a fixed number of LatencyHistograms
+ * without locking.
+ *
+ * The histograms are striped: every thread records into one of
+ * stripeCount_ sets of histograms, picked round robin when the
+ * thread records for the first time. So concurrent threads rarely
+ * share a set. histogram() merges the sets on demand.
+ *
+ * The sets are allocated on first use and owned by the recorder.
+ * Only the stripe index is kept per thread, so the recorders of
+ * replaced dictionary snapshots leave nothing behind.
+ */
+class LatencyRecorder
+{
+
+	static const int stripeCount_ = 8;
+
+	int size_;
+
+	/// Sets of size_ histograms, 0 until a thread records into it.
+	mutable QAtomicPointer<LatencyHistogram> stripes_[stripeCount_];
+
+	/// The stripe of the calling thread, the same for all recorders.
+	static int stripe();
+
+	LatencyHistogram* local();
+
+	Q_DISABLE_COPY(LatencyRecorder)
+
+public:
+
+	/**
+	 * Creates a recorder of n histograms.
+	 */
+	LatencyRecorder(int n);
+
+	~LatencyRecorder();
+
+	/**
+	 * Records a duration in histogram i.
+	 */
+	void record(int i, qint64 nsecs)
+		{ local()[i].record(nsecs); }
+
+	/**
+	 * Returns histogram i merged over all threads.
+	 */
+	LatencyHistogram histogram(int i) const;
+
+	void reset();
+
+};
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
+
+#endif 
@@ -0,0 +1,21 @@
+#include <core/precompiled.h>
+
+#include "Match.h"
+
+namespace Distiller
+{
+
+Dictionary::Match::Match() :
+	key(0),
+	distance(0),
+	entry()
+{ }
+
+Dictionary::Match::Match(quint32 aKey, uint aDistance,
+						 const QString& anEntry) :
+	key(aKey),
+	distance(aDistance),
+	entry(anEntry)
+{ }
+
+} // namespace Distiller
@@ -0,0 +1,35 @@
+#ifndef DISTILLER_DICTIONARYIMPL_MATCH_H
+#define DISTILLER_DICTIONARYIMPL_MATCH_H
+
+#pragma once
+
+#include "Dictionary.h"
+
+namespace Distiller
+{
+
+/**
+ * A dictionary entry found by a query.
+ */
+class Dictionary::Match
+{
+
+public:
+
+	/// The key of the entry, unique within the dictionary.
+	quint32 key;
+
+	/// The edit distance between the query and the entry.
+	uint distance;
+
+	QString entry;
+
+	Match();
+
+	Match(quint32 aKey, uint aDistance, const QString& anEntry);
+
+};
+
+} // namespace Distiller
+
+#endif 
@@ -0,0 +1,34 @@
+#include <core/precompiled.h>
+
+#include "MemoryUsage.h"
+
+namespace Distiller
+{
+
+Dictionary::MemoryUsage::MemoryUsage() :
+	entries(0),
+	encodedEntries(0),
+	bitpatterns(0),
+	histograms(0),
+	gramHash(0),
+	containers(0),
+	postings(0),
+	controlBlocks(0),
+	removed(0),
+	prefixIndex(0),
+	weights(0),
+	resultCache(0),
+	deltaLog(0),
+	database(0),
+	loadedContainers(0),
+	unloadedContainers(0)
+{ }
+
+quint64 Dictionary::MemoryUsage::total() const
+{
+	return entries + encodedEntries + bitpatterns + histograms +
+		gramHash + containers + postings + controlBlocks + removed +
+		prefixIndex + weights + resultCache + deltaLog + database;
+}
+
+} // namespace Distiller
@@ -0,0 +1,98 @@
+#ifndef DISTILLER_DICTIONARYIMPL_MEMORYUSAGE_H
+#define DISTILLER_DICTIONARYIMPL_MEMORYUSAGE_H
+
+#pragma once
+
+#include "Dictionary.h"
+
+namespace Distiller
+{
+
+/**
+ * Bytes used by the parts of a loaded dictionary, see
+ * Dictionary::memoryUsage().
+ *
+ * The sizes of the arrays are exact (allocated, not used
+ * capacity). The overhead of Qt's containers and of the heap is
+ * estimated from the sizes of their nodes and headers, so the
+ * figures are good for capacity planning and for comparing
+ * versions, not for accounting every byte.
+ *
+ * Not counted are the search strategies with the state of the
+ * running queries, the slow query log and the statistics, which
+ * are small and don't grow with the dictionary.
+ */
+class Dictionary::MemoryUsage
+{
+
+public:
+
+	/// The dictionary entries (StringArray).
+	quint64 entries;
+
+	/// The encoded entries (StringArray).
+	quint64 encodedEntries;
+
+	/// The bit patterns of the encoded entries.
+	quint64 bitpatterns;
+
+	/// The character histograms of the encoded entries.
+	quint64 histograms;
+
+	/// The sorted gram table: the grams and their Container pointers.
+	quint64 gramHash;
+
+	/// The Container objects themselves.
+	quint64 containers;
+
+	/// The keys of the loaded Containers.
+	quint64 postings;
+
+	/// Reference counts of the shared pointers to the Containers.
+	quint64 controlBlocks;
+
+	/// The set of removed entries.
+	quint64 removed;
+
+	/// The entries sorted for complete(), once it has been built.
+	quint64 prefixIndex;
+
+	/// The weights of the entries for complete().
+	quint64 weights;
+
+	/// The cached query results.
+	quint64 resultCache;
+
+	/// The buffers of the delta log while it's open.
+	quint64 deltaLog;
+
+	/**
+	 * The positions of the Containers in the container file and the
+	 * buffers of the open index files.
+	 */
+	quint64 database;
+
+	/// Number of Containers in memory.
+	quint32 loadedContainers;
+
+	/// Number of Containers which are still on disk.
+	quint32 unloadedContainers;
+
+	/**
+	 * Estimated buffers of an open file: QFile allocates a read
+	 * and a write buffer of 16 KiB each.
+	 */
+	static const quint64 fileBuffers = 2 * 16384;
+
+	MemoryUsage();
+
+	/**
+	 * Sum of all byte counts above.
+	 */
+	quint64 total() const;
+
+};
+
+} // namespace Distiller
+
+#endif 
@@ -0,0 +1,159 @@
+#include <core/precompiled.h>
+
+#include <algorithm>
+
+#include <tagdistiller/StringArray.h>
+
+#include "DictionaryDefines.h"
+#include "Private.h"
+#include "PrefixIndex.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+/**
+ * Compares two strings character by character. Returns a value
+ * less than, equal to or greater than 0 like QString::compare().
+ */
+static int compare(const QChar* lhs, int lhsSize,
+				   const QChar* rhs, int rhsSize)
+{
+	int size = qMin(lhsSize, rhsSize);
+	for (int i = 0; i < size; i++) {
+		if (lhs[i] != rhs[i])
+			return (lhs[i].unicode() < rhs[i].unicode())? -1 : 1;
+	}
+	return lhsSize - rhsSize;
+}
+
+/**
+ * Orders keys by their encoded entries.
+ */
+class EncodedEntryLess
+{
+
+	const StringArray& entries_;
+
+public:
+
+	EncodedEntryLess(const StringArray& entries) : entries_(entries)
+		{ }
+
+	bool operator() (KeyType lhs, KeyType rhs) const
+	{
+		int rv = compare(entries_.unicode(lhs), entries_.sizeOf(lhs),
+						 entries_.unicode(rhs), entries_.sizeOf(rhs));
+		if (rv != 0)
+			return rv < 0;
+		return lhs < rhs;
+	}
+
+};
+
+PrefixIndex::PrefixIndex() :
+	keys_(),
+	valid_(false),
+	mutex_()
+{ }
+
+PrefixIndex::~PrefixIndex()
+{ }
+
+void PrefixIndex::invalidate()
+{
+	QMutexLocker locker(&mutex_);
+	keys_.clear();
+	valid_ = false;
+}
+
+quint64 PrefixIndex::memoryUsage() const
+{
+	QMutexLocker locker(&mutex_);
+	return (keys_.capacity() > 0)?
+		sizeof(QVectorData) + keys_.capacity() * sizeof(KeyType) : 0;
+}
+
+void PrefixIndex::build(const Private& d)
+{
+	// Removed entries are still in the string arrays.
+	const QBitArray& removed = d.removed_;
+	int size = d.encodedEntries_.size();
+	keys_.clear();
+	keys_.reserve(size - removed.count(true));
+	for (int key = 0; key < size; key++) {
+		if (key >= removed.size() || removed.testBit(key) == false)
+			keys_.append(key);
+	}
+	std::sort(keys_.begin(), keys_.end(),
+		EncodedEntryLess(d.encodedEntries_));
+	valid_ = true;
+}
+
+void PrefixIndex::insert(const Private& d, KeyType key)
+{
+	QMutexLocker locker(&mutex_);
+	if (valid_ == false)
+		return;
+	QVector<KeyType>::iterator i = std::lower_bound(keys_.begin(),
+		keys_.end(), key, EncodedEntryLess(d.encodedEntries_));
+	keys_.insert(i, key);
+}
+
+void PrefixIndex::remove(const Private& d, KeyType key)
+{
+	QMutexLocker locker(&mutex_);
+	if (valid_ == false)
+		return;
+	QVector<KeyType>::iterator i = std::lower_bound(keys_.begin(),
+		keys_.end(), key, EncodedEntryLess(d.encodedEntries_));
+	if (i != keys_.end() && *i == key)
+		keys_.erase(i);
+}
+
+void PrefixIndex::range(const Private& d, const QString& encodedPrefix,
+						int& begin, int& end)
+{
+	QMutexLocker locker(&mutex_);
+	if (valid_ == false)
+		build(d);
+	locker.unlock();
+
+	const StringArray& entries = d.encodedEntries_;
+	const QChar* prefix = encodedPrefix.unicode();
+	int prefixSize = encodedPrefix.size();
+
+	// First entry not less than the prefix.
+	int low = 0;
+	int high = keys_.size();
+	while (low < high) {
+		int mid = low + (high - low) / 2;
+		KeyType key = keys_[mid];
+		if (compare(entries.unicode(key), entries.sizeOf(key),
+					prefix, prefixSize) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	begin = low;
+
+	// First entry behind the ones starting with the prefix.
+	high = keys_.size();
+	while (low < high) {
+		int mid = low + (high - low) / 2;
+		KeyType key = keys_[mid];
+		if (compare(entries.unicode(key),
+					qMin(entries.sizeOf(key), prefixSize),
+					prefix, prefixSize) <= 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	end = low;
+}
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
@@ -0,0 +1,103 @@
+#ifndef DISTILLER_DICTIONARYIMPL_PREFIXINDEX_H
+#define DISTILLER_DICTIONARYIMPL_PREFIXINDEX_H
+
+#pragma once
+
+#include <QMutex>
+#include <QVector>
+#include <QString>
+
+#include "KeyDistTuple.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+class Private;
+
+/**
+ * The keys of all entries sorted by their encoded form.
+ *
+ * The entries starting with a given prefix are a contiguous range
+ * of the index, which is found by two binary searches. The gram
+ * index can't answer such queries for prefixes shorter than
+ * minGramSize() and doesn't know where a gram occurs in an entry.
+ *
+ * The index is built on first use from the entry arrays and kept
+ * up to date by insert() and remove(). invalidate() drops it when
+ * all entries are replaced.
+ */
+class PrefixIndex
+{
+
+	/// Keys of the entries, sorted by encoded entry.
+	QVector<KeyType> keys_;
+
+	bool valid_;
+
+	/// Serializes building the index by concurrent queries.
+	mutable QMutex mutex_;
+
+	void build(const Private& d);
+
+public:
+
+	PrefixIndex();
+
+	~PrefixIndex();
+
+	/**
+	 * Drops the index.
+	 *
+	 * \note The caller has to hold Private::lock_ for writing.
+	 */
+	void invalidate();
+
+	/**
+	 * Adds the key of a new entry at its position. Does nothing
+	 * if the index hasn't been built yet.
+	 *
+	 * \note The caller has to hold Private::lock_ for writing.
+	 */
+	void insert(const Private& d, KeyType key);
+
+	/**
+	 * Removes the key of a removed entry. Does nothing if the
+	 * index hasn't been built yet.
+	 *
+	 * \note The caller has to hold Private::lock_ for writing.
+	 */
+	void remove(const Private& d, KeyType key);
+
+	/**
+	 * Finds the entries whose encoded form starts with
+	 * encodedPrefix. They are at the positions [begin, end).
+	 * An empty prefix returns all entries. Builds the index if
+	 * necessary.
+	 *
+	 * \note The caller has to hold Private::lock_. The positions
+	 * are valid as long as the lock is held.
+	 */
+	void range(const Private& d, const QString& encodedPrefix,
+			   int& begin, int& end);
+
+	/**
+	 * Bytes used by the index, 0 if it hasn't been built.
+	 */
+	quint64 memoryUsage() const;
+
+	/**
+	 * The key at a position returned by range().
+	 */
+	inline KeyType at(int pos) const
+		{ return keys_[pos]; }
+
+};
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
+
+#endif 
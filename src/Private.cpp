@@ -1,5 +1,14 @@
 #include <core/precompiled.h>
 
+#include <algorithm>
+
+#include <QElapsedTimer>
+#include <QThreadStorage>
+
+#ifdef __SSE2__
+#	include <emmintrin.h>
+#endif
+
 #include <tagdistiller/EditDistance.h>
 #include <tagdistiller/SimpleString.h>
 
@@ -9,6 +18,17 @@
 #include "ThreadedSearchStrategy.h"
 #include "SimpleSearchStrategy.h"
 #include "DebugInfo.h"
+#include "DictException.h"
+#include "KeyDistTuple.h"
+#include "CompactionThread.h"
+#include "Match.h"
+#include "QueryOptions.h"
+#include "QueryStats.h"
+#include "SlowQuery.h"
+#include "QueryTrace.h"
+#include "AbstractMatchHandler.h"
+#include "PrefixIndex.h"
+#include "AbstractNormalizer.h"
 #include "Private.h"
 
 namespace Distiller
@@ -17,9 +37,123 @@ namespace Distiller
 namespace DictionaryImpl
 {
 
+/**
+ * Holds a search strategy of a dictionary for one query and
+ * hands it back when destroyed.
+ */
+class SearchStrategyLease
+{
+
+	const Private& d_;
+
+	AbstractSearchStrategy* strategy_;
+
+public:
+
+	SearchStrategyLease(const Private& d) :
+		d_(d),
+		strategy_(d.acquireStrategy())
+		{ }
+
+	~SearchStrategyLease()
+	{
+		d_.releaseStrategy(strategy_);
+	}
+
+	AbstractSearchStrategy* operator->() const
+	{
+		return strategy_;
+	}
+
+};
+
+class MatchHandlerScope;
+
+/**
+ * The innermost findWithin() running in the calling thread, if
+ * any. Its handler may run findWithin() of another dictionary.
+ */
+static QThreadStorage<MatchHandlerScope**> innermostScope;
+
+/**
+ * Marks the calling thread as running a findWithin() handler
+ * of a dictionary while it exists.
+ */
+class MatchHandlerScope
+{
+
+	const Private* d_;
+
+	MatchHandlerScope* outer_;
+
+public:
+
+	MatchHandlerScope(const Private* d) :
+		d_(d),
+		outer_(0)
+	{
+		if (innermostScope.hasLocalData() == false)
+			innermostScope.setLocalData(new MatchHandlerScope*(0));
+		outer_ = *innermostScope.localData();
+		*innermostScope.localData() = this;
+	}
+
+	~MatchHandlerScope()
+	{
+		*innermostScope.localData() = outer_;
+	}
+
+	/**
+	 * Returns true if the calling thread runs a findWithin()
+	 * handler of d, and thus holds the read lock of d.
+	 */
+	static bool isRunning(const Private* d)
+	{
+		if (innermostScope.hasLocalData() == false)
+			return false;
+		for (const MatchHandlerScope* scope = *innermostScope.localData();
+			 scope != 0; scope = scope->outer_)
+		{
+			if (scope->d_ == d)
+				return true;
+		}
+		return false;
+	}
+
+};
+
+/**
+ * Locks Private::lock_ for reading for a query. A findWithin()
+ * handler which queries its own dictionary holds the lock already,
+ * and locking it again would deadlock against a waiting writer, so
+ * the lock is only taken if the thread doesn't hold it.
+ */
+class QueryLocker
+{
+
+	QReadWriteLock* lock_;
+
+public:
+
+	QueryLocker(const Private* d, QReadWriteLock* lock) :
+		lock_(MatchHandlerScope::isRunning(d)? 0 : lock)
+	{
+		if (lock_)
+			lock_->lockForRead();
+	}
+
+	~QueryLocker()
+	{
+		if (lock_)
+			lock_->unlock();
+	}
+
+};
+
 Private::Private(quint32 gramSize) : 
 	db_(0),
-	searchStrategy_(0),
+	idleStrategies_(),
+	strategiesLock_(),
 #ifdef DICTIONARY_WITH_PROFILER
 	profiler(),
 #endif
@@ -27,14 +161,28 @@ Private::Private(quint32 gramSize) :
 	gramSize_(gramSize),
 	encodedEntries_(),
 	entries_(),
-	gramHash_(gramSize)
+	removed_(),
+	gramHash_(gramSize),
+	deltaLog_(),
+	compactionThread_(0),
+	compactionThreshold_(0),
+	suspendedFilename_(),
+	suspendedLog_(false),
+	resultCache_(),
+	prefixIndex_(),
+	weights_(),
+	searchStats_(),
+	searchStatsLock_(),
+	normalizer_(0)
 {
 	db_ = new DB;
 	try {
-		searchStrategy_ = new SearchStrategy(*this);
+		idleStrategies_.append(new SearchStrategy(*this));
+		compactionThread_ = new CompactionThread(*this);
 	}
 	catch (...)
 	{
+		qDeleteAll(idleStrategies_);
 		delete db_;
 		throw;
 	}
@@ -43,49 +191,878 @@ Private::Private(quint32 gramSize) :
 
 Private::~Private() 
 {
+	compactionThread_->wait();
+	delete compactionThread_;
+	qDeleteAll(idleStrategies_);
 	delete db_;
 }
 
-QString Private::encode(const QString& text) const
+/**
+ * Encoded form of the ASCII characters, 0 if a character is
+ * dropped. Same as QChar::toLower() for letters, digits and
+ * spaces (QChar::isSpace()).
+ */
+static const ushort asciiEncoding[128] = {
+	0,   0,   0,   0,   0,   0,   0,   0,   0,   '\t','\n','\v','\f','\r',0,   0,
+	0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	' ', 0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 0,   0,   0,   0,   0,   0,
+	0,   'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+	'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', 0,   0,   0,   0,   0,
+	0,   'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+	'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', 0,   0,   0,   0,   0
+};
+
+/**
+ * Writes the encoded form of a character to dst and advances dst.
+ * A character is encoded into at most one character.
+ */
+static inline void encodeChar(ushort uc, QChar*& dst)
+{
+	if (uc < 0x80) {
+		if (asciiEncoding[uc] != 0)
+			*dst++ = QChar(asciiEncoding[uc]);
+		return;
+	}
+	QChar ch(uc);
+	if (ch.isLetterOrNumber() || ch.isSpace())
+		*dst++ = ch.toLower();
+}
+
+#ifdef __SSE2__
+/**
+ * Encodes 8 characters at once if all of them are ASCII letters,
+ * digits or ' ', which is the common case. Returns false if the
+ * characters have to be encoded one by one.
+ */
+static inline bool encodeBlock(const QChar* src, QChar*& dst)
+{
+	__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+	// Characters above 0x7FFF are negative and fail every range.
+	__m128i upper = _mm_and_si128(
+		_mm_cmpgt_epi16(v, _mm_set1_epi16('A' - 1)),
+		_mm_cmplt_epi16(v, _mm_set1_epi16('Z' + 1)));
+	__m128i lower = _mm_and_si128(
+		_mm_cmpgt_epi16(v, _mm_set1_epi16('a' - 1)),
+		_mm_cmplt_epi16(v, _mm_set1_epi16('z' + 1)));
+	__m128i digit = _mm_and_si128(
+		_mm_cmpgt_epi16(v, _mm_set1_epi16('0' - 1)),
+		_mm_cmplt_epi16(v, _mm_set1_epi16('9' + 1)));
+	__m128i space = _mm_cmpeq_epi16(v, _mm_set1_epi16(' '));
+	__m128i keep = _mm_or_si128(_mm_or_si128(upper, lower),
+								_mm_or_si128(digit, space));
+	if (_mm_movemask_epi8(keep) != 0xFFFF)
+		return false;
+	v = _mm_add_epi16(v, _mm_and_si128(upper, _mm_set1_epi16(0x20)));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v);
+	dst += 8;
+	return true;
+}
+#endif
+
+QString Private::encode(const QString& aText) const
+{
+	QString text = normalizer_? normalizer_->normalize(aText) : aText;
+	int size = text.size();
+	// The encoded text is never longer.
+	QString rv(size, Qt::Uninitialized);
+	const QChar* src = text.unicode();
+	QChar* dst = rv.data();
+	int i = 0;
+#ifdef __SSE2__
+	for (; i + 8 <= size; i += 8) {
+		if (encodeBlock(src + i, dst) == false) {
+			for (int j = i; j < i + 8; j++)
+				encodeChar(src[j].unicode(), dst);
+		}
+	}
+#endif
+	for (; i < size; i++)
+		encodeChar(src[i].unicode(), dst);
+	rv.resize(dst - rv.constData());
+	return rv;
+}
+
+QString Private::encode(const char* utf8, int size) const
 {
-	QString rv;
-	for (int i = 0; i < text.size(); i++) {
-		QChar ch = text[i];
-		if (ch.isLetterOrNumber() || ch.isSpace())
-			rv += ch.toLower();
+	if (normalizer_)
+		// The normalizer works on QStrings.
+		return encode(QString::fromUtf8(utf8, size));
+
+	// Every byte yields at most one character.
+	QString rv(size, Qt::Uninitialized);
+	QChar* dst = rv.data();
+	const uchar* pc = reinterpret_cast<const uchar*>(utf8);
+	const uchar* end = pc + size;
+	while (pc < end) {
+		uint uc = *pc++;
+		if (uc < 0x80) {
+			if (asciiEncoding[uc] != 0)
+				*dst++ = QChar(asciiEncoding[uc]);
+			continue;
+		}
+		int following = 0;
+		if ((uc & 0xE0) == 0xC0) {
+			uc &= 0x1F;
+			following = 1;
+		}
+		else if ((uc & 0xF0) == 0xE0) {
+			uc &= 0x0F;
+			following = 2;
+		}
+		else if ((uc & 0xF8) == 0xF0) {
+			uc &= 0x07;
+			following = 3;
+		}
+		else
+			// Not the start of a character.
+			continue;
+		while (following > 0 && pc < end && (*pc & 0xC0) == 0x80) {
+			uc = (uc << 6) | (*pc++ & 0x3F);
+			following--;
+		}
+		// Characters outside the BMP are surrogate pairs in a
+		// QString, which encode(QString) drops as well.
+		if (following == 0 && uc <= 0xFFFF)
+			encodeChar(uc, dst);
+	}
+	rv.resize(dst - rv.constData());
+	return rv;
+}
+
+QStringList Private::grams(const QString& encodedEntry) const
+{
+	QStringList rv;
+	quint32 size = encodedEntry.size();
+	if (size < minGramSize())
+		// Too small for our dictionary.
+		return rv;
+	if (size <= gramSize()) {
+		// Take the whole encoded entry as a gram.
+		rv.append(encodedEntry);
+		return rv;
 	}
+	// Build all n-grams.
+	for (quint32 i = 0; i < size - minGramSize() + 1; i++)
+		rv.append(encodedEntry.mid(i, gramSize()));
 	return rv;
 }
 
 uint Private::calcMaxTypos(const QString &text) const
 {
-	QString encText = encode(text);
+	return calcMaxTypos(text, Dictionary::QueryOptions());
+}
+
+uint Private::calcMaxTypos(const QString& text,
+						   const Dictionary::QueryOptions& options) const
+{
+	if (options.maxTypos != Dictionary::QueryOptions::autoTypos)
+		return calcMaxTyposEncoded(QString(), options);
+	return calcMaxTyposEncoded(encode(text), options);
+}
+
+uint Private::calcMaxTyposEncoded(const QString& encodedText,
+								  const Dictionary::QueryOptions& options) const
+{
+	if (options.maxTypos != Dictionary::QueryOptions::autoTypos)
+		return qMin<uint>(qMax(options.maxTypos, 0), DISTTYPE_MAX - 1);
 	return qMin<uint>(gramHash_.maxGramSize(), 
-		encText.size() / Dictionary::charsPerError_);
+		encodedText.size() / qMax(options.charsPerError, 1));
+}
+
+KeyType Private::lookup(const QString& encodedEntry) const
+{
+	QStringList entryGrams = grams(encodedEntry);
+	if (entryGrams.isEmpty())
+		return KeyDistTuple::invalidKey;
+	QString gram = entryGrams.first().left(maxGramSize());
+	const Value node = gramHash_[gram];
+	for (Value::const_iterator i = node.constBegin(); 
+		 i != node.constEnd(); i++)
+	{
+		QVector<KeyType> keys = (*i)->keys();
+		foreach (KeyType key, keys) {
+			if (encodedEntries_.isEqual(encodedEntry, key))
+				return key;
+		}
+	}
+	return KeyDistTuple::invalidKey;
+}
+
+bool Private::insert(const QString& entry)
+{
+	// Do the expensive work before locking.
+	QString encodedEntry = encode(entry);
+	QStringList entryGrams = grams(encodedEntry);
+	if (entryGrams.isEmpty())
+		return false;
+	entryGrams.removeDuplicates();
+	quint64 bitPattern = BitDistance::bitPattern(encodedEntry.unicode(),
+		encodedEntry.size());
+	CharHistogram histogram(encodedEntry.unicode(), encodedEntry.size());
+	
+	assertNotInMatchHandler();
+	QWriteLocker locker(&lock_);
+	if (lookup(encodedEntry) != KeyDistTuple::invalidKey)
+		return false;
+	if (static_cast<uint>(encodedEntries_.size()) == KEYTYPE_MAX)
+		throw Exception(Exception::TooManyEntries);
+	if (deltaLog_.isOpen() &&
+		deltaLog_.append(DeltaLog::Insert, entry) == false)
+		return false;
+	
+	KeyType key = encodedEntries_.size();
+	encodedEntries_.append(encodedEntry);
+	entries_.append(entry);
+	bitencodedEntries_.append(bitPattern);
+	histograms_.append(histogram);
+	foreach (const QString& gram, entryGrams)
+		gramHash_.insert(gram, key);
+	resultCache_.clear();
+	prefixIndex_.insert(*this, key);
+	checkCompactionThreshold();
+	return true;
+}
+
+bool Private::remove(const QString& entry)
+{
+	QString encodedEntry = encode(entry);
+	QStringList entryGrams = grams(encodedEntry);
+	if (entryGrams.isEmpty())
+		return false;
+	entryGrams.removeDuplicates();
+	
+	assertNotInMatchHandler();
+	QWriteLocker locker(&lock_);
+	KeyType key = lookup(encodedEntry);
+	if (key == KeyDistTuple::invalidKey)
+		return false;
+	if (deltaLog_.isOpen() &&
+		deltaLog_.append(DeltaLog::Remove, entry) == false)
+		return false;
+	foreach (const QString& gram, entryGrams)
+		gramHash_.remove(gram, key);
+	if (removed_.size() <= key)
+		removed_.resize(encodedEntries_.size());
+	removed_.setBit(key);
+	resultCache_.clear();
+	prefixIndex_.remove(*this, key);
+	checkCompactionThreshold();
+	return true;
 }
 
 bool Private::save()
 {
-	return db_->save(*this);
+	return compact();
 }
 
 bool Private::load()
 {
-	return db_->load(*this);
+	IF_PROFILER(ProfilerTimer timer(&profiler, Profiler::Load));
+	compactionThread_->wait();
+	deltaLog_.close();
+	resultCache_.clear();
+	prefixIndex_.invalidate();
+	weights_.clear();
+	if (db_->load(*this) == false)
+		return false;
+	replayDeltaLog();
+	deltaLog_.open(dictFilename_);
+	return true;
+}
+
+void Private::replayDeltaLog()
+{
+	QList<DeltaLog::Record> records;
+	if (DeltaLog::read(dictFilename_, records) == false)
+		return;
+	// The log is closed, so the records are not logged again.
+	Q_ASSERT(deltaLog_.isOpen() == false);
+	foreach (const DeltaLog::Record& record, records) {
+		if (record.operation == DeltaLog::Insert)
+			insert(record.entry);
+		else
+			remove(record.entry);
+	}
+}
+
+bool Private::compact()
+{
+	assertNotInMatchHandler();
+	QMutexLocker compactionLocker(&compactionLock_);
+	QReadLocker locker(&lock_);
+	if (dictFilename_.isEmpty())
+		return false;
+
+	// db_ loads the Containers which are still on disk while
+	// they are written, so we need a second DB for writing.
+	// Afterwards they are unloaded again, otherwise every
+	// compaction would leave the whole index in memory. lock_
+	// keeps them from being modified in between.
+	QList<Value::PtrToContainer> containers = gramHash_.containers();
+	QBitArray resident(containers.size());
+	for (int i = 0; i < containers.size(); i++) {
+		if (containers[i]->isLoaded())
+			resident.setBit(i);
+	}
+	DB db;
+	bool saved = db.saveNew(*this) &&
+		static_cast<DB*>(db_)->replace(db, *this);
+	for (int i = 0; i < containers.size(); i++) {
+		if (resident.testBit(i) == false)
+			containers[i]->unload(db_);
+	}
+	if (saved == false)
+		return false;
+
+	// The files contain all modifications now.
+	if (deltaLog_.isOpen() == false)
+		deltaLog_.open(dictFilename_);
+	return deltaLog_.truncate();
+}
+
+bool Private::compactInBackground()
+{
+	if (compactionThread_->isRunning())
+		return false;
+	compactionThread_->start();
+	return true;
+}
+
+void Private::checkCompactionThreshold()
+{
+	if (compactionThreshold_ > 0 &&
+		deltaLog_.size() >= compactionThreshold_)
+	{
+		// The compaction waits for our write lock.
+		compactInBackground();
+	}
+}
+
+void Private::setCompactionThreshold(quint32 records)
+{
+	assertNotInMatchHandler();
+	QWriteLocker locker(&lock_);
+	compactionThreshold_ = records;
+}
+
+quint32 Private::compactionThreshold() const
+{
+	QueryLocker locker(this, &lock_);
+	return compactionThreshold_;
+}
+
+void Private::waitForCompaction()
+{
+	compactionThread_->wait();
+}
+
+void Private::detach()
+{
+	waitForCompaction();
+	assertNotInMatchHandler();
+	QWriteLocker locker(&lock_);
+	deltaLog_.close();
+	compactionThreshold_ = 0;
+	dictFilename_.clear();
+	suspendedFilename_.clear();
+	suspendedLog_ = false;
+}
+
+void Private::suspend()
+{
+	waitForCompaction();
+	assertNotInMatchHandler();
+	QWriteLocker locker(&lock_);
+	if (dictFilename_.isEmpty())
+		return;
+	suspendedLog_ = deltaLog_.isOpen();
+	deltaLog_.close();
+	// compact() doesn't write without a filename.
+	suspendedFilename_ = dictFilename_;
+	dictFilename_.clear();
+}
+
+void Private::resume()
+{
+	assertNotInMatchHandler();
+	QWriteLocker locker(&lock_);
+	if (suspendedFilename_.isEmpty())
+		return;
+	dictFilename_ = suspendedFilename_;
+	suspendedFilename_.clear();
+	if (suspendedLog_)
+		deltaLog_.open(dictFilename_);
+	suspendedLog_ = false;
+}
+
+quint32 Private::pendingModifications() const
+{
+	QueryLocker locker(this, &lock_);
+	return deltaLog_.size();
 }
 
 void Private::clear()
 {
+	compactionThread_->wait();
+	// The dictionary files don't match anymore.
+	deltaLog_.close();
+	resultCache_.clear();
+	prefixIndex_.invalidate();
+	weights_.clear();
 	dictFilename_.clear();
 	encodedEntries_.clear();
 	entries_.clear();
+	bitencodedEntries_.clear();
+	histograms_.clear();
+	removed_.clear();
 	gramHash_.clear();
 }
 
 QString Private::find(const QString& needle,
 					  Dictionary::DebugInfo* debugInfo) const
 {
-	return searchStrategy_->search(needle, debugInfo);
+	return find(needle, Dictionary::QueryOptions(), 0, debugInfo);
+}
+
+QString Private::find(const QString& needle,
+					  const Dictionary::QueryOptions& options,
+					  Dictionary::QueryStats* stats,
+					  Dictionary::DebugInfo* debugInfo) const
+{
+	QueryLocker locker(this, &lock_);
+
+	// Verbose queries are never answered from the cache.
+	KeyType key;
+	if (debugInfo) {
+		SearchStrategyLease strategy(*this);
+		key = strategy->searchKey(encode(needle), options, stats,
+			debugInfo).key();
+	}
+	else
+		key = cachedSearch(encode(needle), options, stats);
+	if (key == KeyDistTuple::invalidKey)
+		return QString();
+	return entries_.toQString(key);
+}
+
+KeyType Private::findKey(const QString& encodedNeedle,
+						 const Dictionary::QueryOptions& options,
+						 Dictionary::QueryStats* stats) const
+{
+	QueryLocker locker(this, &lock_);
+	return cachedSearch(encodedNeedle, options, stats);
+}
+
+KeyType Private::cachedSearch(const QString& encodedNeedle,
+							  const Dictionary::QueryOptions& options,
+							  Dictionary::QueryStats* stats) const
+{
+	bool cacheable = resultCache_.isEnabled();
+	QString cacheKey;
+	KeyType result;
+	if (cacheable) {
+		cacheKey = ResultCache::key(encodedNeedle, options);
+		if (resultCache_.find(cacheKey, result)) {
+			if (stats)
+				*stats = Dictionary::QueryStats();
+			return result;
+		}
+	}
+
+	Dictionary::QueryStats queryStats;
+	bool logging = slowQueryLog_.isEnabled();
+	QElapsedTimer timer;
+	QueryTrace trace;
+	if (logging)
+		timer.start();
+	SearchStrategyLease strategy(*this);
+	result = strategy->searchKey(encodedNeedle, options, &queryStats, 0,
+		logging? &trace : 0).key();
+	if (logging)
+		logSlowQuery(encodedNeedle, options, result, queryStats, trace,
+			timer.nsecsElapsed());
+	if (cacheable && queryStats.truncated == false)
+		resultCache_.insert(cacheKey, result);
+	if (stats)
+		*stats = queryStats;
+	return result;
+}
+
+void Private::logSlowQuery(const QString& encodedNeedle,
+						   const Dictionary::QueryOptions& options,
+						   KeyType result,
+						   const Dictionary::QueryStats& stats,
+						   const QueryTrace& trace,
+						   qint64 nsecs) const
+{
+	if (slowQueryLog_.isSlow(nsecs, stats) == false)
+		return;
+	Dictionary::SlowQuery query;
+	query.time = QDateTime::currentDateTime();
+	query.encodedNeedle = encodedNeedle;
+	query.nsecs = nsecs;
+	query.stats = stats;
+
+	// Only slow queries pay for the strings of the DebugInfo.
+	Dictionary::DebugInfo& debugInfo = query.debugInfo;
+	debugInfo.encQuery = encodedNeedle;
+	debugInfo.maxTypos = calcMaxTyposEncoded(encodedNeedle, options);
+	if (result != KeyDistTuple::invalidKey) {
+		debugInfo.result = entries_.toQString(result);
+		debugInfo.editdistance = stats.distance;
+	}
+	foreach (const QueryTrace::Gram& gram, trace.grams()) {
+		Dictionary::DebugInfo::GramInfo gramInfo;
+		gramInfo.gram = gram.gram;
+		gramInfo.entries = gramHash_[gram.gram].valueCount();
+		gramInfo.editdistance = gram.match.distance();
+		if (gram.match.keyIsValid())
+			gramInfo.bestMatch = entries_.toQString(gram.match.key());
+		debugInfo.grams.append(gramInfo);
+	}
+	slowQueryLog_.append(query);
+}
+
+void Private::findWithin(const QString& needle, uint maxDistance,
+						 AbstractMatchHandler& handler) const
+{
+	Dictionary::QueryOptions options;
+	options.maxTypos = qMin<uint>(maxDistance, DISTTYPE_MAX - 1);
+	QueryLocker locker(this, &lock_);
+	MatchHandlerScope scope(this);
+	SearchStrategyLease strategy(*this);
+	strategy->searchWithin(needle, options, handler);
+}
+
+bool Private::isIndexed(KeyType key) const
+{
+	if (key < static_cast<KeyType>(removed_.size()) && removed_.testBit(key))
+		return false;
+	return static_cast<quint32>(encodedEntries_.sizeOf(key)) >= minGramSize();
+}
+
+AbstractSearchStrategy* Private::acquireStrategy() const
+{
+	{
+		QMutexLocker locker(&strategiesLock_);
+		if (idleStrategies_.isEmpty() == false)
+			return idleStrategies_.takeLast();
+	}
+	// The strategy only reads the dictionary while lock_ is held.
+	return new SearchStrategy(const_cast<Private&>(*this));
+}
+
+void Private::releaseStrategy(AbstractSearchStrategy* strategy) const
+{
+	QMutexLocker locker(&strategiesLock_);
+	idleStrategies_.append(strategy);
+}
+
+void Private::assertNotInMatchHandler() const
+{
+	Q_ASSERT_X(MatchHandlerScope::isRunning(this) == false,
+		"Private::assertNotInMatchHandler",
+		"a findWithin() handler modifies its dictionary");
+}
+
+/**
+ * Ranks completions by distance, then by weight (heavier first),
+ * then by key.
+ */
+class CompletionLess
+{
+
+	const QHash<KeyType, quint32>& weights_;
+
+public:
+
+	CompletionLess(const QHash<KeyType, quint32>& weights) :
+		weights_(weights)
+		{ }
+
+	bool operator() (const KeyDistTuple& lhs, const KeyDistTuple& rhs) const
+	{
+		if (lhs.distance() != rhs.distance())
+			return lhs.distance() < rhs.distance();
+		quint32 lhsWeight = weights_.value(lhs.key(), 0);
+		quint32 rhsWeight = weights_.value(rhs.key(), 0);
+		if (lhsWeight != rhsWeight)
+			return lhsWeight > rhsWeight;
+		return lhs.key() < rhs.key();
+	}
+
+};
+
+/**
+ * Keeps the k best completions in a heap with the worst one on
+ * top, so a query needs O(k) memory however many entries match.
+ */
+class CompletionTopK : public AbstractMatchHandler
+{
+
+	QVector<KeyDistTuple> heap_;
+
+	int k_;
+
+	CompletionLess less_;
+
+public:
+
+	CompletionTopK(int k, const QHash<KeyType, quint32>& weights) :
+		heap_(),
+		k_(k),
+		less_(weights)
+	{
+		heap_.reserve(k);
+	}
+
+	void add(KeyType key, uint distance)
+	{
+		KeyDistTuple tuple;
+		tuple.set(key, distance);
+		if (heap_.size() < k_) {
+			heap_.append(tuple);
+			std::push_heap(heap_.begin(), heap_.end(), less_);
+		}
+		else if (less_(tuple, heap_.first())) {
+			std::pop_heap(heap_.begin(), heap_.end(), less_);
+			heap_.last() = tuple;
+			std::push_heap(heap_.begin(), heap_.end(), less_);
+		}
+	}
+
+	virtual bool handle(quint32 key, uint distance, const QString&)
+	{
+		add(key, distance);
+		return true;
+	}
+
+	/**
+	 * The collected completions, best first. Empties the heap.
+	 */
+	QVector<KeyDistTuple> take()
+	{
+		std::sort_heap(heap_.begin(), heap_.end(), less_);
+		QVector<KeyDistTuple> rv;
+		qSwap(rv, heap_);
+		return rv;
+	}
+
+};
+
+QList<Dictionary::Match> Private::complete(const QString& prefix, int k,
+										   uint maxTypos) const
+{
+	QList<Dictionary::Match> rv;
+	QString encodedPrefix = encode(prefix);
+	if (k <= 0 || encodedPrefix.isEmpty())
+		return rv;
+	maxTypos = qMin<uint>(maxTypos, DISTTYPE_MAX - 1);
+
+	QueryLocker locker(this, &lock_);
+	CompletionTopK topK(k, weights_);
+	if (maxTypos == 0) {
+		// The matches are a range of the prefix index.
+		int begin, end;
+		prefixIndex_.range(*this, encodedPrefix, begin, end);
+		for (int i = begin; i < end; i++)
+			topK.add(prefixIndex_.at(i), 0);
+	}
+	else if (encodedPrefix.size() / (maxTypos + 1) < minGramSize()) {
+		// The pieces of the prefix are too short for the gram index.
+		int begin, end;
+		prefixIndex_.range(*this, QString(), begin, end);
+		// The distances to the empty head.
+		QVector<uint> column(encodedPrefix.size() + 1);
+		for (int i = 0; i < column.size(); i++)
+			column[i] = i;
+		completeFuzzy(encodedPrefix, maxTypos, begin, end, 0, column,
+			encodedPrefix.size(), topK);
+	}
+	else {
+		// At least one of maxTypos + 1 pieces of the prefix occurs
+		// in the entry, so the gram index finds the candidates.
+		Dictionary::QueryOptions options;
+		options.maxTypos = maxTypos;
+		options.matchType = EditDistance::PrefixMatch;
+		SearchStrategyLease strategy(*this);
+		strategy->searchWithin(prefix, options, topK);
+	}
+
+	QVector<KeyDistTuple> best = topK.take();
+	foreach (const KeyDistTuple& tuple, best) {
+		rv.append(Dictionary::Match(tuple.key(), tuple.distance(),
+			entries_.toQString(tuple.key())));
+	}
+	return rv;
+}
+
+void Private::completeFuzzy(const QString& encodedPrefix, uint maxTypos,
+							int begin, int end, int depth,
+							const QVector<uint>& column, uint best,
+							CompletionTopK& topK) const
+{
+	// Entries which end with the head sort first.
+	int i = begin;
+	for (; i < end && encodedEntries_.sizeOf(prefixIndex_.at(i)) == depth;
+		 i++)
+	{
+		if (best <= maxTypos)
+			topK.add(prefixIndex_.at(i), best);
+	}
+
+	// The minimum of the columns never decreases, so a longer
+	// head can't do better. See EditDistance::Ukkonen_prefix().
+	uint columnMin = *std::min_element(column.constBegin(),
+		column.constEnd());
+	if (columnMin >= best || columnMin > maxTypos) {
+		if (best <= maxTypos) {
+			for (; i < end; i++)
+				topK.add(prefixIndex_.at(i), best);
+		}
+		return;
+	}
+
+	int m = encodedPrefix.size();
+	QVector<uint> next(m + 1);
+	while (i < end) {
+		// The entries continuing the head with c are a range.
+		QChar c = encodedEntries_.unicode(prefixIndex_.at(i))[depth];
+		int low = i + 1;
+		int high = end;
+		while (low < high) {
+			int mid = low + (high - low) / 2;
+			if (encodedEntries_.unicode(prefixIndex_.at(mid))[depth] == c)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+
+		next[0] = depth + 1;
+		for (int r = 1; r <= m; r++) {
+			if (encodedPrefix[r - 1] == c)
+				next[r] = column[r - 1];
+			else
+				next[r] = qMin(qMin(column[r - 1], column[r]),
+					next[r - 1]) + 1;
+		}
+		completeFuzzy(encodedPrefix, maxTypos, i, low, depth + 1, next,
+			qMin(best, next[m]), topK);
+		i = low;
+	}
+}
+
+bool Private::setWeight(const QString& entry, quint32 weight)
+{
+	QString encodedEntry = encode(entry);
+	assertNotInMatchHandler();
+	QWriteLocker locker(&lock_);
+	KeyType key = lookup(encodedEntry);
+	if (key == KeyDistTuple::invalidKey)
+		return false;
+	if (weight == 0)
+		weights_.remove(key);
+	else
+		weights_.insert(key, weight);
+	return true;
+}
+
+void Private::addSearchStats(const Dictionary::QueryStats& stats) const
+{
+	QMutexLocker locker(&searchStatsLock_);
+	searchStats_ += stats;
+}
+
+Dictionary::QueryStats Private::searchStats() const
+{
+	QMutexLocker locker(&searchStatsLock_);
+	return searchStats_;
+}
+
+void Private::resetSearchStats()
+{
+	QMutexLocker locker(&searchStatsLock_);
+	searchStats_ = Dictionary::QueryStats();
+}
+
+Dictionary::MemoryUsage Private::memoryUsage() const
+{
+	Dictionary::MemoryUsage rv;
+	QueryLocker locker(this, &lock_);
+	rv.entries = entries_.memoryUsage();
+	rv.encodedEntries = encodedEntries_.memoryUsage();
+	rv.bitpatterns = bitencodedEntries_.capacity() * sizeof(quint64);
+	rv.histograms = histograms_.capacity() * sizeof(CharHistogram);
+	gramHash_.memoryUsage(rv);
+	rv.removed = (removed_.size() > 0)?
+		sizeof(QByteArray::Data) + 1 + (removed_.size() + 7) / 8 : 0;
+	rv.prefixIndex = prefixIndex_.memoryUsage();
+	rv.weights = weights_.capacity() * sizeof(void*) +
+		weights_.size() * sizeof(QHashNode<KeyType, quint32>);
+	rv.resultCache = resultCache_.memoryUsage();
+	rv.deltaLog = deltaLog_.memoryUsage();
+	rv.database = db_->memoryUsage();
+	return rv;
+}
+
+QList<Dictionary::Match> Private::findTopK(const QString& needle, int k) const
+{
+	QueryLocker locker(this, &lock_);
+	SearchStrategyLease strategy(*this);
+	QList<KeyDistTuple> tuples = strategy->searchTopK(encode(needle), k);
+	QList<Dictionary::Match> rv;
+	foreach (const KeyDistTuple& tuple, tuples) {
+		rv.append(Dictionary::Match(tuple.key(), tuple.distance(),
+			entries_.toQString(tuple.key())));
+	}
+	return rv;
+}
+
+QList<KeyDistTuple> Private::findTopKeys(const QString& encodedNeedle,
+										int k) const
+{
+	QueryLocker locker(this, &lock_);
+	SearchStrategyLease strategy(*this);
+	return strategy->searchTopK(encodedNeedle, k);
+}
+
+bool Private::entry(KeyType key, std::string& utf8) const
+{
+	utf8.clear();
+	QueryLocker locker(this, &lock_);
+	if (key >= static_cast<KeyType>(entries_.size()))
+		return false;
+	const QChar* pc = entries_.unicode(key);
+	int size = entries_.sizeOf(key);
+	utf8.reserve(size);
+	for (int i = 0; i < size; i++) {
+		uint uc = pc[i].unicode();
+		if (pc[i].isHighSurrogate() && i + 1 < size &&
+			pc[i + 1].isLowSurrogate())
+		{
+			uc = QChar::surrogateToUcs4(pc[i], pc[i + 1]);
+			i++;
+		}
+		if (uc < 0x80)
+			utf8 += static_cast<char>(uc);
+		else if (uc < 0x800) {
+			utf8 += static_cast<char>(0xC0 | (uc >> 6));
+			utf8 += static_cast<char>(0x80 | (uc & 0x3F));
+		}
+		else if (uc < 0x10000) {
+			utf8 += static_cast<char>(0xE0 | (uc >> 12));
+			utf8 += static_cast<char>(0x80 | ((uc >> 6) & 0x3F));
+			utf8 += static_cast<char>(0x80 | (uc & 0x3F));
+		}
+		else {
+			utf8 += static_cast<char>(0xF0 | (uc >> 18));
+			utf8 += static_cast<char>(0x80 | ((uc >> 12) & 0x3F));
+			utf8 += static_cast<char>(0x80 | ((uc >> 6) & 0x3F));
+			utf8 += static_cast<char>(0x80 | (uc & 0x3F));
+		}
+	}
+	return true;
 }
 
 } // namespace DictionaryImpl
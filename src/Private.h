@@ -3,12 +3,25 @@
 
 #pragma once
 
+#include <QReadWriteLock>
+#include <QMutex>
+#include <QBitArray>
+
+#include <string>
+
 #include <tagdistiller/StringArray.h>
 
 #include "DictionaryDefines.h"
 #include "GramHash.h"
 #include "BitDistance.h"
+#include "CharHistogram.h"
 #include "Profiler.h"
+#include "DeltaLog.h"
+#include "ResultCache.h"
+#include "PrefixIndex.h"
+#include "QueryStats.h"
+#include "MemoryUsage.h"
+#include "SlowQueryLog.h"
 
 namespace Distiller
 {
@@ -21,12 +34,24 @@ class AbstractDB;
 
 class AbstractSearchStrategy;
 
+class ExternalBuilder;
+
 class SearchStrategyBase;
 
 class ThreadedSearchStrategy;
 
 class SimpleSearchStrategy;
 
+class CompactionThread;
+
+class PrefixIndex;
+
+class SearchStrategyLease;
+
+class CompletionTopK;
+
+class QueryTrace;
+
 template<typename ThreadPolicy>
 class DictionaryDB;
 
@@ -74,7 +99,15 @@ private:
 
     AbstractDB<Value::Container>* db_;
 	
-	mutable AbstractSearchStrategy* searchStrategy_;
+	/**
+	 * Search strategies not in use. A strategy keeps the state of
+	 * the running query in its members, so concurrent queries take
+	 * one each, see SearchStrategyLease in Private.cpp.
+	 */
+	mutable QList<AbstractSearchStrategy*> idleStrategies_;
+
+	/// Guards idleStrategies_.
+	mutable QMutex strategiesLock_;
 
 	IF_PROFILER(mutable Profiler profiler);
 	
@@ -93,8 +126,169 @@ private:
 	/// A list of the bit encoded entries.
 	BitpatternList bitencodedEntries_;
 
+	/// A list of the character histograms of the encoded entries.
+	HistogramList histograms_;
+
+	/**
+	 * Set for the keys of removed entries, which stay in the
+	 * arrays above. Keys behind its end are alive.
+	 */
+	QBitArray removed_;
+
 	/// The hash of all grams.
 	Hash gramHash_;
+
+	/**
+	 * Guards the data structures above against concurrent
+	 * modification by insert() and remove(). Queries lock for
+	 * reading, modifications lock for writing. Queries run
+	 * concurrently, each with a search strategy of its own.
+	 */
+	mutable QReadWriteLock lock_;
+
+	/**
+	 * Log of the modifications made since the dictionary files
+	 * have been written. It's open as long as the files match
+	 * the loaded dictionary, i.e. after load() or save().
+	 */
+	DeltaLog deltaLog_;
+
+	/// Serializes compactions.
+	QMutex compactionLock_;
+
+	CompactionThread* compactionThread_;
+
+	/**
+	 * Number of log records which trigger a background
+	 * compaction. 0 disables automatic compaction.
+	 */
+	quint32 compactionThreshold_;
+
+	/// dictFilename_ while the files are not written, see suspend().
+	QString suspendedFilename_;
+
+	/// Whether suspend() has closed the delta log.
+	bool suspendedLog_;
+
+	/**
+	 * Results of find(). Cleared whenever the dictionary
+	 * is modified.
+	 */
+	mutable ResultCache resultCache_;
+
+	/**
+	 * Entries sorted by encoded form for complete(). Kept up to
+	 * date by insert() and remove(), dropped by load() and clear().
+	 */
+	mutable PrefixIndex prefixIndex_;
+
+	/// Weights of entries for complete(), 0 if missing.
+	QHash<KeyType, quint32> weights_;
+
+	/// Sum of the QueryStats of all searched queries.
+	mutable Dictionary::QueryStats searchStats_;
+
+	mutable QMutex searchStatsLock_;
+
+	/// Queries which exceeded the thresholds of the log.
+	mutable SlowQueryLog slowQueryLog_;
+
+	/**
+	 * Applied by encode() before encoding, may be 0. Not owned.
+	 * Stored by name in the index files.
+	 */
+	const AbstractNormalizer* normalizer_;
+
+	/**
+	 * Applies the records of the delta log to the loaded
+	 * dictionary.
+	 */
+	void replayDeltaLog();
+
+	/**
+	 * Starts a background compaction if the delta log has
+	 * reached the threshold.
+	 *
+	 * \note The caller has to hold lock_ for writing.
+	 */
+	void checkCompactionThreshold();
+
+	/**
+	 * Returns the key of an encoded entry which is reachable
+	 * through the GramHash, or KeyDistTuple::invalidKey.
+	 *
+	 * \note The caller has to hold lock_.
+	 */
+	KeyType lookup(const QString& encodedEntry) const;
+
+	/**
+	 * Completes encodedPrefix with up to maxTypos errors by walking
+	 * the prefix index like a trie. The positions [begin, end) share
+	 * their first depth characters, the head. column holds the edit
+	 * distances of the first characters of encodedPrefix to the
+	 * head and best the smallest distance of encodedPrefix to a
+	 * prefix of the head. Heads whose distances all exceed maxTypos
+	 * are skipped, so the work depends on the number of heads within
+	 * the error budget rather than on the size of the dictionary.
+	 *
+	 * \note The caller has to hold lock_.
+	 */
+	void completeFuzzy(const QString& encodedPrefix, uint maxTypos,
+					   int begin, int end, int depth,
+					   const QVector<uint>& column, uint best,
+					   CompletionTopK& topK) const;
+
+	/**
+	 * Returns true if key is reachable through the GramHash: the
+	 * entry hasn't been removed and is long enough to have grams.
+	 *
+	 * \note The caller has to hold lock_.
+	 */
+	bool isIndexed(KeyType key) const;
+
+	/**
+	 * Takes an idle search strategy, or creates one if all of
+	 * them are used by other queries.
+	 */
+	AbstractSearchStrategy* acquireStrategy() const;
+
+	/**
+	 * Hands a strategy taken by acquireStrategy() back.
+	 */
+	void releaseStrategy(AbstractSearchStrategy* strategy) const;
+
+	/**
+	 * Asserts that the calling thread doesn't run a findWithin()
+	 * handler of this dictionary. The handler runs while lock_ is
+	 * held for reading, so locking it for writing would deadlock.
+	 * Does nothing in release builds. Queries don't lock lock_
+	 * again in a handler, see QueryLocker in Private.cpp.
+	 */
+	void assertNotInMatchHandler() const;
+
+	/**
+	 * Records the query in slowQueryLog_ if it exceeded the
+	 * thresholds. Its DebugInfo is built from the trace recorded
+	 * while it ran, so fast queries don't pay for the strings.
+	 *
+	 * \note The caller has to hold lock_.
+	 */
+	void logSlowQuery(const QString& encodedNeedle,
+					  const Dictionary::QueryOptions& options,
+					  KeyType result,
+					  const Dictionary::QueryStats& stats,
+					  const QueryTrace& trace,
+					  qint64 nsecs) const;
+
+	/**
+	 * Looks up the result of a query in the cache, or searches
+	 * and caches it.
+	 *
+	 * \note The caller has to hold lock_.
+	 */
+	KeyType cachedSearch(const QString& encodedNeedle,
+						 const Dictionary::QueryOptions& options,
+						 Dictionary::QueryStats* stats) const;
 	
 public:
 
@@ -111,9 +305,64 @@ public:
 	inline quint32 maxGramSize() const
 		{ return gramHash_.maxGramSize(); }
 		
+	/**
+	 * Writes the dictionary files. Same as compact().
+	 */
 	bool save();
 	
+	/**
+	 * Loads the dictionary files and replays the delta log.
+	 */
 	bool load();
+
+	/**
+	 * Rewrites the dictionary files with all modifications and
+	 * truncates the delta log. Holds lock_ for reading, so queries
+	 * are answered during the compaction.
+	 */
+	bool compact();
+
+	/**
+	 * Runs compact() in a background thread. Returns false if
+	 * a background compaction is already running.
+	 */
+	bool compactInBackground();
+
+	void setCompactionThreshold(quint32 records);
+
+	quint32 compactionThreshold() const;
+
+	/**
+	 * Waits until a background compaction has finished.
+	 */
+	void waitForCompaction();
+
+	/**
+	 * Stops writing to the dictionary files. Called when the
+	 * dictionary is replaced by a new snapshot; modifications
+	 * are applied in memory only afterwards.
+	 */
+	void detach();
+
+	/**
+	 * Stops writing to the dictionary files and the delta log
+	 * while a new snapshot is loaded or built from them, until
+	 * resume() is called or the snapshot is detached.
+	 * Modifications are applied in memory only meanwhile.
+	 */
+	void suspend();
+
+	/**
+	 * Reopens the delta log after suspend(), if the new snapshot
+	 * couldn't be loaded.
+	 */
+	void resume();
+
+	/**
+	 * Number of modifications not yet compacted into the
+	 * dictionary files.
+	 */
+	quint32 pendingModifications() const;
 	
 	void clear();
 
@@ -125,24 +374,155 @@ public:
 	 * letter, digit and spaces.
 	 *
 	 * Example: "Louis Armstrong" --> "louis armstrong"
+	 *
+	 * ASCII characters are encoded by table lookup, with SSE2
+	 * eight at a time. Only other characters need the Unicode
+	 * properties of QChar.
+	 *
+	 * If a normalizer is set, the text is normalized first.
 	 */
 	QString encode(const QString& text) const;
+
+	/**
+	 * Encodes a UTF-8 string of size bytes without converting
+	 * it to a QString first. Malformed sequences are dropped.
+	 */
+	QString encode(const char* utf8, int size) const;
 	
+	/**
+	 * Returns the grams an encoded entry is indexed with.
+	 *
+	 * Entries shorter than minGramSize() have no grams, entries
+	 * not longer than gramSize() are a gram on their own.
+	 *
+	 * Example (gramSize = 4, minGramSize = 2):
+	 *     "gammas" --> "gamm", "amma", "mmas", "mas", "as"
+	 */
+	QStringList grams(const QString& encodedEntry) const;
+
 	/**
 	 * Returns the maximum of allowed errors for a string.
 	 */
 	uint calcMaxTypos(const QString& text) const;
+
+	/**
+	 * Returns the maximum of allowed errors for a string
+	 * under the given options.
+	 */
+	uint calcMaxTypos(const QString& text,
+					  const Dictionary::QueryOptions& options) const;
+
+	/**
+	 * Same as calcMaxTypos() for a string which is encoded
+	 * already.
+	 */
+	uint calcMaxTyposEncoded(const QString& encodedText,
+							 const Dictionary::QueryOptions& options) const;
 	
+	/**
+	 * Inserts an entry into the loaded dictionary.
+	 *
+	 * Returns false if the entry is already in the dictionary, if
+	 * its encoded form is shorter than minGramSize() or if it
+	 * couldn't be written to the delta log. Throws
+	 * Exception(Exception::TooManyEntries) if the maximum numbers of
+	 * entries is exceeded.
+	 */
+	bool insert(const QString& entry);
+	
+	/**
+	 * Removes an entry from the loaded dictionary.
+	 *
+	 * Keys are positions in the string arrays, so the entry itself
+	 * stays in the arrays. It is removed from all Containers and
+	 * thus can't be found anymore.
+	 *
+	 * Returns false if the entry is not in the dictionary or if
+	 * the deletion couldn't be written to the delta log.
+	 */
+	bool remove(const QString& entry);
+
 	/**
 	 * The match to a given pattern.
 	 * Returns QString() if nothing is found.
 	 */
 	QString find(const QString& needle,
 		         Dictionary::DebugInfo* debugInfo = NULL) const;
+
+	QString find(const QString& needle,
+				 const Dictionary::QueryOptions& options,
+				 Dictionary::QueryStats* stats = NULL,
+		         Dictionary::DebugInfo* debugInfo = NULL) const;
+
+	/**
+	 * Same as find() for an encoded needle, but returns the key of
+	 * the match or KeyDistTuple::invalidKey.
+	 */
+	KeyType findKey(const QString& encodedNeedle,
+					const Dictionary::QueryOptions& options,
+					Dictionary::QueryStats* stats = NULL) const;
+
+	/**
+	 * The k best matches to a given pattern, best first.
+	 */
+	QList<Dictionary::Match> findTopK(const QString& needle, int k) const;
+
+	/**
+	 * The k best matches to an encoded needle, best first.
+	 */
+	QList<KeyDistTuple> findTopKeys(const QString& encodedNeedle,
+									int k) const;
+
+	/**
+	 * Writes the entry of key to utf8. Returns false if there is
+	 * no such key.
+	 */
+	bool entry(KeyType key, std::string& utf8) const;
+
+	/**
+	 * Hands every entry within maxDistance to handler.
+	 */
+	void findWithin(const QString& needle, uint maxDistance,
+					AbstractMatchHandler& handler) const;
+
+	/**
+	 * The k best entries whose encoded form starts with the
+	 * encoded prefix, allowing maxTypos errors in the prefix.
+	 * Ranked by distance, then by weight (descending), then by key.
+	 */
+	QList<Dictionary::Match> complete(const QString& prefix, int k,
+									  uint maxTypos) const;
+
+	/**
+	 * Sets the weight of an entry for complete(). Returns false
+	 * if the entry is not in the dictionary.
+	 */
+	bool setWeight(const QString& entry, quint32 weight);
+
+	/**
+	 * Adds the stats of a query to searchStats(). Called by the
+	 * search strategies after every query.
+	 */
+	void addSearchStats(const Dictionary::QueryStats& stats) const;
+
+	/**
+	 * Sum of the stats of all queries since the dictionary has
+	 * been loaded or resetSearchStats() has been called.
+	 */
+	Dictionary::QueryStats searchStats() const;
+
+	/**
+	 * Bytes used by the loaded dictionary.
+	 */
+	Dictionary::MemoryUsage memoryUsage() const;
+
+	void resetSearchStats();
 	
     friend class Distiller::Dictionary;
 	
     friend class Distiller::DictionaryImpl::Builder;
+
+    friend class Distiller::DictionaryImpl::ExternalBuilder;
 	
 	template<typename ThreadPolicy>
     friend class Distiller::DictionaryImpl::DictionaryDB;
@@ -155,6 +535,10 @@ public:
     friend class Distiller::DictionaryImpl::SimpleSearchStrategy;
 	
     friend class Distiller::DictionaryImpl::ThreadedSearchStrategy;
+
+    friend class Distiller::DictionaryImpl::PrefixIndex;
+
+    friend class Distiller::DictionaryImpl::SearchStrategyLease;
 };
 
 } // namespace DictionaryImpl
@@ -1,3 +1,4 @@
+
 #include <core/precompiled.h>
 
 #include "Profiler.h"
@@ -8,32 +9,56 @@ namespace Distiller
 namespace DictionaryImpl
 {
 
+QAtomicInt Profiler::enabled_(-1);
+
 Profiler::Profiler() : 
-	new_time(0),
-	createnode_time(0), 
-	insertnode_time(0),
-	recount_time(0),
-	loadstringarray_time(0),
-	loadkeylistpos_time(0),
-	queries(0),
-	querytime(0),
-	queriesPerSec(0)
+	recorder_(PhaseCount)
 { }
 
+ProfilerReport Profiler::report() const
+{
+	ProfilerReport rv;
+	for (int i = 0; i < PhaseCount; i++) {
+		Phase phase = static_cast<Phase>(i);
+		rv[phase] = recorder_.histogram(phase);
+	}
+	return rv;
+}
+
 void Profiler::reset()
 {
-	new_time = 0;
-	createnode_time = 0;
-	insertnode_time = 0;
-	recount_time = 0;
-	loadstringarray_time = 0;
-	loadkeylistpos_time = 0;
-	queries = 0;
-	querytime = 0;
-	queriesPerSec = 0;
+	recorder_.reset();
+}
+
+bool Profiler::enabledByEnvironment()
+{
+	int enable = (qgetenv("DICTIONARY_PROFILER") == "1")? 1 : 0;
+	// setEnabled() wins if it has been called meanwhile.
+	enabled_.testAndSetRelaxed(-1, enable);
+	return static_cast<int>(enabled_) != 0;
+}
+
+void Profiler::setEnabled(bool enable)
+{
+	enabled_ = enable? 1 : 0;
+}
+
+const char* Profiler::phaseName(Phase phase)
+{
+	switch (phase) {
+	case Query: return "query";
+	case Load: return "load";
+	case Build: return "build";
+	case LoadStringArray: return "loadstringarray";
+	case LoadKeyListPos: return "loadkeylistpos";
+	case CreateNode: return "createnode";
+	case InsertNode: return "insertnode";
+	case Sort: return "sort";
+	case PhaseCount: break;
+	}
+	return "";
 }
 
 } // namespace DictionaryImpl
 
 } // namespace Distiller
-
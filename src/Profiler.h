@@ -3,7 +3,11 @@
 
 #pragma once
 
-#include <QTime>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+#include "LatencyHistogram.h"
+#include "LatencyRecorder.h"
 
 namespace Distiller
 {
@@ -11,37 +15,136 @@ namespace Distiller
 namespace DictionaryImpl
 {
 
+class ProfilerReport;
+
+/**
+ * Records the durations of queries and of the phases of loading
+ * and building a dictionary in LatencyHistograms.
+ *
+ * record() may be called by any number of threads concurrently,
+ * they record into striped histograms (see LatencyRecorder).
+ * report() merges them.
+ *
+ * Profiling is off unless it's switched on for the process by
+ * setEnabled() or by setting the environment variable
+ * DICTIONARY_PROFILER to 1. While it's off a ProfilerTimer costs
+ * a single atomic read.
+ */
 class Profiler
 {
 
 public:
 
-	QTime timer;
-	
-	QTime queryTimer;
-	
-	uint new_time;
-	
-	uint createnode_time;
-	
-	uint insertnode_time;
-	
-	uint recount_time;
-	
-	uint loadstringarray_time;
-	
-	uint loadkeylistpos_time;
-	
-	uint queries;
-	
-	uint querytime;
-	
-	double queriesPerSec;
-	
+	enum Phase
+	{
+		/// A query, from the encoded needle to the best match.
+		Query,
+		/// Loading a dictionary from its index files.
+		Load,
+		/// Building a dictionary from a textfile.
+		Build,
+		/// Reading the string arrays from the index file.
+		LoadStringArray,
+		/// Reading the positions of the Containers.
+		LoadKeyListPos,
+		/// Creating and reading a single Container.
+		CreateNode,
+		/// Inserting a single Container into the GramHash.
+		InsertNode,
+		/// Sorting the gram table after loading or building.
+		Sort,
+		PhaseCount
+	};
+
+private:
+
+	LatencyRecorder recorder_;
+
+	/// 1 if enabled, 0 if disabled, -1 if not yet decided.
+	static QAtomicInt enabled_;
+
+	static bool enabledByEnvironment();
+
+	Q_DISABLE_COPY(Profiler)
+
+public:
+
 	Profiler();
-	
+
+	void record(Phase phase, qint64 nsecs)
+		{ recorder_.record(phase, nsecs); }
+
+	/**
+	 * Returns the histograms of all phases, merged over all
+	 * threads.
+	 */
+	ProfilerReport report() const;
+
 	void reset();
-	
+
+	static const char* phaseName(Phase phase);
+
+	/**
+	 * Returns true if profiling is switched on for the process.
+	 */
+	static bool enabled()
+	{
+		int rv = enabled_;
+		return (rv < 0)? enabledByEnvironment() : rv != 0;
+	}
+
+	static void setEnabled(bool enable);
+
+};
+
+/**
+ * The histograms of a Profiler at some point in time.
+ */
+class ProfilerReport
+{
+
+	LatencyHistogram histograms_[Profiler::PhaseCount];
+
+public:
+
+	const LatencyHistogram& operator[] (Profiler::Phase phase) const
+		{ return histograms_[phase]; }
+
+	LatencyHistogram& operator[] (Profiler::Phase phase)
+		{ return histograms_[phase]; }
+
+};
+
+/**
+ * Records the time between its construction and its destruction
+ * as phase, if profiler isn't 0 and profiling is enabled.
+ */
+class ProfilerTimer
+{
+
+	Profiler* profiler_;
+
+	Profiler::Phase phase_;
+
+	QElapsedTimer timer_;
+
+public:
+
+	ProfilerTimer(Profiler* profiler, Profiler::Phase phase) :
+		profiler_(Profiler::enabled()? profiler : 0),
+		phase_(phase),
+		timer_()
+	{
+		if (profiler_)
+			timer_.start();
+	}
+
+	~ProfilerTimer()
+	{
+		if (profiler_)
+			profiler_->record(phase_, timer_.nsecsElapsed());
+	}
+
 };
 
 } // namespace DictionaryImpl
@@ -49,4 +152,3 @@ public:
 } // namespace Distiller
 
 #endif 
-
@@ -0,0 +1,78 @@
+#include <core/precompiled.h>
+
+#include "DictionaryDefines.h"
+#include "QueryOptions.h"
+#include "CancellationToken.h"
+#include "QueryBudget.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+QueryBudget::QueryBudget(const Dictionary::QueryOptions& options) :
+	timer_(),
+	timeout_(options.timeout),
+	maxCandidates_(options.maxCandidates),
+	cancellation_(options.cancellation),
+	reserved_(0),
+	exhausted_(0),
+	truncated_(0)
+{
+	timer_.start();
+}
+
+bool QueryBudget::isLimited() const
+{
+	return timeout_ > 0 || maxCandidates_ > 0 || cancellation_ != 0;
+}
+
+uint QueryBudget::reserve()
+{
+	if (exhausted()) {
+		truncated_ = 1;
+		return 0;
+	}
+	if (maxCandidates_ == 0)
+		return checkInterval_;
+	uint reserved = reserved_.fetchAndAddRelaxed(checkInterval_);
+	if (reserved >= maxCandidates_) {
+		exhausted_ = 1;
+		truncated_ = 1;
+		return 0;
+	}
+	return qMin(checkInterval_, maxCandidates_ - reserved);
+}
+
+bool QueryBudget::exhausted()
+{
+	if (isExhausted())
+		return true;
+	if ((cancellation_ != 0 && cancellation_->isCancelled()) ||
+		(timeout_ > 0 && timer_.elapsed() >= timeout_))
+	{
+		exhausted_ = 1;
+		return true;
+	}
+	return false;
+}
+
+bool QueryBudget::isExhausted() const
+{
+	return static_cast<int>(exhausted_) != 0;
+}
+
+void QueryBudget::setTruncated()
+{
+	truncated_ = 1;
+}
+
+bool QueryBudget::isTruncated() const
+{
+	return static_cast<int>(truncated_) != 0;
+}
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
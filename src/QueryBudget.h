@@ -0,0 +1,95 @@
+#ifndef DISTILLER_DICTIONARYIMPL_QUERYBUDGET_H
+#define DISTILLER_DICTIONARYIMPL_QUERYBUDGET_H
+
+#pragma once
+
+#include <QTime>
+#include <QAtomicInt>
+
+#include "Dictionary.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+/**
+ * Limits the work of a single query: the time, the number of
+ * verified candidates and a CancellationToken given by the
+ * QueryOptions.
+ *
+ * The budget is only installed if the query is limited at all,
+ * see isLimited(). Every thread of the query charges its
+ * candidates to a BudgetAccount of its own, which reserves them
+ * from the budget checkInterval_ at a time. The clock and the
+ * token are looked at with every reservation and between grams.
+ * Once the budget is exhausted every thread stops.
+ */
+class QueryBudget
+{
+
+	static const uint checkInterval_ = 64;
+
+	QTime timer_;
+
+	int timeout_;
+
+	uint maxCandidates_;
+
+	const Dictionary::CancellationToken* cancellation_;
+
+	/// Candidates reserved by the accounts of the query.
+	QAtomicInt reserved_;
+
+	QAtomicInt exhausted_;
+
+	/// Set once work has been skipped, see isTruncated().
+	QAtomicInt truncated_;
+
+public:
+
+	QueryBudget(const Dictionary::QueryOptions& options);
+
+	/**
+	 * Returns true if the options limit the query at all.
+	 */
+	bool isLimited() const;
+
+	/**
+	 * Reserves the next batch of at most checkInterval_
+	 * candidates for a BudgetAccount. Returns the number of
+	 * candidates granted, 0 if the budget is exhausted.
+	 */
+	uint reserve();
+
+	/**
+	 * Checks the clock and the token. Returns true if the
+	 * query has to stop.
+	 */
+	bool exhausted();
+
+	/**
+	 * Returns true if the budget ran out. Doesn't check again.
+	 */
+	bool isExhausted() const;
+
+	/**
+	 * Records that the query skipped a gram because the budget
+	 * ran out. Refused reservations are recorded by reserve().
+	 */
+	void setTruncated();
+
+	/**
+	 * Returns true if the query skipped work. A budget which runs
+	 * out after the last candidate doesn't truncate the result.
+	 */
+	bool isTruncated() const;
+
+};
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
+
+#endif 
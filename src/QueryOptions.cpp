@@ -0,0 +1,17 @@
+#include <core/precompiled.h>
+
+#include "QueryOptions.h"
+
+namespace Distiller
+{
+
+Dictionary::QueryOptions::QueryOptions() :
+	maxTypos(autoTypos),
+	charsPerError(Dictionary::charsPerError_),
+	matchType(EditDistance::SubstringMatch),
+	timeout(0),
+	maxCandidates(0),
+	cancellation(0)
+{ }
+
+} // namespace Distiller
@@ -0,0 +1,88 @@
+#ifndef DISTILLER_DICTIONARYIMPL_QUERYOPTIONS_H
+#define DISTILLER_DICTIONARYIMPL_QUERYOPTIONS_H
+
+#pragma once
+
+#include <tagdistiller/EditDistance.h>
+
+#include "Dictionary.h"
+
+namespace Distiller
+{
+
+/**
+ * Tunes a single query.
+ *
+ * The number of allowed typos determines how many pieces the
+ * needle is cut into: more typos mean shorter grams, more
+ * candidates and slower queries. A cheap strict query can be
+ * followed by an expensive lenient one if it finds nothing:
+ *
+ *     Dictionary::QueryOptions strict;
+ *     strict.charsPerError = 8;
+ *     QString result = dict.find(needle, strict);
+ *     if (result.isNull()) {
+ *         Dictionary::QueryOptions lenient;
+ *         lenient.charsPerError = 3;
+ *         result = dict.find(needle, lenient);
+ *     }
+ */
+class Dictionary::QueryOptions
+{
+
+public:
+
+	static const int autoTypos = -1;
+
+	/**
+	 * Maximum number of typos. autoTypos derives it from
+	 * charsPerError, limited to the maximum gram size.
+	 *
+	 * The needle is cut into maxTypos + 1 pieces. If they are
+	 * shorter than the minimum gram size they can't be looked up
+	 * in the gram index, and the query scans every entry instead.
+	 * That finds all matches, but takes time linear in the size
+	 * of the dictionary.
+	 */
+	int maxTypos;
+
+	/**
+	 * One typo is allowed per charsPerError characters of the
+	 * encoded needle. Ignored if maxTypos is given. Values below
+	 * 1 count as 1.
+	 */
+	int charsPerError;
+
+	/**
+	 * SubstringMatch allows the entry to contain text around the
+	 * needle, PrefixMatch allows text behind the needle, ExactMatch
+	 * compares the needle to the whole entry.
+	 */
+	EditDistance::MatchType matchType;
+
+	/**
+	 * Time limit of the query in milliseconds, 0 means no limit.
+	 * The query returns the best match found so far shortly after
+	 * the limit, QueryStats::truncated tells it has been cut short.
+	 */
+	int timeout;
+
+	/**
+	 * Maximum number of candidates to verify, 0 means no limit.
+	 * Bounds the work of needles with very common grams.
+	 */
+	uint maxCandidates;
+
+	/**
+	 * Token to cancel the query from another thread, may be 0.
+	 * The token must outlive the query.
+	 */
+	const CancellationToken* cancellation;
+
+	QueryOptions();
+
+};
+
+} // namespace Distiller
+
+#endif 
@@ -0,0 +1,41 @@
+#include <core/precompiled.h>
+
+#include "QueryStats.h"
+
+namespace Distiller
+{
+
+Dictionary::QueryStats::QueryStats() :
+	truncated(false),
+	candidates(0),
+	queries(0),
+	grams(0),
+	containers(0),
+	loadedContainers(0),
+	postings(0),
+	sizeRejections(0),
+	bitRejections(0),
+	histogramRejections(0),
+	verifications(0),
+	earlyExits(0),
+	distance(-1)
+{ }
+
+Dictionary::QueryStats& Dictionary::QueryStats::operator += (const QueryStats& other)
+{
+	truncated = truncated || other.truncated;
+	candidates += other.candidates;
+	queries += other.queries;
+	grams += other.grams;
+	containers += other.containers;
+	loadedContainers += other.loadedContainers;
+	postings += other.postings;
+	sizeRejections += other.sizeRejections;
+	bitRejections += other.bitRejections;
+	histogramRejections += other.histogramRejections;
+	verifications += other.verifications;
+	earlyExits += other.earlyExits;
+	return *this;
+}
+
+} // namespace Distiller
@@ -0,0 +1,93 @@
+#ifndef DISTILLER_DICTIONARYIMPL_QUERYSTATS_H
+#define DISTILLER_DICTIONARYIMPL_QUERYSTATS_H
+
+#pragma once
+
+#include "Dictionary.h"
+
+namespace Distiller
+{
+
+/**
+ * Describes how a query has been answered.
+ *
+ * Besides the budget, the counters tell how many candidates each
+ * stage of the search has dropped, which explains why a query is
+ * slow: every key in a Container of a looked-up gram is a posting;
+ * it is dropped by the length filter, the bit pattern filter or the
+ * histogram filter, or verified by computing the edit distance.
+ * A verification which stops because the distance exceeds the bound
+ * is an early exit.
+ *
+ * Counting costs time in the inner loop, so the counters from grams
+ * to earlyExits are only filled while profiling is switched on (see
+ * DictionaryImpl::Profiler::setEnabled() and DICTIONARY_PROFILER) or
+ * the slow query log has a postings threshold. Otherwise they stay 0.
+ *
+ * Dictionary::searchStats() returns the sum over all queries, then
+ * queries holds the number of queries.
+ */
+class Dictionary::QueryStats
+{
+
+public:
+
+	/**
+	 * True if the query stopped before all candidates had been
+	 * verified, because it ran out of time or candidates or it
+	 * has been cancelled. The result is the best match found
+	 * so far then.
+	 */
+	bool truncated;
+
+	/// Number of candidates the query has verified.
+	uint candidates;
+
+	/// Number of queries counted, 1 for a single query.
+	quint64 queries;
+
+	/// Number of grams looked up in the gram index.
+	quint64 grams;
+
+	/// Number of Containers scanned.
+	quint64 containers;
+
+	/// Number of Containers which had to be loaded from disk.
+	quint64 loadedContainers;
+
+	/// Number of keys scanned.
+	quint64 postings;
+
+	/// Keys dropped because their length differs too much.
+	quint64 sizeRejections;
+
+	/// Keys dropped by BitDistance.
+	quint64 bitRejections;
+
+	/// Keys dropped by the character histograms.
+	quint64 histogramRejections;
+
+	/// Number of edit distance calculations.
+	quint64 verifications;
+
+	/// Edit distance calculations which gave up early.
+	quint64 earlyExits;
+
+	/**
+	 * Edit distance of the result, -1 if nothing has been
+	 * found. Not summed up by operator+=().
+	 */
+	int distance;
+
+	QueryStats();
+
+	/**
+	 * Adds the counters of other.
+	 */
+	QueryStats& operator += (const QueryStats& other);
+
+};
+
+} // namespace Distiller
+
+#endif 
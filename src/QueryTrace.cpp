@@ -0,0 +1,33 @@
+#include <core/precompiled.h>
+
+#include "DictionaryDefines.h"
+#include "QueryTrace.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+QueryTrace::QueryTrace() :
+	grams_(),
+	mutex_()
+{ }
+
+void QueryTrace::add(const QString& gram, const KeyDistTuple& match)
+{
+	Gram rv;
+	rv.gram = gram;
+	rv.match = match;
+	QMutexLocker locker(&mutex_);
+	grams_.append(rv);
+}
+
+const QList<QueryTrace::Gram>& QueryTrace::grams() const
+{
+	return grams_;
+}
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
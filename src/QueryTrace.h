@@ -0,0 +1,68 @@
+#ifndef DISTILLER_DICTIONARYIMPL_QUERYTRACE_H
+#define DISTILLER_DICTIONARYIMPL_QUERYTRACE_H
+
+#pragma once
+
+#include <QMutex>
+
+#include "KeyDistTuple.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+/**
+ * The best match of every gram a query has looked up, recorded
+ * for the slow query log.
+ *
+ * Recording costs a reference to the gram and a KeyDistTuple per
+ * gram. The DebugInfo with its strings is only built from the
+ * trace if the query turns out to be slow, see
+ * Private::logSlowQuery().
+ */
+class QueryTrace
+{
+
+public:
+
+	class Gram
+	{
+
+	public:
+
+		QString gram;
+
+		KeyDistTuple match;
+
+	};
+
+private:
+
+	QList<Gram> grams_;
+
+	/// The threads of a query add their grams concurrently.
+	QMutex mutex_;
+
+public:
+
+	QueryTrace();
+
+	/**
+	 * Records the best match of a gram.
+	 */
+	void add(const QString& gram, const KeyDistTuple& match);
+
+	/**
+	 * The recorded grams. Call it after the query is done.
+	 */
+	const QList<Gram>& grams() const;
+
+};
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
+
+#endif 
@@ -0,0 +1,27 @@
+#include <core/precompiled.h>
+
+#include "Dictionary.h"
+#include "ReloadTask.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+ReloadTask::ReloadTask(Dictionary& dict, const QString& dictionary) :
+	QRunnable(),
+	dict_(dict),
+	dictionary_(dictionary)
+{ }
+
+void ReloadTask::run()
+{
+	bool rv = dict_.load(dictionary_);
+	QMutexLocker locker(&dict_.snapshotLock_);
+	dict_.reloadSucceeded_ = rv;
+}
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
@@ -0,0 +1,39 @@
+#ifndef DISTILLER_DICTIONARYIMPL_RELOADTASK_H
+#define DISTILLER_DICTIONARYIMPL_RELOADTASK_H
+
+#pragma once
+
+#include <QRunnable>
+#include <QString>
+
+namespace Distiller
+{
+
+class Dictionary;
+
+namespace DictionaryImpl
+{
+
+/**
+ * Loads a dictionary on a pool thread and swaps it into a
+ * Dictionary. See Dictionary::reloadInBackground().
+ */
+class ReloadTask : public QRunnable
+{
+
+	Dictionary& dict_;
+
+	QString dictionary_;
+
+public:
+
+	ReloadTask(Dictionary& dict, const QString& dictionary);
+
+	void run();
+};
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
+
+#endif 
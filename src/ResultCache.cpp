@@ -0,0 +1,109 @@
+#include <core/precompiled.h>
+
+#include "DictionaryDefines.h"
+#include "QueryOptions.h"
+#include "ResultCache.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+ResultCache::ResultCache() :
+	cache_(0),
+	mutex_(),
+	hits_(0),
+	misses_(0)
+{ }
+
+QString ResultCache::key(const QString& encodedNeedle,
+						 const Dictionary::QueryOptions& options)
+{
+	// The limits of a query (timeout, candidates, cancellation) are
+	// not part of the key: truncated results are not cached.
+	return QString("%1:%2:%3:").arg(options.maxTypos)
+		.arg(options.charsPerError)
+		.arg((int)options.matchType) + encodedNeedle;
+}
+
+void ResultCache::setCapacity(int results)
+{
+	QMutexLocker locker(&mutex_);
+	cache_.setMaxCost(qMax(results, 0));
+}
+
+int ResultCache::capacity() const
+{
+	QMutexLocker locker(&mutex_);
+	return cache_.maxCost();
+}
+
+bool ResultCache::isEnabled() const
+{
+	return capacity() > 0;
+}
+
+bool ResultCache::find(const QString& key, KeyType& result)
+{
+	QMutexLocker locker(&mutex_);
+	// QCache::object() updates the LRU order, so we need the
+	// mutex even for reading.
+	KeyType* cached = cache_.object(key);
+	if (cached == 0) {
+		misses_++;
+		return false;
+	}
+	hits_++;
+	result = *cached;
+	return true;
+}
+
+void ResultCache::insert(const QString& key, KeyType result)
+{
+	QMutexLocker locker(&mutex_);
+	cache_.insert(key, new KeyType(result));
+}
+
+void ResultCache::clear()
+{
+	QMutexLocker locker(&mutex_);
+	cache_.clear();
+}
+
+quint64 ResultCache::memoryUsage() const
+{
+	/**
+	 * QCache keeps a hash node per result, which holds the key
+	 * and a node of the LRU list (two links, the pointers to the
+	 * key and the result, the cost), and the result on the heap.
+	 */
+	static const quint64 nodeSize = 2 * sizeof(void*) + sizeof(uint) +
+		sizeof(QString) + 4 * sizeof(void*) + sizeof(int);
+
+	static const quint64 stringHeader = 4 * sizeof(int) + sizeof(void*);
+
+	QMutexLocker locker(&mutex_);
+	quint64 rv = 0;
+	foreach (const QString& key, cache_.keys()) {
+		rv += nodeSize + stringHeader + (key.capacity() + 1) * sizeof(QChar) +
+			sizeof(KeyType);
+	}
+	return rv;
+}
+
+quint64 ResultCache::hits() const
+{
+	QMutexLocker locker(&mutex_);
+	return hits_;
+}
+
+quint64 ResultCache::misses() const
+{
+	QMutexLocker locker(&mutex_);
+	return misses_;
+}
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
@@ -0,0 +1,91 @@
+#ifndef DISTILLER_DICTIONARYIMPL_RESULTCACHE_H
+#define DISTILLER_DICTIONARYIMPL_RESULTCACHE_H
+
+#pragma once
+
+#include <QCache>
+#include <QMutex>
+#include <QString>
+
+#include "Dictionary.h"
+#include "KeyDistTuple.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+/**
+ * Caches the results of Dictionary::find().
+ *
+ * Needles which differ only in case or punctuation have the same
+ * encoded form and thus the same result, so the cache is keyed by
+ * the encoded needle and the options which influence the result.
+ * The keys of the results are cached, queries which found nothing
+ * are cached as well.
+ *
+ * The cache holds at most capacity() results and drops the least
+ * recently used ones. It's disabled by default (capacity 0). All
+ * methods may be called concurrently.
+ */
+class ResultCache
+{
+
+	/// Keys of the results, KeyDistTuple::invalidKey if none.
+	QCache<QString, KeyType> cache_;
+
+	mutable QMutex mutex_;
+
+	quint64 hits_;
+
+	quint64 misses_;
+
+public:
+
+	ResultCache();
+
+	/**
+	 * Returns the cache key of a query.
+	 */
+	static QString key(const QString& encodedNeedle,
+					   const Dictionary::QueryOptions& options);
+
+	/**
+	 * Sets the maximum number of cached results. 0 disables
+	 * the cache.
+	 */
+	void setCapacity(int results);
+
+	int capacity() const;
+
+	bool isEnabled() const;
+
+	/**
+	 * Looks up a result. Returns false on a cache miss.
+	 */
+	bool find(const QString& key, KeyType& result);
+
+	void insert(const QString& key, KeyType result);
+
+	/**
+	 * Drops all results. Called whenever the dictionary changes.
+	 */
+	void clear();
+
+	/**
+	 * Estimated bytes used by the cached results.
+	 */
+	quint64 memoryUsage() const;
+
+	quint64 hits() const;
+
+	quint64 misses() const;
+
+};
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
+
+#endif 
@@ -0,0 +1,44 @@
+#include <core/precompiled.h>
+
+#include "QueryStats.h"
+#include "SearchCounters.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+SearchCounters::SearchCounters()
+{
+	reset();
+}
+
+void SearchCounters::reset()
+{
+	for (int i = 0; i < CounterCount; i++)
+		counters_[i] = 0;
+}
+
+void SearchCounters::merge(const SearchCounters& other)
+{
+	for (int i = 0; i < CounterCount; i++)
+		counters_[i] += other.counters_[i];
+}
+
+void SearchCounters::addTo(Dictionary::QueryStats& stats) const
+{
+	stats.grams += value(Grams);
+	stats.containers += value(Containers);
+	stats.loadedContainers += value(LoadedContainers);
+	stats.postings += value(Postings);
+	stats.sizeRejections += value(SizeRejections);
+	stats.bitRejections += value(BitRejections);
+	stats.histogramRejections += value(HistogramRejections);
+	stats.verifications += value(Verifications);
+	stats.earlyExits += value(EarlyExits);
+}
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
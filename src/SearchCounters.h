@@ -0,0 +1,75 @@
+#ifndef DISTILLER_DICTIONARYIMPL_SEARCHCOUNTERS_H
+#define DISTILLER_DICTIONARYIMPL_SEARCHCOUNTERS_H
+
+#pragma once
+
+#include "Dictionary.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+/**
+ * Counts the work of a single query at every stage of the
+ * search: the grams looked up, the Containers touched, the keys
+ * scanned, the keys rejected by each filter and the edit distance
+ * calculations.
+ *
+ * The counters are plain integers. Every thread of a query
+ * counts into SearchCounters of its own, which are merged once
+ * the thread is done. addTo() copies them into a QueryStats.
+ */
+class SearchCounters
+{
+
+public:
+
+	enum Counter
+	{
+		Grams,
+		Containers,
+		LoadedContainers,
+		Postings,
+		SizeRejections,
+		BitRejections,
+		HistogramRejections,
+		Verifications,
+		EarlyExits,
+		CounterCount
+	};
+
+private:
+
+	quint32 counters_[CounterCount];
+
+public:
+
+	SearchCounters();
+
+	void count(Counter counter)
+		{ counters_[counter]++; }
+
+	quint32 value(Counter counter) const
+		{ return counters_[counter]; }
+
+	void reset();
+
+	/**
+	 * Adds the counters of other.
+	 */
+	void merge(const SearchCounters& other);
+
+	/**
+	 * Adds the counters to the fields of stats.
+	 */
+	void addTo(Dictionary::QueryStats& stats) const;
+
+};
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
+
+#endif 
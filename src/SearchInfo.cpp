@@ -16,7 +16,17 @@ namespace Distiller
 namespace DictionaryImpl
 {
 
-SearchInfo::SearchInfo()
+SearchInfo::SearchInfo() :
+	needle_(),
+	wordlist_(0),
+	bitencodedNeedle_(0),
+	bitpatternList_(0),
+	needleHistogram_(),
+	histogramList_(0),
+	maxTypos_(0),
+	matchType_(EditDistance::SubstringMatch),
+	account_(0),
+	counters_(0)
 { }
 
 SearchInfo::~SearchInfo()
@@ -24,42 +34,85 @@ SearchInfo::~SearchInfo()
 
 bool SearchInfo::sizeDiffersTooMuch(uint key) const
 {
+	return sizeDiffersTooMuch(key, maxTypos_);
+}
+
+bool SearchInfo::sizeDiffersTooMuch(uint key, quint8 bound) const
+{
+	if (matchType_ == EditDistance::PrefixMatch)
+		// Longer entries only add a suffix.
+		return needle_.size() - wordlist_->sizeOf(key) > bound;
 	if (qAbs<int>(needle_.size() - 
-		wordlist_.sizeOf(key)) > maxTypos_)
+		wordlist_->sizeOf(key)) > bound)
 		return true;
 	return false;
 }
 
 bool SearchInfo::editDistanceTooLarge(uint key) const
+{
+	return editDistanceTooLarge(key, maxTypos_);
+}
+
+bool SearchInfo::editDistanceTooLarge(uint key, quint8 bound) const
 {
 	/**
 	 * We gonna estimate the lower bound of the edit
 	 * distance via a fast bitwise algorithm.
 	 */
+	if (matchType_ == EditDistance::PrefixMatch)
+		return BitDistance::minPrefixDistance(bitencodedNeedle_,
+			(*bitpatternList_)[key]) > bound;
 	if (BitDistance::minDistance(bitencodedNeedle_, 
-		bitpatternList_[key]) > maxTypos_)
+		(*bitpatternList_)[key]) > bound)
 		return true;
 	return false;
 }
 
+bool SearchInfo::histogramDistanceTooLarge(uint key, quint8 bound) const
+{
+	const CharHistogram& histogram = (*histogramList_)[key];
+	uint minDistance = (matchType_ == EditDistance::ExactMatch)?
+		CharHistogram::minDistance(needleHistogram_, histogram) :
+		CharHistogram::minSubstringDistance(needleHistogram_, histogram);
+	return minDistance > bound;
+}
+
 quint8 SearchInfo::calcDistance(uint key) const
 {
-	Q_ASSERT(key < (uint)wordlist_.size());
-	Q_ASSERT(key < (uint)bitpatternList_.size());
+	return calcDistance(key, maxTypos_);
+}
+
+quint8 SearchInfo::calcDistance(uint key, quint8 bound) const
+{
+	Q_ASSERT(key < (uint)wordlist_->size());
+	Q_ASSERT(key < (uint)bitpatternList_->size());
+	Q_ASSERT(key < (uint)histogramList_->size());
+	Q_ASSERT(bound <= maxTypos_);
 	
 	DistType dist = KeyDistTuple::invalidDistance;
-	if (sizeDiffersTooMuch(key) == true)
+	count(SearchCounters::Postings);
+	if (sizeDiffersTooMuch(key, bound) == true) {
+		count(SearchCounters::SizeRejections);
+		return dist;
+	}
+	if (editDistanceTooLarge(key, bound) == true) {
+		count(SearchCounters::BitRejections);
 		return dist;
-	if (editDistanceTooLarge(key) == true)
+	}
+	if (histogramDistanceTooLarge(key, bound) == true) {
+		count(SearchCounters::HistogramRejections);
 		return dist;
+	}
+	count(SearchCounters::Verifications);
 	dist = EditDistance::calc(
 				SimpleString(needle_),
-				wordlist_.toSimpleString(key),
-				(int)maxTypos_,
-				EditDistance::SubstringMatch
+				wordlist_->toSimpleString(key),
+				(int)bound,
+				matchType_
 		   );
-	if (dist <= maxTypos_)
+	if (dist <= bound)
 		return dist;
+	count(SearchCounters::EarlyExits);
 	return KeyDistTuple::invalidDistance;
 }
 
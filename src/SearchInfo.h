@@ -7,7 +7,11 @@ class QString;
 
 #include <tagdistiller/StringArray.h>
 
+#include <tagdistiller/EditDistance.h>
+
 #include "BitDistance.h"
+#include "CharHistogram.h"
+#include "SearchCounters.h"
 
 namespace Distiller
 {
@@ -15,18 +19,38 @@ namespace Distiller
 namespace DictionaryImpl
 {
 
+class BudgetAccount;
+
 class SearchInfo
 {
 
 	QString needle_;
 	
-	StringArray wordlist_;
+	/**
+	 * We don't copy the word list and the bit pattern list.
+	 * StringArray is copy-on-write, so holding a copy would
+	 * make every insertion into the dictionary clone the
+	 * whole array.
+	 */
+	const StringArray* wordlist_;
 	
 	quint64 bitencodedNeedle_;
 	
-	BitpatternList bitpatternList_;
+	const BitpatternList* bitpatternList_;
+
+	CharHistogram needleHistogram_;
+
+	const HistogramList* histogramList_;
 	
 	quint8 maxTypos_;
+
+	EditDistance::MatchType matchType_;
+
+	/// Charged for every candidate of the thread, may be 0.
+	BudgetAccount* account_;
+
+	/// Counts the work of the query, may be 0.
+	SearchCounters* counters_;
 	
 	// QReadWriteLock lock_;
 	
@@ -40,26 +64,78 @@ public:
 		{ needle_ = needle; }
 		
 	void setWordlist(const StringArray& wordlist)
-		{ wordlist_ = wordlist; }
+		{ wordlist_ = &wordlist; }
 		
 	void setBitencodedNeedle(quint64 bitencodedNeedle)
 		{ bitencodedNeedle_ = bitencodedNeedle; }
 		
 	void setBitpatternList(const BitpatternList& bitpatternList)
-		{ bitpatternList_ = bitpatternList; }
+		{ bitpatternList_ = &bitpatternList; }
 		
+	void setNeedleHistogram(const CharHistogram& histogram)
+		{ needleHistogram_ = histogram; }
+
+	void setHistogramList(const HistogramList& histogramList)
+		{ histogramList_ = &histogramList; }
+
 	void setMaxTypos(quint8 maxTypos)
 		{ maxTypos_ = maxTypos; }
 	
 	quint8 maxTypos() const
 		{ return maxTypos_; }
+
+	void setMatchType(EditDistance::MatchType matchType)
+		{ matchType_ = matchType; }
+
+	void setAccount(BudgetAccount* account)
+		{ account_ = account; }
+
+	BudgetAccount* account() const
+		{ return account_; }
+
+	void setCounters(SearchCounters* counters)
+		{ counters_ = counters; }
+
+	SearchCounters* counters() const
+		{ return counters_; }
+
+	void count(SearchCounters::Counter counter) const
+		{ if (counters_) counters_->count(counter); }
+
+	/**
+	 * Counts a Container about to be scanned.
+	 */
+	void countContainer(bool loaded) const
+	{
+		count(SearchCounters::Containers);
+		if (loaded == false)
+			count(SearchCounters::LoadedContainers);
+	}
 		
 	bool sizeDiffersTooMuch(uint key) const;
 	
+	bool sizeDiffersTooMuch(uint key, quint8 bound) const;
+	
 	bool editDistanceTooLarge(uint key) const;
+	
+	bool editDistanceTooLarge(uint key, quint8 bound) const;
+
+	/**
+	 * Estimates the lower bound of the edit distance by the
+	 * character histograms. It catches repeated characters which
+	 * editDistanceTooLarge() misses, but not every key that one
+	 * rejects, and it is a bit more expensive.
+	 */
+	bool histogramDistanceTooLarge(uint key, quint8 bound) const;
 		
 	quint8 calcDistance(uint key) const;
 
+	/**
+	 * Like calcDistance(key), but gives up as soon as the distance
+	 * exceeds bound (bound must not exceed maxTypos()).
+	 */
+	quint8 calcDistance(uint key, quint8 bound) const;
+
 };
 
 } // namespace DictionaryImpl
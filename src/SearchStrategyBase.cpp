@@ -4,6 +4,12 @@
 #include "Private.h"
 #include "DebugInfo.h"
 #include "BitDistance.h"
+#include "TopKCollector.h"
+#include "KeyDistTuple.h"
+#include "AbstractMatchHandler.h"
+#include "QueryOptions.h"
+#include "QueryStats.h"
+#include "BudgetAccount.h"
 #include "SearchStrategyBase.h"
 
 namespace Distiller
@@ -20,20 +26,36 @@ SearchStrategyBase::SearchStrategyBase(Private& d) :
 	gramJump_(0),
 	gramLen_(0),
 	gramCount_(0),
-	searchInfo_()
+	searchInfo_(),
+	counters_(),
+	candidates_(0),
+	countersLock_()
 { }
 
 SearchStrategyBase::~SearchStrategyBase()
 { }
 
 void SearchStrategyBase::calculate(const QString& needle)
+{
+	calculate(needle, Dictionary::QueryOptions());
+}
+
+void SearchStrategyBase::calculate(const QString& needle,
+								   const Dictionary::QueryOptions& options)
+{
+	calculateEncoded(d_.encode(needle), options);
+}
+
+void SearchStrategyBase::calculateEncoded(const QString& encodedNeedle,
+										  const Dictionary::QueryOptions& options)
 {
 
 	// Encoded needle.
-	encodedNeedle_ = d_.encode(needle);
+	encodedNeedle_ = encodedNeedle;
 	
 	// Bit encoded needle.
-	bitencodedNeedle_ = BitDistance::bitPattern(encodedNeedle_.toAscii().constData());
+	bitencodedNeedle_ = BitDistance::bitPattern(encodedNeedle_.unicode(),
+		encodedNeedle_.size());
 
 	// Lenth of encoded needle.
 	encNeedleSize_ = encodedNeedle_.size();
@@ -42,7 +64,7 @@ void SearchStrategyBase::calculate(const QString& needle)
 		return;
 	
 	// Maximum number of typos for needle.
-	maxTypos_ = d_.calcMaxTypos(needle);
+	maxTypos_ = d_.calcMaxTyposEncoded(encodedNeedle_, options);
 	
 	// Number of characters to jump forward for next gram.
 	gramJump_ = encNeedleSize_ / (maxTypos_ + 1);
@@ -51,15 +73,190 @@ void SearchStrategyBase::calculate(const QString& needle)
 	gramLen_ = qMin<quint16>(gramJump_, d_.maxGramSize());
 	
 	// Number of grams.
-	gramCount_ = encNeedleSize_ / gramLen_;
+	gramCount_ = (gramLen_ > 0)? encNeedleSize_ / gramLen_ : 0;
 
 	// Set infos for searching.	
 	searchInfo_.setNeedle(encodedNeedle_);
 	searchInfo_.setBitencodedNeedle(bitencodedNeedle_);
 	searchInfo_.setWordlist(d_.encodedEntries_);
 	searchInfo_.setBitpatternList(d_.bitencodedEntries_);
+	searchInfo_.setNeedleHistogram(CharHistogram(encodedNeedle_.unicode(),
+		encodedNeedle_.size()));
+	searchInfo_.setHistogramList(d_.histograms_);
 	searchInfo_.setMaxTypos(maxTypos_);
+	searchInfo_.setMatchType(options.matchType);
+
+}
+
+void SearchStrategyBase::startCounting()
+{
+	counters_.reset();
+	candidates_ = 0;
+	bool counting = Profiler::enabled() ||
+		d_.slowQueryLog_.postingsThreshold() > 0;
+	searchInfo_.setCounters(counting? &counters_ : 0);
+}
+
+void SearchStrategyBase::mergeCounters(const SearchCounters* counters,
+									   uint candidates)
+{
+	QMutexLocker locker(&countersLock_);
+	if (counters != 0)
+		counters_.merge(*counters);
+	candidates_ += candidates;
+}
+
+void SearchStrategyBase::stopCounting(Dictionary::QueryStats& stats)
+{
+	searchInfo_.setCounters(0);
+	counters_.addTo(stats);
+	stats.candidates = candidates_;
+	stats.queries = 1;
+	d_.addSearchStats(stats);
+}
+
+QStringList SearchStrategyBase::searchGrams() const
+{
+	QStringList rv;
+	int restLen = encNeedleSize_;
+	for (int i = 0; i < gramCount_; i++) {
+		QString gram = encodedNeedle_.mid(i * gramJump_, gramLen_);
+		restLen -= gramJump_;
+		if (i == (gramCount_ - 1) && restLen > 0)
+			gram = encodedNeedle_.mid(i * gramJump_, 
+				d_.gramHash_.maxGramSize());
+		rv.append(gram);
+	}
+	return rv;
+}
+
+bool SearchStrategyBase::piecesTooShort() const
+{
+	return static_cast<quint32>(gramLen_) < d_.minGramSize();
+}
+
+KeyDistTuple SearchStrategyBase::scanKeys(const SearchInfo& searchInfo)
+{
+	KeyDistTuple rv;
+	BudgetAccount* account = searchInfo.account();
+	KeyType size = d_.encodedEntries_.size();
+	for (KeyType key = 0; key < size; key++) {
+		if (d_.isIndexed(key) == false)
+			continue;
+		if (account != 0 && account->charge() == false)
+			// Out of budget, return the best match so far.
+			break;
+		DistType dist = searchInfo.calcDistance(key);
+		if (dist < rv.distance())
+			rv.set(key, dist);
+		if (dist == 0)
+			break;
+	}
+	return rv;
+}
+
+void SearchStrategyBase::scanKeys(const SearchInfo& searchInfo,
+								  TopKCollector& collector)
+{
+	BudgetAccount* account = searchInfo.account();
+	KeyType size = d_.encodedEntries_.size();
+	for (KeyType key = 0; key < size && collector.isComplete() == false;
+		 key++)
+	{
+		if (d_.isIndexed(key) == false)
+			continue;
+		if (account != 0 && account->charge() == false)
+			break;
+		DistType dist = searchInfo.calcDistance(key, collector.bound());
+		if (dist != KeyDistTuple::invalidDistance)
+			collector.offer(key, dist);
+	}
+}
+
+void SearchStrategyBase::collectKeys(const QString& gram,
+									 const SearchInfo& searchInfo,
+									 TopKCollector& collector)
+{
+	searchInfo.count(SearchCounters::Grams);
+	const Private::Value node = d_.gramHash_[gram];
+	for (Private::Value::const_iterator i = node.constBegin();
+	     i != node.constEnd(); i++)
+	{
+		(*i)->collect(searchInfo, collector);
+		if (collector.isComplete())
+			break;
+	}
+}
+
+bool SearchStrategyBase::visitKey(KeyType key, AbstractMatchHandler& handler)
+{
+	DistType dist = searchInfo_.calcDistance(key);
+	if (dist == KeyDistTuple::invalidDistance)
+		return true;
+	return handler.handle(key, dist, d_.entries_.toQString(key));
+}
+
+bool SearchStrategyBase::visitKeys(
+	const Private::Value::PtrToContainer& container,
+	QSet<KeyType>& visited, AbstractMatchHandler& handler)
+{
+	searchInfo_.countContainer(container->isLoaded());
+	// Don't hold the Container's lock while the handler runs.
+	QVector<KeyType> keys = container->keys();
+	for (QVector<KeyType>::const_iterator i = keys.constBegin();
+		 i != keys.constEnd(); i++)
+	{
+		if (visited.contains(*i))
+			continue;
+		visited.insert(*i);
+		if (visitKey(*i, handler) == false)
+			return false;
+	}
+	return true;
+}
+
+void SearchStrategyBase::searchWithin(const QString& needle,
+									  const Dictionary::QueryOptions& options,
+									  AbstractMatchHandler& handler)
+{
+	calculate(needle, options);
+	
+	if (encNeedleSize_ == 0)
+		return;
+
+	Dictionary::QueryStats stats;
+	startCounting();
+	visitCandidates(handler);
+	stopCounting(stats);
+}
+
+void SearchStrategyBase::visitCandidates(AbstractMatchHandler& handler)
+{
+	if (piecesTooShort()) {
+		// At least one piece of the needle occurs without errors,
+		// but the pieces are too short to be looked up.
+		KeyType size = d_.encodedEntries_.size();
+		for (KeyType key = 0; key < size; key++) {
+			if (d_.isIndexed(key) && visitKey(key, handler) == false)
+				return;
+		}
+		return;
+	}
 
+	// A key is reachable through several grams. Only the keys of
+	// the looked-up Containers are remembered, so the query costs
+	// nothing per entry of the dictionary.
+	QSet<KeyType> visited;
+	foreach (const QString& gram, searchGrams()) {
+		searchInfo_.count(SearchCounters::Grams);
+		const Private::Value node = d_.gramHash_[gram];
+		for (Private::Value::const_iterator i = node.constBegin();
+			 i != node.constEnd(); i++)
+		{
+			if (visitKeys(*i, visited, handler) == false)
+				return;
+		}
+	}
 }
 
 } // namespace DictionaryImpl
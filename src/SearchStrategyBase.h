@@ -3,9 +3,14 @@
 
 #pragma once
 
+#include <QSet>
+#include <QMutex>
+
 #include "AbstractSearchStrategy.h"
 #include "SearchInfo.h"
+#include "SearchCounters.h"
 #include "Dictionary.h"
+#include "Private.h"
 
 namespace Distiller
 {
@@ -13,6 +18,8 @@ namespace Distiller
 namespace DictionaryImpl
 {
 
+class TopKCollector;
+
 class SearchStrategyBase : public AbstractSearchStrategy
 {
 
@@ -45,13 +52,114 @@ protected:
 	/// Grouped data for searching.
 	SearchInfo searchInfo_;
 
+	/// Counts the work of the running query.
+	SearchCounters counters_;
+
+	/// Candidates verified by the running query.
+	uint candidates_;
+
+	/// Serializes mergeCounters() by the threads of a query.
+	QMutex countersLock_;
+
 	void calculate(const QString& needle);
 
+	/**
+	 * Calculates the members above for a query with the
+	 * given options.
+	 */
+	void calculate(const QString& needle,
+				   const Dictionary::QueryOptions& options);
+
+	/**
+	 * Same as calculate() for a needle which is encoded already.
+	 */
+	void calculateEncoded(const QString& encodedNeedle,
+						  const Dictionary::QueryOptions& options);
+
+	/**
+	 * Resets the counters and hands them to searchInfo_, if the
+	 * work is counted at all: while profiling is switched on
+	 * (see Profiler::enabled()) or the slow query log has a
+	 * postings threshold.
+	 */
+	void startCounting();
+
+	/**
+	 * Adds the counters of a thread of the query to counters_,
+	 * if it counted at all, and its candidates to candidates_.
+	 */
+	void mergeCounters(const SearchCounters* counters, uint candidates);
+
+	/**
+	 * Adds the counters and the candidates of the query to stats
+	 * and stats to the totals of the dictionary.
+	 */
+	void stopCounting(Dictionary::QueryStats& stats);
+
+	/**
+	 * Returns the grams of the needle which are looked up.
+	 * Call calculate() first.
+	 */
+	QStringList searchGrams() const;
+
+	/**
+	 * Returns true if the pieces of the needle are shorter than
+	 * minGramSize(), e.g. for a large maxTypos. They can't be
+	 * looked up then, so every key has to be scanned.
+	 * Call calculate() first.
+	 */
+	bool piecesTooShort() const;
+
+	/**
+	 * Finds the best match by scanning every indexed key.
+	 */
+	KeyDistTuple scanKeys(const SearchInfo& searchInfo);
+
+	/**
+	 * Offers every indexed key to collector.
+	 */
+	void scanKeys(const SearchInfo& searchInfo, TopKCollector& collector);
+
+	/**
+	 * Offers the keys of all Containers of gram to collector.
+	 */
+	void collectKeys(const QString& gram, const SearchInfo& searchInfo,
+					 TopKCollector& collector);
+
+	/**
+	 * Hands key to handler if it is within maxTypos_. Returns
+	 * false if the handler stopped the query.
+	 */
+	bool visitKey(KeyType key, AbstractMatchHandler& handler);
+
+	/**
+	 * Hands every key of container within maxTypos_ to handler.
+	 * Keys in visited are skipped, the others are added.
+	 * Returns false if the handler stopped the query.
+	 */
+	bool visitKeys(const Private::Value::PtrToContainer& container,
+				   QSet<KeyType>& visited, AbstractMatchHandler& handler);
+
+	/**
+	 * Hands every key within maxTypos_ to handler, until the
+	 * handler stops the query. Call calculate() first.
+	 */
+	void visitCandidates(AbstractMatchHandler& handler);
+
 public:
 
 	SearchStrategyBase(Private& d);
 	
 	virtual ~SearchStrategyBase();
+
+	/**
+	 * Looks up the grams of the needle, cut into options.maxTypos + 1
+	 * pieces. If the pieces are shorter than minGramSize() the index
+	 * can't help and every indexed key is scanned.
+	 */
+	void searchWithin(const QString& needle,
+					  const Dictionary::QueryOptions& options,
+					  AbstractMatchHandler& handler);
 	
 };
 
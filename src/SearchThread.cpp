@@ -4,6 +4,12 @@
 #include "ThreadedSearchStrategy.h"
 #include "KeyDistTuple.h"
 #include "SharedThreadData.h"
+#include "TopKCollector.h"
+#include "QueryBudget.h"
+#include "BudgetAccount.h"
+#include "QueryTrace.h"
+#include "SearchInfo.h"
+#include "SearchCounters.h"
 #include "SearchThread.h"
 
 namespace Distiller
@@ -19,7 +25,43 @@ SearchThread::SearchThread(ThreadedSearchStrategy& d,
 	data_(data)
 { }
 
+void SearchThread::collect(const SearchInfo& searchInfo,
+						   TopKCollector& collector)
+{
+	QString gram;
+	while ((gram = data_.nextGram()) != QString())
+	{
+		d_.collectKeys(gram, searchInfo, collector);
+		if (collector.isComplete()) {
+			// k exact matches found.
+			data_.clearGramQueue();
+			break;
+		}
+	}
+}
+
 void SearchThread::run()
+{
+	// Counting into counters shared with the other threads would
+	// make them contend for every key.
+	// The same goes for the budget.
+	SearchInfo searchInfo(d_.searchInfo_);
+	SearchCounters counters;
+	bool counting = (searchInfo.counters() != 0);
+	if (counting)
+		searchInfo.setCounters(&counters);
+	BudgetAccount account(data_.budget_);
+	searchInfo.setAccount(&account);
+
+	if (data_.collector_ != 0)
+		collect(searchInfo, *data_.collector_);
+	else
+		search(searchInfo);
+
+	d_.mergeCounters(counting? &counters : 0, account.candidates());
+}
+
+void SearchThread::search(const SearchInfo& searchInfo)
 {
 	KeyDistTuple bestMatch;
 	KeyDistTuple match;
@@ -30,7 +72,14 @@ void SearchThread::run()
 		if (data_.bestMatchFound() == true)
 			// Best match already found by another Thread.
 			return;
-		match = d_.searchBestKey(gram, data_.debugInfo_);
+		if (data_.budget_ != 0 && data_.budget_->exhausted()) {
+			// Out of budget, hand in the best match found so far.
+			data_.budget_->setTruncated();
+			break;
+		}
+		match = d_.searchBestKey(gram, searchInfo, data_.debugInfo_);
+		if (data_.trace_ != 0)
+			data_.trace_->add(gram, match);
 		if (data_.bestMatchFound() == true)
 			// Best match already found by another Thread.
 			return;
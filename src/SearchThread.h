@@ -13,6 +13,10 @@ class ThreadedSearchStrategy;
 
 class SharedThreadData;
 
+class SearchInfo;
+
+class TopKCollector;
+
 /**
  * When querying the dictionary we use a thread for finding the
  * best match for a given gram. Doing so we can parallelize the 
@@ -24,6 +28,16 @@ class SearchThread : public QThread
 	ThreadedSearchStrategy& d_;
 	
 	SharedThreadData& data_;
+
+	/**
+	 * Offers the keys of the grams to collector.
+	 */
+	void collect(const SearchInfo& searchInfo, TopKCollector& collector);
+
+	/**
+	 * Hands the best match of the grams to the shared data.
+	 */
+	void search(const SearchInfo& searchInfo);
 	
 public:
 
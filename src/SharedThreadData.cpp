@@ -13,7 +13,10 @@ namespace DictionaryImpl
 SharedThreadData::SharedThreadData() :
 	maxTypos_(0),
 	bestMatchFound_(false),
-	debugInfo_(0)
+	debugInfo_(0),
+	collector_(0),
+	budget_(0),
+	trace_(0)
 { }
 	
 void SharedThreadData::clear()
@@ -27,6 +30,9 @@ void SharedThreadData::clear()
 	QWriteLocker locker3(&bestMatchLock_);
 	bestMatchFound_ = false;
 	debugInfo_ = 0;
+	collector_ = 0;
+	budget_ = 0;
+	trace_ = 0;
 }
 
 void SharedThreadData::clearGramQueue()
@@ -15,6 +15,12 @@ namespace DictionaryImpl
 
 class KeyDistTuple;
 
+class TopKCollector;
+
+class QueryBudget;
+
+class QueryTrace;
+
 /**
  * Stores the data that is shared among SearchThreads
  * and manages accesss to it's members through Mutexes.
@@ -45,6 +51,15 @@ class SharedThreadData
 public:
 
 	Dictionary::DebugInfo* debugInfo_;
+
+	/// Set while searching for the top k matches.
+	TopKCollector* collector_;
+
+	/// Limits the query, 0 if it isn't limited.
+	QueryBudget* budget_;
+
+	/// Records the best match of every gram, may be 0.
+	QueryTrace* trace_;
 	
 	SharedThreadData();
 		
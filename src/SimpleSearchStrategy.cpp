@@ -5,6 +5,12 @@
 #include "KeyDistTuple.h"
 #include "Private.h"
 #include "SearchInfo.h"
+#include "TopKCollector.h"
+#include "QueryOptions.h"
+#include "QueryStats.h"
+#include "QueryBudget.h"
+#include "BudgetAccount.h"
+#include "QueryTrace.h"
 #include "SimpleSearchStrategy.h"
 
 namespace Distiller
@@ -31,12 +37,14 @@ KeyDistTuple SimpleSearchStrategy::searchBestKey(const QString& gram,
 	KeyDistTuple rv;
 	KeyDistTuple match;
 
-	if (d_.gramHash_.contains(gram) == false)
+	searchInfo_.count(SearchCounters::Grams);
+	// One lookup of the range of Containers.
+	const Private::Value node = d_.gramHash_[gram];
+	if (node.isEmpty())
 		return rv;
 		
-	for(Private::Value::const_iterator i = 
-		d_.gramHash_[gram].constBegin();
-	    i != d_.gramHash_[gram].constEnd(); i++)
+	for(Private::Value::const_iterator i = node.constBegin();
+	    i != node.constEnd(); i++)
 	{
 		match = (*i)->find(searchInfo_);
 		if (match < rv)
@@ -49,7 +57,7 @@ KeyDistTuple SimpleSearchStrategy::searchBestKey(const QString& gram,
 	if (debugInfo) {
 		Dictionary::DebugInfo::GramInfo gramInfo;
 		gramInfo.gram = gram;
-		gramInfo.entries = d_.gramHash_[gram].valueCount();
+		gramInfo.entries = node.valueCount();
 		gramInfo.editdistance = rv.second;
 		if (rv.keyIsValid())
 			gramInfo.bestMatch = d_.entries_.toQString(rv.key());
@@ -62,18 +70,57 @@ KeyDistTuple SimpleSearchStrategy::searchBestKey(const QString& gram,
 
 QString SimpleSearchStrategy::search(const QString& needle, Dictionary::DebugInfo* debugInfo)
 {
-	IF_PROFILER(d_.profiler.queryTimer.restart());
+	return search(needle, Dictionary::QueryOptions(), 0, debugInfo);
+}
+
+QString SimpleSearchStrategy::search(const QString& needle,
+									 const Dictionary::QueryOptions& options,
+									 Dictionary::QueryStats* stats,
+									 Dictionary::DebugInfo* debugInfo)
+{
+	KeyDistTuple match = searchKey(d_.encode(needle), options, stats,
+		debugInfo);
+	if (match.keyIsValid())
+		return d_.entries_.toQString(match.key());
+	return QString();
+}
+
+KeyDistTuple SimpleSearchStrategy::searchKey(const QString& encodedNeedle,
+											 const Dictionary::QueryOptions& options,
+											 Dictionary::QueryStats* stats,
+											 Dictionary::DebugInfo* debugInfo,
+											 QueryTrace* trace)
+{
+	IF_PROFILER(ProfilerTimer timer(&d_.profiler, Profiler::Query));
+
+	if (stats)
+		*stats = Dictionary::QueryStats();
 
-	calculate(needle);
+	calculateEncoded(encodedNeedle, options);
 	
 	if (encNeedleSize_ == 0)
-		return QString();
+		return KeyDistTuple();
+
+	QueryBudget budget(options);
+	BudgetAccount account(budget.isLimited()? &budget : 0);
+	searchInfo_.setAccount(&account);
+	startCounting();
 
 	int restLen = encNeedleSize_;
 	KeyDistTuple bestMatch;
 	KeyDistTuple tmpMatch;
 
-	for (int i = 0; i < gramCount_; i++) {
+	// With too many typos for the gram index every key is scanned.
+	int gramCount = piecesTooShort()? 0 : gramCount_;
+	if (gramCount == 0)
+		bestMatch = scanKeys(searchInfo_);
+
+	for (int i = 0; i < gramCount; i++) {
+		if (i > 0 && account.exhausted()) {
+			// Return the best match found so far.
+			budget.setTruncated();
+			break;
+		}
 		QString gram = encodedNeedle_.mid(i * gramJump_, gramLen_);
 		restLen -= gramJump_;
 		if (i == (gramCount_ - 1) && restLen > 0)
@@ -81,17 +128,24 @@ QString SimpleSearchStrategy::search(const QString& needle, Dictionary::DebugInf
 				d_.gramHash_.maxGramSize()
 			);
 		tmpMatch = searchBestKey(gram, debugInfo);
+		if (trace)
+			trace->add(gram, tmpMatch);
 		if (tmpMatch < bestMatch)
 			bestMatch = tmpMatch;
 		if (tmpMatch.distance() == 0)
 			// Optimum found.
 			break;
 	}
-	
-	IF_PROFILER(d_.profiler.querytime += d_.profiler.queryTimer.elapsed());
-	IF_PROFILER(d_.profiler.queries++);
-	IF_PROFILER(d_.profiler.queriesPerSec = 
-		(((double)d_.profiler.queries * 1000.0)/d_.profiler.querytime));
+
+	searchInfo_.setAccount(0);
+	mergeCounters(0, account.candidates());
+	Dictionary::QueryStats queryStats;
+	queryStats.truncated = budget.isTruncated();
+	if (bestMatch.keyIsValid())
+		queryStats.distance = bestMatch.distance();
+	stopCounting(queryStats);
+	if (stats)
+		*stats = queryStats;
 	
 #ifdef DICTIONARY_WITH_DEBUGINFO
 	if (debugInfo) {
@@ -104,10 +158,37 @@ QString SimpleSearchStrategy::search(const QString& needle, Dictionary::DebugInf
 	}
 #endif
 
-	// bestMatch holds the best KeyDistTuple.
-	if (bestMatch.keyIsValid())
-		return d_.entries_.toQString(bestMatch.key());
-	return QString();
+	return bestMatch;
+}
+
+QList<KeyDistTuple> SimpleSearchStrategy::searchTopK(const QString& encodedNeedle,
+													 int k)
+{
+	calculateEncoded(encodedNeedle, Dictionary::QueryOptions());
+	
+	if (encNeedleSize_ == 0 || k <= 0)
+		return QList<KeyDistTuple>();
+
+	TopKCollector collector(k, maxTypos_);
+	BudgetAccount account;
+	searchInfo_.setAccount(&account);
+	startCounting();
+	if (piecesTooShort())
+		// Too many typos for the gram index.
+		scanKeys(searchInfo_, collector);
+	else {
+		foreach (const QString& gram, searchGrams()) {
+			collectKeys(gram, searchInfo_, collector);
+			if (collector.isComplete())
+				// k exact matches found.
+				break;
+		}
+	}
+	searchInfo_.setAccount(0);
+	mergeCounters(0, account.candidates());
+	Dictionary::QueryStats stats;
+	stopCounting(stats);
+	return collector.results();
 }
 
 } // namespace DictionaryImpl
@@ -30,6 +30,19 @@ public:
 	QString search(const QString& needle,
 				   Dictionary::DebugInfo* debugInfo);
 
+	QString search(const QString& needle,
+				   const Dictionary::QueryOptions& options,
+				   Dictionary::QueryStats* stats,
+				   Dictionary::DebugInfo* debugInfo);
+
+	KeyDistTuple searchKey(const QString& encodedNeedle,
+						   const Dictionary::QueryOptions& options,
+						   Dictionary::QueryStats* stats,
+						   Dictionary::DebugInfo* debugInfo,
+						   QueryTrace* trace = 0);
+
+	QList<KeyDistTuple> searchTopK(const QString& encodedNeedle, int k);
+
 };
 
 } // namespace DictionaryImpl
@@ -0,0 +1,39 @@
+#include <core/precompiled.h>
+
+#include "DictionaryDefines.h"
+#include "SlowQuery.h"
+
+namespace Distiller
+{
+
+Dictionary::SlowQuery::SlowQuery() :
+	time(),
+	encodedNeedle(),
+	nsecs(0),
+	stats(),
+	debugInfo()
+{ }
+
+std::ostream& operator << (std::ostream& out, const Dictionary::SlowQuery& rhs)
+{
+	out << "SLOW QUERY:     " << rhs.time.toString(Qt::ISODate).toAscii().constData() << std::endl;
+	out << "encoded Query:  " << rhs.encodedNeedle.toUtf8().constData() << std::endl;
+	out << "usecs:          " << rhs.nsecs / 1000 << std::endl;
+	out << "truncated:      " << (rhs.stats.truncated? "true" : "false") << std::endl;
+	out << "distance:       " << rhs.stats.distance << std::endl;
+	out << "grams:          " << rhs.stats.grams << std::endl;
+	out << "containers:     " << rhs.stats.containers
+		<< " (" << rhs.stats.loadedContainers << " loaded)" << std::endl;
+	out << "postings:       " << rhs.stats.postings << std::endl;
+	out << "rejected size:  " << rhs.stats.sizeRejections << std::endl;
+	out << "rejected bits:  " << rhs.stats.bitRejections << std::endl;
+	out << "rejected hist:  " << rhs.stats.histogramRejections << std::endl;
+	out << "verifications:  " << rhs.stats.verifications
+		<< " (" << rhs.stats.earlyExits << " early exits)" << std::endl;
+#ifdef DICTIONARY_WITH_DEBUGINFO
+	out << rhs.debugInfo;
+#endif
+	return out;
+}
+
+} // namespace Distiller
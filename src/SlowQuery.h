@@ -0,0 +1,49 @@
+#ifndef DISTILLER_DICTIONARYIMPL_SLOWQUERY_H
+#define DISTILLER_DICTIONARYIMPL_SLOWQUERY_H
+
+#pragma once
+
+#include <QDateTime>
+
+#include "Dictionary.h"
+#include "DebugInfo.h"
+#include "QueryStats.h"
+
+namespace Distiller
+{
+
+/**
+ * A query recorded by the slow query log, see
+ * Dictionary::setSlowQueryThreshold().
+ */
+class Dictionary::SlowQuery
+{
+
+public:
+
+	/// When the query has been answered.
+	QDateTime time;
+
+	QString encodedNeedle;
+
+	/// Duration of the query in nanoseconds.
+	qint64 nsecs;
+
+	QueryStats stats;
+
+	/**
+	 * The DebugInfo of the query. While the log is enabled every
+	 * query records the best match of each gram it looks up, the
+	 * strings are only built for the queries which are logged.
+	 */
+	DebugInfo debugInfo;
+
+	SlowQuery();
+
+	friend std::ostream& operator << (std::ostream& out, const SlowQuery& rhs);
+
+};
+
+} // namespace Distiller
+
+#endif 
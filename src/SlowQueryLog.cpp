@@ -0,0 +1,99 @@
+#include <core/precompiled.h>
+
+#include "SlowQueryLog.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+SlowQueryLog::SlowQueryLog() :
+	queries_(),
+	next_(0),
+	size_(0),
+	latency_(0),
+	postings_(0),
+	enabled_(0),
+	mutex_()
+{ }
+
+void SlowQueryLog::updateEnabled()
+{
+	enabled_ = (queries_.size() > 0 && (latency_ > 0 || postings_ > 0))? 1 : 0;
+}
+
+void SlowQueryLog::setCapacity(int queries)
+{
+	QMutexLocker locker(&mutex_);
+	queries_ = QVector<Dictionary::SlowQuery>(qMax(queries, 0));
+	next_ = 0;
+	size_ = 0;
+	updateEnabled();
+}
+
+int SlowQueryLog::capacity() const
+{
+	QMutexLocker locker(&mutex_);
+	return queries_.size();
+}
+
+void SlowQueryLog::setThresholds(qint64 nsecs, quint64 postings)
+{
+	QMutexLocker locker(&mutex_);
+	latency_ = qMax<qint64>(nsecs, 0);
+	postings_ = postings;
+	updateEnabled();
+}
+
+qint64 SlowQueryLog::latencyThreshold() const
+{
+	QMutexLocker locker(&mutex_);
+	return latency_;
+}
+
+quint64 SlowQueryLog::postingsThreshold() const
+{
+	QMutexLocker locker(&mutex_);
+	return postings_;
+}
+
+bool SlowQueryLog::isSlow(qint64 nsecs,
+						  const Dictionary::QueryStats& stats) const
+{
+	QMutexLocker locker(&mutex_);
+	return (latency_ > 0 && nsecs >= latency_) ||
+		(postings_ > 0 && stats.postings >= postings_);
+}
+
+void SlowQueryLog::append(const Dictionary::SlowQuery& query)
+{
+	QMutexLocker locker(&mutex_);
+	if (queries_.isEmpty())
+		return;
+	queries_[next_] = query;
+	next_ = (next_ + 1) % queries_.size();
+	size_ = qMin(size_ + 1, queries_.size());
+}
+
+QList<Dictionary::SlowQuery> SlowQueryLog::queries() const
+{
+	QMutexLocker locker(&mutex_);
+	QList<Dictionary::SlowQuery> rv;
+	int first = (next_ - size_ + queries_.size()) % qMax(queries_.size(), 1);
+	for (int i = 0; i < size_; i++)
+		rv.append(queries_[(first + i) % queries_.size()]);
+	return rv;
+}
+
+void SlowQueryLog::clear()
+{
+	QMutexLocker locker(&mutex_);
+	queries_.fill(Dictionary::SlowQuery());
+	next_ = 0;
+	size_ = 0;
+}
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
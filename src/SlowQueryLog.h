@@ -0,0 +1,97 @@
+#ifndef DISTILLER_DICTIONARYIMPL_SLOWQUERYLOG_H
+#define DISTILLER_DICTIONARYIMPL_SLOWQUERYLOG_H
+
+#pragma once
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QVector>
+
+#include "Dictionary.h"
+#include "SlowQuery.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+/**
+ * Ring buffer of the last capacity() queries which took longer
+ * than a latency threshold or scanned more keys than a postings
+ * threshold.
+ *
+ * isEnabled() is a single atomic read, so queries pay nothing
+ * else while the log is disabled (the default). All methods may
+ * be called concurrently.
+ */
+class SlowQueryLog
+{
+
+	QVector<Dictionary::SlowQuery> queries_;
+
+	/// Position of the next record in queries_.
+	int next_;
+
+	/// Number of records in queries_.
+	int size_;
+
+	/// 0 disables the threshold.
+	qint64 latency_;
+
+	/// 0 disables the threshold.
+	quint64 postings_;
+
+	QAtomicInt enabled_;
+
+	mutable QMutex mutex_;
+
+	void updateEnabled();
+
+public:
+
+	SlowQueryLog();
+
+	/**
+	 * Sets the number of queries kept. Drops the records.
+	 */
+	void setCapacity(int queries);
+
+	int capacity() const;
+
+	/**
+	 * A query is slow if it took at least nsecs or scanned at
+	 * least postings keys. 0 disables a threshold.
+	 */
+	void setThresholds(qint64 nsecs, quint64 postings);
+
+	qint64 latencyThreshold() const;
+
+	quint64 postingsThreshold() const;
+
+	bool isEnabled() const
+		{ return static_cast<int>(enabled_) != 0; }
+
+	bool isSlow(qint64 nsecs, const Dictionary::QueryStats& stats) const;
+
+	/**
+	 * Appends a query, overwriting the oldest one if the log
+	 * is full.
+	 */
+	void append(const Dictionary::SlowQuery& query);
+
+	/**
+	 * Returns the recorded queries, oldest first.
+	 */
+	QList<Dictionary::SlowQuery> queries() const;
+
+	void clear();
+
+};
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
+
+#endif 
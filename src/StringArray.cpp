@@ -338,6 +338,14 @@ int StringArray::sizeOf(unsigned int pos) const
 	return d_->strSize_[pos];
 }
 
+quint64 StringArray::memoryUsage() const
+{
+	return sizeof(Private) +
+		(quint64)d_->dataSize_ * sizeof(QChar) +
+		(quint64)d_->posSize_ * sizeof(unsigned int) +
+		(quint64)d_->strSizeSize_ * sizeof(unsigned int);
+}
+
 bool StringArray::isEqual(const QString& str, unsigned int pos) const
 {
 	Q_ASSERT(pos < d_->size_);
@@ -98,6 +98,12 @@ public:
 	 */
 	int sizeOf(unsigned int pos) const;	
 
+	/**
+	 * Number of bytes allocated by the array. Arrays which share
+	 * their data (copy-on-write) report the same memory.
+	 */
+	quint64 memoryUsage() const;
+
 	/** 
 	 * Loads StringArray from QDataStream.
 	 *
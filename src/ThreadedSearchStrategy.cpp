@@ -5,6 +5,11 @@
 #include "Private.h"
 #include "SearchThread.h"
 #include "SearchInfo.h"
+#include "TopKCollector.h"
+#include "QueryOptions.h"
+#include "QueryStats.h"
+#include "QueryBudget.h"
+#include "BudgetAccount.h"
 #include "ThreadedSearchStrategy.h"
 
 namespace Distiller
@@ -66,6 +71,7 @@ QString ThreadedSearchStrategy::search(const QString& needle)
 
 KeyDistTuple ThreadedSearchStrategy::searchBestKey(
 	const QString& gram,
+	const SearchInfo& searchInfo,
 	Dictionary::DebugInfo* debugInfo
 )
 {
@@ -74,14 +80,16 @@ KeyDistTuple ThreadedSearchStrategy::searchBestKey(
 	KeyDistTuple rv;
 	KeyDistTuple match;
 	
-	if (d_.gramHash_.contains(gram) == false)
+	searchInfo.count(SearchCounters::Grams);
+	// One lookup of the range of Containers.
+	const Private::Value node = d_.gramHash_[gram];
+	if (node.isEmpty())
 		return rv;
 		
-	for(Private::Value::const_iterator i = 
-		d_.gramHash_[gram].constBegin();
-	    i != d_.gramHash_[gram].constEnd(); i++)
+	for(Private::Value::const_iterator i = node.constBegin();
+	    i != node.constEnd(); i++)
 	{
-		match = (*i)->find(searchInfo_);
+		match = (*i)->find(searchInfo);
 		if (match < rv)
 			rv = match;
 		if (match.distance() == 0)
@@ -93,7 +101,7 @@ KeyDistTuple ThreadedSearchStrategy::searchBestKey(
 		QWriteLocker locker(&debugInfoLock_);
 		Dictionary::DebugInfo::GramInfo gramInfo;
 		gramInfo.gram = gram;
-		gramInfo.entries = d_.gramHash_[gram].valueCount();
+		gramInfo.entries = node.valueCount();
 		gramInfo.editdistance = rv.second;
 		if (rv.keyIsValid())
 			gramInfo.bestMatch = d_.entries_.toQString(rv.key());
@@ -125,25 +133,72 @@ void ThreadedSearchStrategy::prepareSearch()
 QString ThreadedSearchStrategy::search(const QString& needle,
 									   Dictionary::DebugInfo* debugInfo)
 {
-	IF_PROFILER(d_.profiler.queryTimer.restart());
+	return search(needle, Dictionary::QueryOptions(), 0, debugInfo);
+}
 
-#ifdef DICTIONARY_WITH_DEBUGINFO
-	threadData_.debugInfo_ = debugInfo;
-#endif
-	
-	calculate(needle);
+QString ThreadedSearchStrategy::search(const QString& needle,
+									   const Dictionary::QueryOptions& options,
+									   Dictionary::QueryStats* stats,
+									   Dictionary::DebugInfo* debugInfo)
+{
+	KeyDistTuple match = searchKey(d_.encode(needle), options, stats,
+		debugInfo);
+	if (match.keyIsValid())
+		return d_.entries_.toQString(match.key());
+	return QString();
+}
+
+KeyDistTuple ThreadedSearchStrategy::searchKey(const QString& encodedNeedle,
+											   const Dictionary::QueryOptions& options,
+											   Dictionary::QueryStats* stats,
+											   Dictionary::DebugInfo* debugInfo,
+											   QueryTrace* trace)
+{
+	IF_PROFILER(ProfilerTimer timer(&d_.profiler, Profiler::Query));
+
+	if (stats)
+		*stats = Dictionary::QueryStats();
+
+	calculateEncoded(encodedNeedle, options);
 	
 	if (encNeedleSize_ == 0)
-		return QString();
-	
-	prepareSearch();
-	
-	KeyDistTuple bestMatch = executeThreads();
+		return KeyDistTuple();
 	
-	IF_PROFILER(d_.profiler.querytime += d_.profiler.queryTimer.elapsed());
-	IF_PROFILER(d_.profiler.queries++);
-	IF_PROFILER(d_.profiler.queriesPerSec =
-		(((double)d_.profiler.queries * 1000.0)/d_.profiler.querytime));
+	QueryBudget budget(options);
+	QueryBudget* limit = budget.isLimited()? &budget : 0;
+	startCounting();
+
+	KeyDistTuple bestMatch;
+	if (piecesTooShort()) {
+		// Too many typos for the gram index.
+		BudgetAccount account(limit);
+		searchInfo_.setAccount(&account);
+		bestMatch = scanKeys(searchInfo_);
+		searchInfo_.setAccount(0);
+		mergeCounters(0, account.candidates());
+	}
+	else {
+		prepareSearch();
+		// The threads share the budget, each charging it through
+		// an account of its own.
+		threadData_.budget_ = limit;
+#ifdef DICTIONARY_WITH_DEBUGINFO
+		threadData_.debugInfo_ = debugInfo;
+#endif
+		threadData_.trace_ = trace;
+		bestMatch = executeThreads();
+		threadData_.budget_ = 0;
+		threadData_.debugInfo_ = 0;
+		threadData_.trace_ = 0;
+	}
+
+	Dictionary::QueryStats queryStats;
+	queryStats.truncated = budget.isTruncated();
+	if (bestMatch.keyIsValid())
+		queryStats.distance = bestMatch.distance();
+	stopCounting(queryStats);
+	if (stats)
+		*stats = queryStats;
 	
 #ifdef DICTIONARY_WITH_DEBUGINFO
 	if (debugInfo) {
@@ -156,10 +211,40 @@ QString ThreadedSearchStrategy::search(const QString& needle,
 	}
 #endif
 
-	// bestMatch holds the best KeyDistTuple.
-	if (bestMatch.keyIsValid())
-		return d_.entries_.toQString(bestMatch.key());
-	return QString();
+	return bestMatch;
+}
+
+QList<KeyDistTuple> ThreadedSearchStrategy::searchTopK(const QString& encodedNeedle,
+													   int k)
+{
+	calculateEncoded(encodedNeedle, Dictionary::QueryOptions());
+	
+	if (encNeedleSize_ == 0 || k <= 0)
+		return QList<KeyDistTuple>();
+
+	TopKCollector collector(k, maxTypos_);
+	startCounting();
+	if (piecesTooShort()) {
+		// Too many typos for the gram index.
+		BudgetAccount account;
+		searchInfo_.setAccount(&account);
+		scanKeys(searchInfo_, collector);
+		searchInfo_.setAccount(0);
+		mergeCounters(0, account.candidates());
+	}
+	else {
+		prepareSearch();
+		// The threads share the collector, so every thread prunes
+		// with the bound found by all of them.
+		threadData_.collector_ = &collector;
+		startThreads();
+		waitForThreadsToFinish();
+		threadData_.collector_ = 0;
+	}
+	Dictionary::QueryStats stats;
+	stopCounting(stats);
+	
+	return collector.results();
 }
 
 } // namespace DictionaryImpl
@@ -38,7 +38,13 @@ class ThreadedSearchStrategy : public SearchStrategyBase
 	
 	void prepareSearch();
 	
+	/**
+	 * Finds the best match of gram. Called by the SearchThreads,
+	 * each with a copy of searchInfo_ counting into counters of
+	 * its own.
+	 */
 	KeyDistTuple searchBestKey(const QString& gram,
+							   const SearchInfo& searchInfo,
 							   Dictionary::DebugInfo* debugInfo = 0);
 							   
 public:
@@ -50,6 +56,19 @@ public:
 	QString search(const QString& needle);
 	
 	QString search(const QString& needle, Dictionary::DebugInfo* debugInfo);
+
+	QString search(const QString& needle,
+				   const Dictionary::QueryOptions& options,
+				   Dictionary::QueryStats* stats,
+				   Dictionary::DebugInfo* debugInfo);
+
+	KeyDistTuple searchKey(const QString& encodedNeedle,
+						   const Dictionary::QueryOptions& options,
+						   Dictionary::QueryStats* stats,
+						   Dictionary::DebugInfo* debugInfo,
+						   QueryTrace* trace = 0);
+
+	QList<KeyDistTuple> searchTopK(const QString& encodedNeedle, int k);
 	
 	friend class SearchThread;
 
@@ -0,0 +1,88 @@
+#include <core/precompiled.h>
+
+#include <algorithm>
+
+#include "DictionaryDefines.h"
+#include "TopKCollector.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+TopKCollector::TopKCollector(int k, DistType maxDistance) :
+	k_(k),
+	maxDistance_(maxDistance),
+	heap_(),
+	keys_(),
+	mutex_(),
+	bound_(maxDistance),
+	complete_(0)
+{
+	heap_.reserve(k);
+	keys_.reserve(k);
+}
+
+TopKCollector::~TopKCollector()
+{ }
+
+bool TopKCollector::rankedBefore(const KeyDistTuple& lhs,
+								 const KeyDistTuple& rhs)
+{
+	if (lhs.distance() != rhs.distance())
+		return lhs.distance() < rhs.distance();
+	return lhs.key() < rhs.key();
+}
+
+DistType TopKCollector::bound() const
+{
+	return static_cast<DistType>(static_cast<int>(bound_));
+}
+
+bool TopKCollector::isComplete() const
+{
+	return static_cast<int>(complete_) != 0;
+}
+
+void TopKCollector::offer(KeyType key, DistType distance)
+{
+	if (distance > bound() || k_ <= 0)
+		return;
+
+	QMutexLocker locker(&mutex_);
+	KeyDistTuple tuple;
+	tuple.set(key, distance);
+	if (heap_.size() == k_) {
+		if (!rankedBefore(tuple, heap_.first()) || keys_.contains(key))
+			return;
+		std::pop_heap(heap_.begin(), heap_.end(), rankedBefore);
+		keys_.remove(heap_.last().key());
+		heap_.last() = tuple;
+	}
+	else {
+		if (keys_.contains(key))
+			return;
+		heap_.append(tuple);
+	}
+	keys_.insert(key);
+	std::push_heap(heap_.begin(), heap_.end(), rankedBefore);
+
+	if (heap_.size() == k_) {
+		bound_ = heap_.first().distance();
+		if (heap_.first().distance() == 0)
+			complete_ = 1;
+	}
+}
+
+QList<KeyDistTuple> TopKCollector::results()
+{
+	QMutexLocker locker(&mutex_);
+	QVector<KeyDistTuple> sorted = heap_;
+	std::sort_heap(sorted.begin(), sorted.end(), rankedBefore);
+	return sorted.toList();
+}
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
@@ -0,0 +1,97 @@
+#ifndef DISTILLER_DICTIONARYIMPL_TOPKCOLLECTOR_H
+#define DISTILLER_DICTIONARYIMPL_TOPKCOLLECTOR_H
+
+#pragma once
+
+#include <QMutex>
+#include <QAtomicInt>
+#include <QVector>
+#include <QList>
+#include <QSet>
+
+#include "KeyDistTuple.h"
+
+namespace Distiller
+{
+
+namespace DictionaryImpl
+{
+
+/**
+ * Collects the k best (key, distance) tuples of a query.
+ *
+ * The tuples are kept in a bounded max-heap, the worst of the k
+ * best tuples is on top. Its distance is the bound for verifying
+ * further candidates: a candidate which is farther away can't get
+ * into the result, so the edit distance calculation may stop as
+ * soon as the bound is exceeded.
+ *
+ * Equal distances are ranked by key. A key which is offered more
+ * than once (it's reachable through several grams) is only taken
+ * once.
+ *
+ * offer() may be called from several threads. bound() doesn't lock.
+ */
+class TopKCollector
+{
+
+	int k_;
+
+	DistType maxDistance_;
+
+	/// Max-heap of the best tuples ordered by rankedBefore().
+	QVector<KeyDistTuple> heap_;
+
+	/// The keys in heap_, so a duplicate is found in O(1).
+	QSet<KeyType> keys_;
+
+	QMutex mutex_;
+
+	/// Current bound, see bound().
+	QAtomicInt bound_;
+
+	/// Set if k exact matches have been collected.
+	QAtomicInt complete_;
+
+	/**
+	 * Returns true if lhs ranks before rhs, i.e. has a smaller
+	 * distance or the same distance and a smaller key.
+	 */
+	static bool rankedBefore(const KeyDistTuple& lhs, const KeyDistTuple& rhs);
+
+public:
+
+	/**
+	 * Collects the k best tuples with a distance of at most
+	 * maxDistance.
+	 */
+	TopKCollector(int k, DistType maxDistance);
+
+	~TopKCollector();
+
+	/**
+	 * The largest distance a candidate may have to get into
+	 * the result.
+	 */
+	DistType bound() const;
+
+	/**
+	 * Returns true if k tuples with distance 0 have been
+	 * collected. Nothing can beat them, so the search may stop.
+	 */
+	bool isComplete() const;
+
+	void offer(KeyType key, DistType distance);
+
+	/**
+	 * Returns the collected tuples, best first.
+	 */
+	QList<KeyDistTuple> results();
+
+};
+
+} // namespace DictionaryImpl
+
+} // namespace Distiller
+
+#endif 